@@ -1,7 +1,36 @@
+import csv
+import json
+import sys
+
 import matplotlib.pyplot as plt
 import numpy as np
 
-def generate_roofline_chart():
+# Usage: python3 roofline.py bench.json|bench.csv [output.png]
+# Reads the results written by `./bench --json FILE` (or `--csv FILE`) and
+# places every measured stage on the roofline at its own intensity.
+
+STAGE_MARKERS = {
+    'distance': ('*', 'Distance'),
+    'select': ('o', 'Distance + Top-k'),
+    'sort': ('x', 'Sorting'),
+}
+
+
+def load_results(path):
+    if path.endswith('.csv'):
+        with open(path, newline='') as f:
+            rows = list(csv.DictReader(f))
+        for r in rows:
+            for key in ('n', 'd', 'threads', 'k'):
+                r[key] = int(r[key])
+            for key in ('p50_ms', 'bytes', 'flops', 'gbps', 'gflops', 'intensity'):
+                r[key] = float(r[key])
+        return rows
+    with open(path) as f:
+        return json.load(f)['results']
+
+
+def generate_roofline_chart(results_path, output_path='final_roofline.png'):
     # --- 1. Hardware Specifications ---
     # GPU: AMD MI210 (Vector)
     gpu_peak_flops = 45.3 * 10**12   # 45.3 TFLOPs
@@ -11,18 +40,26 @@ def generate_roofline_chart():
     cpu_peak_flops = 64*2.5*32*2*10**9   # 10.24 TFLOPs
     cpu_bw = 204.8 * 10**9           # 204.8 GB/s
 
-    # --- 2. Algorithm Intensities ---
-    # Distance Kernel: 9 FLOPs / 16 Bytes
-    ai_distance = 0.5625
-
-    # Sorting Kernel: 1 Op / 32 Bytes
-    ai_sorting = 0.03125
+    # --- 2. Measured Intensities ---
+    # Only the highest thread count of each configuration is plotted: the roofs
+    # are whole-machine ceilings. Sort "FLOPs" are key comparisons.
+    results = [r for r in load_results(results_path)
+               if r['stage'] in STAGE_MARKERS and r['flops'] > 0 and r['bytes'] > 0]
+    if not results:
+        sys.exit(f'{results_path}: no distance, select or sort results to plot')
+    max_threads = {}
+    for r in results:
+        key = (r['n'], r['d'], r['metric'], r['k'], r['sort'], r['stage'])
+        max_threads[key] = max(max_threads.get(key, 0), r['threads'])
+    results = [r for r in results
+               if r['threads'] == max_threads[(r['n'], r['d'], r['metric'], r['k'], r['sort'], r['stage'])]]
 
     # --- 3. Setup Plot ---
     fig, ax = plt.subplots(figsize=(12, 8))
 
-    # X-axis: Operational Intensity (log scale range)
-    x = np.logspace(-2.5, 2.5, 1000)
+    # X-axis: Operational Intensity, wide enough for every measured point
+    intensities = [r['intensity'] for r in results]
+    x = np.logspace(min(-2.5, np.log10(min(intensities)) - 0.5), 2.5, 1000)
 
     # --- 4. Plot GPU Roofline ---
     gpu_mem_bound = x * gpu_bw
@@ -50,48 +87,40 @@ def generate_roofline_chart():
     ax.text(cpu_ridge, cpu_peak_flops * 1.3, f'CPU Ridge\n{cpu_ridge:.2f} FLOPs/Byte',
             color='blue', ha='center', fontweight='bold')
 
-    # --- 6. Plot Algorithm Points (Performance = AI * Bandwidth) ---
-    # Distance Kernel Points
-    gpu_perf_dist = ai_distance * gpu_bw
-    cpu_perf_dist = ai_distance * cpu_bw
-
-    ax.plot(ai_distance, gpu_perf_dist, 'r*', markersize=18, label='Distance Algo (GPU)')
-    ax.plot(ai_distance, cpu_perf_dist, 'b*', markersize=18, label='Distance Algo (CPU)')
-
-    # Sorting Kernel Points
-    gpu_perf_sort = ai_sorting * gpu_bw
-    cpu_perf_sort = ai_sorting * cpu_bw
-
-    ax.plot(ai_sorting, gpu_perf_sort, 'rx', markersize=14, markeredgewidth=3, label='Sorting Algo (GPU)')
-    ax.plot(ai_sorting, cpu_perf_sort, 'bx', markersize=14, markeredgewidth=3, label='Sorting Algo (CPU)')
+    # --- 6. Plot Measured Points (Performance = FLOPs / median time) ---
+    labelled = set()
+    for r in results:
+        marker, name = STAGE_MARKERS[r['stage']]
+        perf = r['gflops'] * 10**9
+        label = None if r['stage'] in labelled else f'{name} (CPU, measured)'
+        labelled.add(r['stage'])
+        ax.plot(r['intensity'], perf, marker, color='darkgreen', markersize=12,
+                markeredgewidth=2, label=label)
+
+        detail = f"D={r['d']} {r['metric']}"
+        if r['stage'] == 'sort':
+            detail = f"{r['sort']} N={r['n']:.0e}"
+        ax.annotate(f"{detail}, {r['threads']}T", xy=(r['intensity'], perf),
+                    xytext=(6, -4), textcoords='offset points', fontsize=8)
 
     # --- 7. Annotations & Styling ---
-    # Annotate Distance AI
-    ax.annotate(f'Distance AI: {ai_distance:.2f}',
-                xy=(ai_distance, gpu_perf_dist),
-                xytext=(ai_distance * 1.5, gpu_perf_dist / 3),
-                arrowprops=dict(facecolor='black', shrink=0.05))
-
-    # Annotate Sorting AI
-    ax.annotate(f'Sorting AI: {ai_sorting:.2f}(Extreme Mem Bound)',
-                xy=(ai_sorting, gpu_perf_sort),
-                xytext=(ai_sorting / 5, gpu_perf_sort * 8),
-                arrowprops=dict(facecolor='black', shrink=0.05))
-
     # Bandwidth Labels
-    ax.text(0.005, gpu_bw * 1.1, f'GPU BW: 1.6 TB/s', color='red', fontsize=10)
-    ax.text(0.005, cpu_bw * 1.1, f'CPU BW: 205 GB/s', color='blue', fontsize=10)
+    ax.text(x[0] * 1.5, gpu_bw * x[0] * 1.5 * 1.1, f'GPU BW: 1.6 TB/s', color='red', fontsize=10)
+    ax.text(x[0] * 1.5, cpu_bw * x[0] * 1.5 * 1.1, f'CPU BW: 205 GB/s', color='blue', fontsize=10)
 
     ax.set_xlabel('Operational Intensity (FLOPs/Byte)', fontsize=12)
     ax.set_ylabel('Performance (FLOPs/sec)', fontsize=12)
-    ax.set_title('Roofline Model: Distance vs Sorting Algorithms', fontsize=16)
+    ax.set_title('Roofline Model: Measured Distance, Top-k and Sorting Stages', fontsize=16)
     ax.grid(True, which="both", ls="-", alpha=0.4)
     ax.legend(loc='lower right')
 
     # Save and Show
     plt.tight_layout()
-    plt.savefig('final_roofline.png', dpi=300)
+    plt.savefig(output_path, dpi=300)
     plt.show()
 
+
 if __name__ == "__main__":
-    generate_roofline_chart()
+    if len(sys.argv) < 2:
+        sys.exit('Usage: python3 roofline.py bench.json|bench.csv [output.png]')
+    generate_roofline_chart(*sys.argv[1:3])
@@ -0,0 +1,98 @@
+#include "PointSet.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+
+static std::shared_ptr<float> allocate_coords(size_t n, int d) {
+    // Rounded up to the alignment; large buffers are page-aligned mappings
+    size_t bytes = n * (size_t)d * sizeof(float);
+    bytes = std::max(PointSet::kAlignment, (bytes + PointSet::kAlignment - 1) / PointSet::kAlignment * PointSet::kAlignment);
+    float* buf = static_cast<float*>(numa_alloc_bytes(bytes));
+    if (!buf) throw std::bad_alloc();
+    return std::shared_ptr<float>(buf, [bytes](float* p) { numa_free_bytes(p, bytes); });
+}
+
+void PointSet::allocate(size_t n, int d) {
+    N = n;
+    D = d;
+    dtype = DTYPE_F32;
+    storage = allocate_coords(n, d);
+    coords = storage.get();
+    coords16 = nullptr;
+
+    // Sized without zeroing, then filled in the same static partition as the pages
+    dist.resize(n);
+    id.resize(n);
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++) {
+        dist[i] = 0.0f;
+        id[i] = (uint32_t)i;
+    }
+}
+
+void PointSet::widen() {
+    if (is_f32()) return;
+    std::shared_ptr<float> wide = allocate_coords(N, D);
+
+    // Static schedule over row blocks, roughly the slices first touch placed
+    constexpr size_t kRows = 1024;
+    const size_t blocks = (N + kRows - 1) / kRows;
+    #pragma omp parallel for schedule(static)
+    for (size_t b = 0; b < blocks; b++) {
+        size_t rows = std::min(kRows, N - b * kRows);
+        widen_to_float(row16(b * kRows), wide.get() + b * kRows * (size_t)D, rows * (size_t)D, dtype);
+    }
+
+    storage = std::move(wide);  // releases the 16-bit rows (or their mapping)
+    coords = storage.get();
+    coords16 = nullptr;
+    dtype = DTYPE_F32;
+}
+
+void PointSet::permute_dims(const std::vector<uint32_t>& order) {
+    widen();
+    std::shared_ptr<float> out = allocate_coords(N, D);
+    float* dst = out.get();
+    const uint32_t* perm = order.data();
+
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < N; i++) {
+        const float* src = row(i);
+        float* r = dst + i * (size_t)D;
+        for (int j = 0; j < D; j++) r[j] = src[perm[j]];
+    }
+
+    storage = std::move(out);
+    coords = storage.get();
+}
+
+std::vector<float> PointSet::blocked_view(size_t block) const {
+    size_t tiles = (N + block - 1) / block;
+    std::vector<float> out(tiles * block * (size_t)D, 0.0f);
+
+    #pragma omp parallel for schedule(static)
+    for (size_t t = 0; t < tiles; t++) {
+        float* tile = out.data() + t * block * (size_t)D;
+        size_t rows = std::min(block, N - t * block);
+        for (size_t r = 0; r < rows; r++) {
+            const float* p = row(t * block + r);
+            for (int j = 0; j < D; j++) tile[(size_t)j * block + r] = p[j];
+        }
+    }
+    return out;
+}
+
+PointSet PermutedView::gather(size_t count) const {
+    count = std::min(count, perm_.size());
+    PointSet out;
+    out.allocate(count, src_.D);
+
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < count; i++) {
+        std::memcpy(out.row(i), row(i), sizeof(float) * src_.D);
+        out.dist[i] = dist(i);
+        out.id[i] = perm_[i];
+    }
+    return out;
+}
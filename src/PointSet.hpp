@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "half.hpp"
+#include "numa_placement.hpp"
+
+// Packed (distance, row) sort key: 8 bytes, so sorting never touches coordinates.
+struct KeyIdx {
+    float dist;
+    uint32_t idx;
+};
+
+// Structure-of-arrays point store.
+// All coordinates live in one aligned row-major buffer (N x D floats); distances
+// and row ids are kept in separate arrays. After a sort, dist[i] is the i-th
+// smallest distance and id[i] is the row it belongs to - coordinates never move.
+//
+// A binary fp16/bf16 dataset loaded with keep_dtype stays in its stored
+// precision: dtype is DTYPE_F16 or DTYPE_BF16, coords16 points at the rows and
+// coords is null. Only the CPU distance and top-k scans read such a store;
+// everything else calls widen() first.
+struct PointSet {
+    static constexpr size_t kAlignment = 64;
+
+    size_t N = 0;
+    int D = 0;
+    uint32_t dtype = DTYPE_F32;
+    float* coords = nullptr;          // row-major, N * D (float32 stores)
+    const uint16_t* coords16 = nullptr;  // row-major, N * D (fp16/bf16 stores)
+    std::shared_ptr<float> storage;   // owns the buffer, or the mapping the rows point into
+    numa_vector<float> dist;
+    numa_vector<uint32_t> id;
+    std::vector<float> norms;         // per-row L2 norm; filled by compute_norms() when a metric needs it
+
+    // Allocates the coordinate buffer with numa_alloc_bytes (pages already
+    // placed by the NUMA policy, contents unspecified) and resets id to the
+    // identity permutation and dist to zero.
+    void allocate(size_t n, int d);
+
+    size_t size() const { return N; }
+    bool empty() const { return N == 0; }
+
+    float* row(size_t i) { return coords + i * (size_t)D; }
+    const float* row(size_t i) const { return coords + i * (size_t)D; }
+    const uint16_t* row16(size_t i) const { return coords16 + i * (size_t)D; }
+
+    bool is_f32() const { return dtype == DTYPE_F32; }
+    const void* data() const { return is_f32() ? static_cast<const void*>(coords) : coords16; }
+    size_t data_bytes() const { return N * (size_t)D * (is_f32() ? sizeof(float) : sizeof(uint16_t)); }
+
+    // Converts an fp16/bf16 store into an owned float32 buffer in place; dist,
+    // id and norms are kept. No-op for float32.
+    void widen();
+
+    // Rewrites the rows with their columns in `order` (new column j is old
+    // column order[j]) into an owned float32 buffer; dist, id and norms are
+    // kept. Distances are unchanged if queries are permuted the same way.
+    void permute_dims(const std::vector<uint32_t>& order);
+
+    // Column-major copy in tiles of `block` rows: tile t holds D runs of `block`
+    // floats, so out[t*block*D + j*block + r] = row(t*block + r)[j].
+    // The last tile is zero-padded.
+    std::vector<float> blocked_view(size_t block) const;
+};
+
+// Lazily reordered view of a PointSet. Rows are read through the permutation
+// in place; a reordered copy is only materialised when gather() is called.
+class PermutedView {
+public:
+    PermutedView(const PointSet& src, std::vector<uint32_t> perm)
+        : src_(src), perm_(std::move(perm)) {}
+
+    size_t size() const { return perm_.size(); }
+    uint32_t index(size_t i) const { return perm_[i]; }
+    const float* row(size_t i) const { return src_.row(perm_[i]); }
+    float dist(size_t i) const { return src_.dist[perm_[i]]; }
+
+    // Copies the first `count` rows (in permuted order) into a new contiguous
+    // PointSet; id[] of the result holds the original row indices.
+    PointSet gather(size_t count) const;
+
+private:
+    const PointSet& src_;
+    std::vector<uint32_t> perm_;
+};
@@ -0,0 +1,305 @@
+#include "autotune.hpp"
+#include "cpu_distance.hpp"
+#include "distance_kernels.hpp"
+#include "gpu_hip.hpp"
+#include "point_generator.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <omp.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr int kProfileVersion = 1;
+
+// Calibration sizes: large enough to leave the caches (64 MB of coordinates
+// at D=128, 8 MB of sort keys), small enough to finish in seconds
+static constexpr size_t kCalRows = 1 << 17;
+static constexpr int kCalDims[2] = {8, 128};
+static constexpr size_t kCalKeys = 1 << 20;
+static constexpr size_t kTasksPerThread[] = {2, 8, 32};
+
+template <class Before, class Fn>
+static double best_time(int reps, Before before, Fn fn) {
+    double best = std::numeric_limits<double>::infinity();
+    for (int r = 0; r < reps; r++) {
+        before();
+        auto t0 = std::chrono::steady_clock::now();
+        fn();
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+
+static PointSet calibration_rows(size_t N, int D) {
+    PointSet pts;
+    pts.allocate(N, D);
+    GeneratorConfig cfg;
+    cfg.seed = 1;
+    const PointGenerator gen(cfg, D);
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < N; i++) gen.row(i, pts.row(i));
+    return pts;
+}
+
+std::string default_profile_path() {
+    if (const char* env = std::getenv("KNN_PROFILE")) return env;
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    const char* home = std::getenv("HOME");
+    return std::string(home ? home : ".") + "/.cache/knn/profile-" + host + ".txt";
+}
+
+TuneProfile host_identity() {
+    TuneProfile p;
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    p.host = host;
+
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.compare(0, 10, "model name") != 0) continue;
+        size_t colon = line.find(':');
+        if (colon != std::string::npos) p.cpu = line.substr(line.find_first_not_of(" \t", colon + 1));
+        break;
+    }
+    if (p.cpu.empty()) p.cpu = "unknown";
+    p.max_threads = omp_get_max_threads();
+    p.isa = isa_name(detect_isa());
+    return p;
+}
+
+bool same_host(const TuneProfile& a, const TuneProfile& b) {
+    return a.host == b.host && a.cpu == b.cpu && a.max_threads == b.max_threads && a.isa == b.isa;
+}
+
+TuneProfile calibrate() {
+    TuneProfile p = host_identity();
+    std::vector<int> counts;
+    for (int t = 1; t < p.max_threads; t *= 2) counts.push_back(t);
+    counts.push_back(p.max_threads);
+
+    // 1. Distance pass at two dimensions: per-row and per-coordinate cost
+    std::cout << "Calibrating distance pass (" << kCalRows << " rows, D=" << kCalDims[0] << "," << kCalDims[1] << ")\n";
+    {
+        PointSet small = calibration_rows(kCalRows, kCalDims[0]);
+        PointSet large = calibration_rows(kCalRows, kCalDims[1]);
+        std::vector<float> ref(kCalDims[1], 0.5f);
+        std::vector<float> ref_small(kCalDims[0], 0.5f);
+        for (int T : counts) {
+            omp_set_num_threads(T);
+            double ts = best_time(3, [] {}, [&] { compute_distances_cpu(small, ref_small); });
+            double tl = best_time(3, [] {}, [&] { compute_distances_cpu(large, ref); });
+            DistanceCost c;
+            c.threads = T;
+            double ns_small = ts / kCalRows * 1e9, ns_large = tl / kCalRows * 1e9;
+            c.dim_ns = std::max(0.0, (ns_large - ns_small) / (kCalDims[1] - kCalDims[0]));
+            c.row_ns = std::max(0.0, ns_small - c.dim_ns * kCalDims[0]);
+            p.distance.push_back(c);
+        }
+    }
+
+    // 2. Sorts of the full (dist, id) stage, as sort_points_cpu runs it
+    std::cout << "Calibrating sorts (" << kCalKeys << " keys, merge grains and radix)\n";
+    {
+        PointSet keys;
+        keys.allocate(kCalKeys, 1);
+        std::vector<float> master(kCalKeys);
+        GeneratorConfig cfg;
+        cfg.seed = 2;
+        const PointGenerator gen(cfg, 1);
+        for (size_t i = 0; i < kCalKeys; i++) gen.row(i, &master[i]);
+        auto reset = [&] {
+            for (size_t i = 0; i < kCalKeys; i++) {
+                keys.dist[i] = master[i];
+                keys.id[i] = (uint32_t)i;
+            }
+        };
+        const double levels = std::log2((double)kCalKeys);
+
+        for (int T : counts) {
+            omp_set_num_threads(T);
+            SortCost c;
+            c.threads = T;
+            double best_merge = std::numeric_limits<double>::infinity();
+            for (size_t tpt : kTasksPerThread) {
+                size_t grain = default_merge_grain(kCalKeys, T, tpt);
+                double t = best_time(3, reset, [&] { sort_points_cpu(keys, SortAlgo::Merge, grain); });
+                if (t < best_merge) {
+                    best_merge = t;
+                    c.merge_tasks_per_thread = tpt;
+                }
+            }
+            c.merge_ns = best_merge / (kCalKeys * levels) * 1e9;
+            c.radix_ns = best_time(3, reset, [&] { sort_points_cpu(keys, SortAlgo::Radix); }) / kCalKeys * 1e9;
+            p.sort.push_back(c);
+        }
+    }
+    omp_set_num_threads(p.max_threads);
+
+    // 3. GPU pipeline at two sizes and two dimensions. Its stage timings are
+    //    printed by run_gpu_sort, so stdout is muted meanwhile
+    if (gpu_available()) {
+        std::cout << "Calibrating GPU pipeline\n";
+        const size_t n1 = kCalRows / 4, n2 = kCalRows;
+        PointSet a = calibration_rows(n1, kCalDims[0]);
+        PointSet b = calibration_rows(n2, kCalDims[0]);
+        PointSet c = calibration_rows(n2, kCalDims[1]);
+        std::vector<float> ref(kCalDims[1], 0.5f);
+        std::vector<float> ref_small(kCalDims[0], 0.5f);
+
+        std::streambuf* out = std::cout.rdbuf(nullptr);
+        run_gpu_sort(a, ref_small);  // device initialisation is not part of the model
+        double ta = best_time(2, [] {}, [&] { run_gpu_sort(a, ref_small); });
+        double tb = best_time(2, [] {}, [&] { run_gpu_sort(b, ref_small); });
+        double tc = best_time(2, [] {}, [&] { run_gpu_sort(c, ref); });
+        std::cout.rdbuf(out);
+
+        double per_row = std::max(0.0, (tb - ta) / (n2 - n1));
+        p.has_gpu = true;
+        p.gpu_dim_ns = std::max(0.0, (tc - tb) / n2 / (kCalDims[1] - kCalDims[0]) * 1e9);
+        p.gpu_row_ns = std::max(0.0, per_row * 1e9 - p.gpu_dim_ns * kCalDims[0]);
+        p.gpu_fixed_s = std::max(0.0, ta - per_row * n1);
+    }
+
+    p.calibrated_at = (long long)std::time(nullptr);
+    return p;
+}
+
+bool load_profile(const std::string& path, TuneProfile& profile) {
+    std::ifstream in(path);
+    if (!in) return false;
+
+    TuneProfile p;
+    int version = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream ss(line);
+        std::string key;
+        if (!(ss >> key) || key[0] == '#') continue;
+        if (key == "version") ss >> version;
+        else if (key == "host") std::getline(ss >> std::ws, p.host);
+        else if (key == "cpu") std::getline(ss >> std::ws, p.cpu);
+        else if (key == "threads") ss >> p.max_threads;
+        else if (key == "isa") ss >> p.isa;
+        else if (key == "calibrated") ss >> p.calibrated_at;
+        else if (key == "distance") {
+            DistanceCost c;
+            ss >> c.threads >> c.row_ns >> c.dim_ns;
+            p.distance.push_back(c);
+        } else if (key == "sort") {
+            SortCost c;
+            ss >> c.threads >> c.merge_ns >> c.merge_tasks_per_thread >> c.radix_ns;
+            p.sort.push_back(c);
+        } else if (key == "gpu") {
+            ss >> p.gpu_fixed_s >> p.gpu_row_ns >> p.gpu_dim_ns;
+            p.has_gpu = true;
+        }
+        if (ss.fail()) return false;
+    }
+    if (version != kProfileVersion || p.distance.empty() || p.sort.size() != p.distance.size()) return false;
+    profile = p;
+    return true;
+}
+
+// mkdir -p of the directory part of `path`
+static void make_parent_dirs(const std::string& path) {
+    for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+        mkdir(path.substr(0, slash).c_str(), 0755);
+    }
+}
+
+bool save_profile(const std::string& path, const TuneProfile& p) {
+    make_parent_dirs(path);
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        std::cerr << "System Error: " << std::strerror(errno) << " (" << path << ")" << std::endl;
+        return false;
+    }
+    out << "# k-NN autotune profile; delete or run `sort tune` to recalibrate\n";
+    out << "version " << kProfileVersion << "\n";
+    out << "host " << p.host << "\n";
+    out << "cpu " << p.cpu << "\n";
+    out << "threads " << p.max_threads << "\n";
+    out << "isa " << p.isa << "\n";
+    out << "calibrated " << p.calibrated_at << "\n";
+    out << std::setprecision(6);
+    out << "# distance <threads> <ns per row> <ns per coordinate>\n";
+    for (const DistanceCost& c : p.distance) out << "distance " << c.threads << " " << c.row_ns << " " << c.dim_ns << "\n";
+    out << "# sort <threads> <merge ns per key per level> <merge tasks per thread> <radix ns per key>\n";
+    for (const SortCost& c : p.sort) {
+        out << "sort " << c.threads << " " << c.merge_ns << " " << c.merge_tasks_per_thread << " " << c.radix_ns << "\n";
+    }
+    if (p.has_gpu) {
+        out << "# gpu <fixed s> <ns per row> <ns per coordinate>\n";
+        out << "gpu " << p.gpu_fixed_s << " " << p.gpu_row_ns << " " << p.gpu_dim_ns << "\n";
+    }
+    return (bool)out;
+}
+
+void print_profile(const TuneProfile& p) {
+    std::cout << "Host: " << p.host << " (" << p.cpu << ", " << p.max_threads << " threads, " << p.isa << ")\n";
+    std::cout << std::left << std::setw(9) << "threads" << std::right << std::setw(12) << "ns/row" << std::setw(12)
+              << "ns/coord" << std::setw(14) << "merge ns/key" << std::setw(8) << "tasks" << std::setw(14)
+              << "radix ns/key" << "\n";
+    // Mergesort per key over all levels of a calibration-sized sort (2^20 keys)
+    std::cout << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < p.distance.size(); i++) {
+        const DistanceCost& d = p.distance[i];
+        const SortCost& s = p.sort[i];
+        std::cout << std::left << std::setw(9) << d.threads << std::right << std::setw(12) << d.row_ns << std::setw(12)
+                  << d.dim_ns << std::setw(14) << s.merge_ns * std::log2((double)kCalKeys) << std::setw(8)
+                  << s.merge_tasks_per_thread << std::setw(14) << s.radix_ns << "\n";
+    }
+    if (p.has_gpu) {
+        std::cout << "GPU: " << p.gpu_fixed_s * 1e3 << " ms fixed + " << p.gpu_row_ns << " ns/row + " << p.gpu_dim_ns
+                  << " ns/coord\n";
+    }
+}
+
+bool load_or_calibrate(const std::string& path, bool retune, TuneProfile& profile) {
+    if (!retune && load_profile(path, profile) && same_host(profile, host_identity())) return true;
+    std::cout << "--- Autotune: calibrating this host (profile " << path << ") ---\n";
+    profile = calibrate();
+    if (!save_profile(path, profile)) std::cerr << "Warning: profile not saved; the next run calibrates again\n";
+    return true;
+}
+
+TuneChoice choose_config(const TuneProfile& p, size_t N, int D, size_t k, bool cpu_only) {
+    TuneChoice best;
+    best.predicted_s = std::numeric_limits<double>::infinity();
+    auto consider = [&](Backend backend, int threads, SortAlgo algo, size_t grain, double seconds) {
+        if (seconds >= best.predicted_s) return;
+        best = {backend, threads, algo, grain, seconds};
+    };
+
+    const double n = (double)N;
+    const double levels = std::max(1.0, std::log2(std::max(2.0, n)));
+    for (size_t i = 0; i < p.distance.size(); i++) {
+        const DistanceCost& d = p.distance[i];
+        const SortCost& s = p.sort[i];
+        double dist_s = n * (d.row_ns + d.dim_ns * D) * 1e-9;
+        if (k > 0) {
+            consider(Backend::CPU, d.threads, SortAlgo::Merge, 0, dist_s);
+            continue;
+        }
+        consider(Backend::CPU, d.threads, SortAlgo::Merge,
+                 default_merge_grain(N, d.threads, s.merge_tasks_per_thread), dist_s + n * levels * s.merge_ns * 1e-9);
+        consider(Backend::CPU, d.threads, SortAlgo::Radix, 0, dist_s + n * s.radix_ns * 1e-9);
+    }
+    if (p.has_gpu && !cpu_only) {
+        consider(Backend::GPU, p.max_threads, SortAlgo::Merge, 0,
+                 p.gpu_fixed_s + n * (p.gpu_row_ns + p.gpu_dim_ns * D) * 1e-9);
+    }
+    return best;
+}
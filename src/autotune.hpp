@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "cpu_mergesort.hpp"
+#include "knn.hpp"
+
+// Startup autotuner behind the `auto` backend. calibrate() micro-benchmarks
+// this host once: the distance pass at two dimensions, the mergesort (at
+// several grain sizes) and the radix sort, each at thread counts 1, 2, 4, ...
+// up to the core count, and the GPU pipeline if a device is present. The
+// fitted costs are kept in a per-host profile file, so later runs only pay
+// for a lookup. choose_config() then predicts every candidate for a run's
+// (N, D, k) and returns the fastest.
+//
+// Cost model (per thread count T):
+//   distance    N * (a_T + b_T * D)
+//   mergesort   N * log2(N) * m_T      (grain: n / (T * tasks_per_thread_T))
+//   radix sort  N * r_T
+//   gpu         g0 + N * (g1 + g2 * D) (transfers, kernels and host reorder)
+// A top-k run (k > 0) on the CPU is the fused distance + heap pass, so it is
+// costed as the distance pass alone.
+
+struct DistanceCost {
+    int threads = 0;
+    double row_ns = 0;   // a_T: per-row overhead
+    double dim_ns = 0;   // b_T: per coordinate
+};
+
+struct SortCost {
+    int threads = 0;
+    double merge_ns = 0;            // per key per log2(N) level
+    size_t merge_tasks_per_thread = 8;
+    double radix_ns = 0;            // per key
+};
+
+struct TuneProfile {
+    // Host identity: a profile for another host (or core count / ISA) is stale
+    std::string host;
+    std::string cpu;
+    int max_threads = 0;
+    std::string isa;
+    long long calibrated_at = 0;  // unix time
+
+    std::vector<DistanceCost> distance;
+    std::vector<SortCost> sort;
+    bool has_gpu = false;
+    double gpu_fixed_s = 0, gpu_row_ns = 0, gpu_dim_ns = 0;
+};
+
+struct TuneChoice {
+    Backend backend = Backend::CPU;
+    int threads = 1;
+    SortAlgo algo = SortAlgo::Merge;
+    size_t grain_size = 0;    // mergesort leaf size for this N; 0 = default
+    double predicted_s = 0;
+};
+
+// $KNN_PROFILE if set, else ~/.cache/knn/profile-<hostname>.txt
+std::string default_profile_path();
+
+// Identity of the running host, filled into a fresh profile
+TuneProfile host_identity();
+bool same_host(const TuneProfile& a, const TuneProfile& b);
+
+// Runs the micro-benchmarks (a few seconds; progress on stdout). Restores the
+// OpenMP thread count before returning.
+TuneProfile calibrate();
+
+bool load_profile(const std::string& path, TuneProfile& profile);
+bool save_profile(const std::string& path, const TuneProfile& profile);
+void print_profile(const TuneProfile& profile);
+
+// Loads the profile at `path` if it matches this host, else calibrates and
+// saves it (retune forces a new calibration).
+bool load_or_calibrate(const std::string& path, bool retune, TuneProfile& profile);
+
+// Fastest predicted configuration for one run; cpu_only excludes the GPU.
+TuneChoice choose_config(const TuneProfile& profile, size_t N, int D, size_t k, bool cpu_only = false);
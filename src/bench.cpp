@@ -0,0 +1,412 @@
+// Benchmark harness: sweeps N, D, thread count, metric, k and sort algorithm
+// over generated datasets, and reports per-stage percentiles with derived GB/s
+// and GFLOP/s. Results are printed as a table and optionally written as JSON
+// or CSV for roofline.py.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+#include <omp.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PointSet.hpp"
+#include "load_points.hpp"
+#include "binary_format.hpp"
+#include "cpu_distance.hpp"
+#include "cpu_mergesort.hpp"
+#include "cpu_topk.hpp"
+#include "distance_kernels.hpp"
+#include "metrics.hpp"
+#include "point_generator.hpp"
+
+struct BenchOptions {
+    std::vector<size_t> ns{1000000};
+    std::vector<size_t> ds{3, 128};
+    std::vector<size_t> threads;          // empty: 1, 2, 4, ... up to the core count
+    std::vector<MetricKind> metrics{MetricKind::L2};
+    std::vector<size_t> ks{0, 10};        // 0 = distance pass + full sort
+    std::vector<SortAlgo> sorts{SortAlgo::Merge, SortAlgo::Radix};
+    int reps = 5;
+    int warmup = 1;
+    bool text = false;
+    GeneratorConfig data;                 // distribution and seed of the generated datasets
+    std::string dir = "/tmp";
+    const char* json_path = nullptr;
+    const char* csv_path = nullptr;
+    bool keep = false;
+};
+
+// One measured stage of one configuration
+struct StageResult {
+    size_t N = 0;
+    int D = 0;
+    int threads = 0;
+    std::string metric = "-";
+    size_t k = 0;
+    std::string sort = "-";
+    std::string stage;
+    std::vector<double> samples;  // seconds, one per repetition
+    double bytes = 0;             // memory traffic of one repetition
+    double flops = 0;             // floating point (or, for sorts, key compare) operations
+
+    double percentile(double p) const {
+        std::vector<double> s = samples;
+        std::sort(s.begin(), s.end());
+        size_t rank = (size_t)std::ceil(p * s.size());
+        return s[std::min(s.size() - 1, rank > 0 ? rank - 1 : 0)];
+    }
+    double gbps() const { return bytes / percentile(0.5) / 1e9; }
+    double gflops() const { return flops / percentile(0.5) / 1e9; }
+    double intensity() const { return bytes > 0 ? flops / bytes : 0.0; }
+};
+
+// "1M,10M,500k" -> {1000000, 10000000, 500000}
+static bool parse_size_list(const char* arg, std::vector<size_t>& out) {
+    out.clear();
+    std::stringstream ss(arg);
+    std::string tok;
+    while (std::getline(ss, tok, ',')) {
+        if (tok.empty()) return false;
+        size_t scale = 1;
+        char suffix = tok.back();
+        if (suffix == 'k' || suffix == 'K') scale = 1000;
+        else if (suffix == 'm' || suffix == 'M') scale = 1000000;
+        if (scale != 1) tok.pop_back();
+        size_t v = 0;
+        auto [end, ec] = std::from_chars(tok.data(), tok.data() + tok.size(), v);
+        if (ec != std::errc() || end != tok.data() + tok.size() || v == 0) return false;
+        out.push_back(v * scale);
+    }
+    return !out.empty();
+}
+
+template <class T, class Parse>
+static bool parse_name_list(const char* arg, std::vector<T>& out, Parse parse) {
+    out.clear();
+    std::stringstream ss(arg);
+    std::string tok;
+    while (std::getline(ss, tok, ',')) {
+        T v;
+        if (!parse(tok, v)) return false;
+        out.push_back(v);
+    }
+    return !out.empty();
+}
+
+// FLOPs per coordinate of one distance evaluation
+static double flops_per_coord(MetricKind m) {
+    switch (m) {
+        case MetricKind::InnerProduct: return 2.0;  // mul, add
+        case MetricKind::Cosine: return 2.0;        // dot with precomputed norms
+        default: return 3.0;                        // l2: sub, mul, add; l1: sub, abs, add
+    }
+}
+
+// Key traffic of one full sort of N keys, including the pack from and unpack
+// to pts.dist/pts.id (16 bytes per key each way).
+static double sort_bytes(SortAlgo algo, size_t N, int threads) {
+    double n = (double)N;
+    if (algo == SortAlgo::Radix) {
+        // Three 11-bit passes; each reads the keys twice (histogram, scatter) and writes once
+        return 32.0 * n + 3.0 * 24.0 * n;
+    }
+    // Leaf sorts plus one read and one write of every key per merge level
+    double grain = std::max<double>(2000.0, n / (threads * 8.0));
+    double levels = std::max(0.0, std::ceil(std::log2(n / grain)));
+    return 32.0 * n + 16.0 * n * (levels + 1.0);
+}
+
+// Key comparisons (mergesort) or digit extractions (radix) of one full sort
+static double sort_ops(SortAlgo algo, size_t N) {
+    double n = (double)N;
+    if (algo == SortAlgo::Radix) return 3.0 * 2.0 * n;
+    return n * std::max(1.0, std::log2(n));
+}
+
+// 1. Dataset generation: the same counter-based rows as generate_points, so
+//    the same (config, N, D) always gives the same file.
+static PointSet generate_dataset(size_t N, int D, const GeneratorConfig& cfg) {
+    PointSet pts;
+    pts.allocate(N, D);
+    const PointGenerator gen(cfg, D);
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < N; i++) gen.row(i, pts.row(i));
+    return pts;
+}
+
+static bool write_points_text(const std::string& filename, const PointSet& pts, bool fixed) {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "System Error: " << std::strerror(errno) << " (" << filename << ")" << std::endl;
+        return false;
+    }
+    const size_t block = 16384;
+    const size_t blocks = (pts.size() + block - 1) / block;
+    std::vector<std::string> text(omp_get_max_threads());
+
+    // Format a round of blocks in parallel, then write them in order
+    for (size_t first = 0; first < blocks; first += text.size()) {
+        size_t round = std::min(text.size(), blocks - first);
+        #pragma omp parallel for schedule(static, 1)
+        for (size_t r = 0; r < round; r++) {
+            std::string& s = text[r];
+            s.clear();
+            std::vector<char> buf(16 * (size_t)pts.D);
+            size_t end = std::min(pts.size(), (first + r + 1) * block);
+            for (size_t i = (first + r) * block; i < end; i++) {
+                s.append(buf.data(), format_row_text(pts.row(i), pts.D, fixed, buf.data()));
+            }
+        }
+        for (size_t r = 0; r < round; r++) out.write(text[r].data(), text[r].size());
+    }
+    out.close();
+    if (out.fail()) {
+        std::cerr << "Error: File write failed (Disk full or quota exceeded?)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Times fn() reps times after the warm-up runs; `before` runs untimed ahead of
+// every call (e.g. to restore unsorted distances before a sort).
+template <class Before, class Fn>
+static std::vector<double> time_reps(const BenchOptions& opt, Before before, Fn fn) {
+    std::vector<double> samples;
+    for (int r = 0; r < opt.warmup + opt.reps; r++) {
+        before();
+        double start = omp_get_wtime();
+        fn();
+        double elapsed = omp_get_wtime() - start;
+        if (r >= opt.warmup) samples.push_back(elapsed);
+    }
+    return samples;
+}
+
+// 2. One dataset at one thread count: load, then every (metric, k, sort) stage
+static bool bench_dataset(const BenchOptions& opt, const std::string& path, size_t N, int D, int threads,
+                          std::vector<StageResult>& results) {
+    omp_set_num_threads(threads);
+    auto none = [] {};
+
+    StageResult load;
+    load.N = N; load.D = D; load.threads = threads; load.stage = "load";
+    PointSet pts;
+    bool ok = true;
+    load.samples = time_reps(opt, none, [&] {
+        PointSet fresh;
+        ok = ok && load_points(path, fresh);
+        pts = std::move(fresh);
+    });
+    if (!ok || pts.size() != N) {
+        std::cerr << "Could not load " << path << "\n";
+        return false;
+    }
+    struct stat st;
+    load.bytes = stat(path.c_str(), &st) == 0 ? (double)st.st_size : 0.0;
+    results.push_back(load);
+
+    const double coord_bytes = (double)N * D * sizeof(float);
+    for (MetricKind metric : opt.metrics) {
+        // Cosine reads norms precomputed at load time, as the CLI does
+        if (metric == MetricKind::Cosine && pts.norms.empty()) compute_norms(pts);
+        double norm_bytes = metric == MetricKind::Cosine ? 4.0 * N : 0.0;
+        double dist_flops = flops_per_coord(metric) * N * D;
+        std::vector<float> ref(D, 0.5f);
+
+        StageResult base;
+        base.N = N; base.D = D; base.threads = threads; base.metric = metric_name(metric);
+
+        for (size_t k : opt.ks) {
+            if (k > 0) {
+                StageResult sel = base;
+                sel.k = k;
+                sel.stage = "select";
+                sel.samples = time_reps(opt, none, [&] { topk_cpu(pts, ref, k, metric); });
+                sel.bytes = coord_bytes + norm_bytes;
+                sel.flops = dist_flops;
+                results.push_back(sel);
+                continue;
+            }
+
+            StageResult dist = base;
+            dist.stage = "distance";
+            dist.samples = time_reps(opt, none, [&] { compute_distances_cpu(pts, ref, metric); });
+            dist.bytes = coord_bytes + norm_bytes + 8.0 * N;  // reads rows, writes dist and id
+            dist.flops = dist_flops;
+            results.push_back(dist);
+
+            for (SortAlgo algo : opt.sorts) {
+                StageResult srt = base;
+                srt.sort = algo == SortAlgo::Radix ? "radix" : "merge";
+                srt.stage = "sort";
+                srt.samples = time_reps(opt, [&] { compute_distances_cpu(pts, ref, metric); },
+                                        [&] { sort_points_cpu(pts, algo); });
+                srt.bytes = sort_bytes(algo, N, threads);
+                srt.flops = sort_ops(algo, N);
+                results.push_back(srt);
+            }
+        }
+    }
+    return true;
+}
+
+// 3. Output
+static void print_table(const std::vector<StageResult>& results) {
+    std::cout << std::left << std::setw(10) << "N" << std::setw(6) << "D" << std::setw(5) << "T"
+              << std::setw(8) << "metric" << std::setw(5) << "k" << std::setw(7) << "sort" << std::setw(10) << "stage"
+              << std::right << std::setw(12) << "p50 ms" << std::setw(12) << "p90 ms" << std::setw(12) << "p99 ms"
+              << std::setw(10) << "GB/s" << std::setw(10) << "GFLOP/s" << "\n";
+    std::cout << std::fixed;
+    for (const StageResult& r : results) {
+        std::cout << std::left << std::setw(10) << r.N << std::setw(6) << r.D << std::setw(5) << r.threads
+                  << std::setw(8) << r.metric << std::setw(5) << r.k << std::setw(7) << r.sort << std::setw(10) << r.stage
+                  << std::right << std::setprecision(3)
+                  << std::setw(12) << r.percentile(0.5) * 1e3 << std::setw(12) << r.percentile(0.9) * 1e3
+                  << std::setw(12) << r.percentile(0.99) * 1e3
+                  << std::setprecision(2) << std::setw(10) << r.gbps() << std::setw(10) << r.gflops() << "\n";
+    }
+}
+
+static bool write_csv(const char* path, const std::vector<StageResult>& results) {
+    std::ofstream out(path);
+    if (!out) return false;
+    out << "n,d,threads,metric,k,sort,stage,reps,min_ms,p50_ms,p90_ms,p99_ms,bytes,flops,gbps,gflops,intensity\n";
+    out << std::setprecision(9);
+    for (const StageResult& r : results) {
+        out << r.N << "," << r.D << "," << r.threads << "," << r.metric << "," << r.k << "," << r.sort << ","
+            << r.stage << "," << r.samples.size() << "," << r.percentile(0.0) * 1e3 << "," << r.percentile(0.5) * 1e3
+            << "," << r.percentile(0.9) * 1e3 << "," << r.percentile(0.99) * 1e3 << "," << r.bytes << "," << r.flops
+            << "," << r.gbps() << "," << r.gflops() << "," << r.intensity() << "\n";
+    }
+    return (bool)out;
+}
+
+static bool write_json(const char* path, const std::vector<StageResult>& results) {
+    std::ofstream out(path);
+    if (!out) return false;
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    out << std::setprecision(9);
+    out << "{\n  \"host\": {\"name\": \"" << host << "\", \"max_threads\": " << omp_get_max_threads()
+        << ", \"isa\": \"" << isa_name(detect_isa()) << "\"},\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const StageResult& r = results[i];
+        out << "    {\"n\": " << r.N << ", \"d\": " << r.D << ", \"threads\": " << r.threads
+            << ", \"metric\": \"" << r.metric << "\", \"k\": " << r.k << ", \"sort\": \"" << r.sort
+            << "\", \"stage\": \"" << r.stage << "\", \"min_ms\": " << r.percentile(0.0) * 1e3
+            << ", \"p50_ms\": " << r.percentile(0.5) * 1e3 << ", \"p90_ms\": " << r.percentile(0.9) * 1e3
+            << ", \"p99_ms\": " << r.percentile(0.99) * 1e3 << ", \"bytes\": " << r.bytes << ", \"flops\": " << r.flops
+            << ", \"gbps\": " << r.gbps() << ", \"gflops\": " << r.gflops() << ", \"intensity\": " << r.intensity()
+            << ", \"samples_ms\": [";
+        for (size_t s = 0; s < r.samples.size(); s++) out << (s ? ", " : "") << r.samples[s] * 1e3;
+        out << "]}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return (bool)out;
+}
+
+static void print_usage(const char* prog) {
+    std::cout << "Usage: " << prog << " [--n 1M,10M] [--d 3,128,768] [--threads 1,2,4] [--metric l2,ip,cosine,l1]"
+              << " [--k 0,10] [--sort merge,radix] [--reps R] [--warmup W] [--format bin|text] [--seed S]"
+              << " [--dist uniform|normal|mixture] [--normalize]"
+              << " [--dir DIR] [--keep] [--json FILE] [--csv FILE]\n";
+}
+
+int main(int argc, char** argv) {
+    BenchOptions opt;
+    for (int a = 1; a < argc; a++) {
+        bool has_value = a + 1 < argc;
+        bool ok = true;
+        if (strcmp(argv[a], "--n") == 0 && has_value) ok = parse_size_list(argv[++a], opt.ns);
+        else if (strcmp(argv[a], "--d") == 0 && has_value) ok = parse_size_list(argv[++a], opt.ds);
+        else if (strcmp(argv[a], "--threads") == 0 && has_value) ok = parse_size_list(argv[++a], opt.threads);
+        else if (strcmp(argv[a], "--k") == 0 && has_value) {
+            // 0 is a valid k here (full sort), so this list is parsed by hand
+            ok = parse_name_list(argv[++a], opt.ks, [](const std::string& s, size_t& v) {
+                auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+                return ec == std::errc() && end == s.data() + s.size();
+            });
+        } else if (strcmp(argv[a], "--metric") == 0 && has_value) ok = parse_name_list(argv[++a], opt.metrics, parse_metric);
+        else if (strcmp(argv[a], "--sort") == 0 && has_value) ok = parse_name_list(argv[++a], opt.sorts, parse_sort_algo);
+        else if (strcmp(argv[a], "--reps") == 0 && has_value) opt.reps = std::max(1, std::stoi(argv[++a]));
+        else if (strcmp(argv[a], "--warmup") == 0 && has_value) opt.warmup = std::max(0, std::stoi(argv[++a]));
+        else if (strcmp(argv[a], "--format") == 0 && has_value) {
+            std::string f = argv[++a];
+            ok = f == "bin" || f == "text";
+            opt.text = f == "text";
+        } else if (strcmp(argv[a], "--seed") == 0 && has_value) opt.data.seed = std::stoull(argv[++a]);
+        else if (strcmp(argv[a], "--dist") == 0 && has_value) ok = parse_distribution(argv[++a], opt.data.dist);
+        else if (strcmp(argv[a], "--normalize") == 0) opt.data.normalize = true;
+        else if (strcmp(argv[a], "--dir") == 0 && has_value) opt.dir = argv[++a];
+        else if (strcmp(argv[a], "--json") == 0 && has_value) opt.json_path = argv[++a];
+        else if (strcmp(argv[a], "--csv") == 0 && has_value) opt.csv_path = argv[++a];
+        else if (strcmp(argv[a], "--keep") == 0) opt.keep = true;
+        else {
+            print_usage(argv[0]);
+            return strcmp(argv[a], "--help") == 0 ? 0 : 1;
+        }
+        if (!ok) {
+            std::cerr << "Invalid value for " << argv[a - 1] << ": " << argv[a] << "\n";
+            return 1;
+        }
+    }
+
+    // Created up front, so a bad --dir fails before any dataset is generated
+    std::error_code ec;
+    std::filesystem::create_directories(opt.dir, ec);
+    if (ec || !std::filesystem::is_directory(opt.dir)) {
+        std::cerr << "Cannot use --dir " << opt.dir << ": " << (ec ? ec.message() : "not a directory") << "\n";
+        return 1;
+    }
+
+    const int max_threads = omp_get_max_threads();
+    if (opt.threads.empty()) {
+        for (int t = 1; t < max_threads; t *= 2) opt.threads.push_back(t);
+        opt.threads.push_back(max_threads);
+    }
+
+    std::cout << "--- Benchmark (" << max_threads << " hardware threads, " << isa_name(detect_isa()) << ", "
+              << opt.reps << " reps + " << opt.warmup << " warm-up) ---\n";
+
+    std::vector<StageResult> results;
+    for (size_t N : opt.ns) {
+        for (size_t D : opt.ds) {
+            std::string path = opt.dir + "/bench_" + std::to_string(N) + "x" + std::to_string(D) +
+                               (opt.text ? ".txt" : ".kbin");
+            {
+                omp_set_num_threads(max_threads);
+                PointSet pts = generate_dataset(N, (int)D, opt.data);
+                bool ok = opt.text ? write_points_text(path, pts, fixed_text_format(opt.data)) : write_points_binary(path, pts, DTYPE_F32);
+                if (!ok) return 1;
+            }
+            std::cout << "Generated " << path << "\n";
+
+            for (size_t t : opt.threads) {
+                if (!bench_dataset(opt, path, N, (int)D, (int)t, results)) return 1;
+            }
+            if (!opt.keep) unlink(path.c_str());
+        }
+    }
+
+    std::cout << "\n";
+    print_table(results);
+
+    if (opt.json_path && !write_json(opt.json_path, results)) {
+        std::cerr << "Could not write " << opt.json_path << "\n";
+        return 1;
+    }
+    if (opt.csv_path && !write_csv(opt.csv_path, results)) {
+        std::cerr << "Could not write " << opt.csv_path << "\n";
+        return 1;
+    }
+    return 0;
+}
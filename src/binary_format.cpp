@@ -0,0 +1,150 @@
+#include "binary_format.hpp"
+#include "half.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+size_t dtype_size(uint32_t dtype) {
+    switch (dtype) {
+        case DTYPE_F32: return 4;
+        case DTYPE_F16: return 2;
+        case DTYPE_BF16: return 2;
+        default: return 0;
+    }
+}
+
+const char* dtype_name(uint32_t dtype) {
+    switch (dtype) {
+        case DTYPE_F32: return "f32";
+        case DTYPE_F16: return "f16";
+        case DTYPE_BF16: return "bf16";
+        default: return "unknown";
+    }
+}
+
+bool parse_dtype(const std::string& name, uint32_t& dtype) {
+    if (name == "f32" || name == "float32") { dtype = DTYPE_F32; return true; }
+    if (name == "f16" || name == "float16") { dtype = DTYPE_F16; return true; }
+    if (name == "bf16" || name == "bfloat16") { dtype = DTYPE_BF16; return true; }
+    return false;
+}
+
+BinaryHeader make_binary_header(uint64_t N, uint32_t D, uint32_t dtype, uint32_t alignment) {
+    BinaryHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, kBinaryMagic, sizeof(h.magic));
+    h.version = kBinaryVersion;
+    h.dtype = dtype;
+    h.N = N;
+    h.D = D;
+    h.alignment = alignment;
+    h.offset = (sizeof(BinaryHeader) + alignment - 1) / alignment * alignment;
+    return h;
+}
+
+bool is_binary_dataset(const char* addr, size_t len) {
+    if (len < sizeof(BinaryHeader)) return false;
+    BinaryHeader h;
+    std::memcpy(&h, addr, sizeof(h));
+    if (std::memcmp(h.magic, kBinaryMagic, sizeof(h.magic)) != 0) return false;
+    if (h.version != kBinaryVersion || dtype_size(h.dtype) == 0) return false;
+    // D is used as an int and row ids are uint32_t
+    if (h.D == 0 || h.D > (uint32_t)INT_MAX || h.N > UINT32_MAX) return false;
+    if (h.offset < sizeof(BinaryHeader) || h.offset > len) return false;
+    // Overflow-checked: a corrupt N or D must not wrap past the length check
+    uint64_t payload_bytes;
+    if (__builtin_mul_overflow(h.N, (uint64_t)h.D * dtype_size(h.dtype), &payload_bytes)) return false;
+    return payload_bytes <= len - h.offset;
+}
+
+bool load_points_binary(char* addr, size_t len, PointSet& points, bool keep_dtype) {
+    if (!is_binary_dataset(addr, len)) {
+        munmap(addr, len);
+        return false;
+    }
+    BinaryHeader h;
+    std::memcpy(&h, addr, sizeof(h));
+    char* payload = addr + h.offset;
+
+    if (h.dtype == DTYPE_F32 || keep_dtype) {
+        // Zero-copy: point straight into the mapping. The munmap is handed to
+        // the shared_ptr, so the mapping lives exactly as long as the PointSet.
+        // The mapping is private and writable, so in-place writes to coords
+        // copy the touched pages and never reach the file.
+        points.N = h.N;
+        points.D = (int)h.D;
+        points.dtype = h.dtype;
+        points.coords = nullptr;
+        points.coords16 = nullptr;
+        if (h.dtype == DTYPE_F32) points.coords = reinterpret_cast<float*>(payload);
+        else points.coords16 = reinterpret_cast<const uint16_t*>(payload);
+        points.storage.reset(reinterpret_cast<float*>(addr), [addr, len](float*) { munmap(addr, len); });
+        points.dist.resize(h.N);
+        points.id.resize(h.N);
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < h.N; i++) {
+            points.dist[i] = 0.0f;
+            points.id[i] = (uint32_t)i;
+        }
+        // Page-cache pages cannot be re-placed, but any not cached yet are read
+        // in by the thread (and node) whose static slice will scan them
+        numa_prefault(payload, points.data_bytes());
+        return true;
+    }
+
+    points.allocate(h.N, (int)h.D);
+    const uint16_t* src = reinterpret_cast<const uint16_t*>(payload);
+    constexpr size_t kRows = 1024;
+    const size_t blocks = (h.N + kRows - 1) / kRows;
+    #pragma omp parallel for schedule(static)
+    for (size_t b = 0; b < blocks; b++) {
+        size_t rows = std::min<size_t>(kRows, h.N - b * kRows);
+        size_t first = b * kRows * h.D;
+        widen_to_float(src + first, points.coords + first, rows * h.D, h.dtype);
+    }
+    munmap(addr, len);
+    return true;
+}
+
+bool write_points_binary(const std::string& filename, const PointSet& points, uint32_t dtype) {
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        std::cerr << "System Error: " << std::strerror(errno) << " (" << filename << ")" << std::endl;
+        return false;
+    }
+
+    BinaryHeader h = make_binary_header(points.N, points.D, dtype);
+    size_t row_bytes = (size_t)points.D * dtype_size(dtype);
+    bool ok = ftruncate(fd, h.offset + points.N * row_bytes) == 0 &&
+              pwrite(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h);
+
+    // Every row has a fixed offset, so threads write their ranges independently
+    #pragma omp parallel reduction(&&:ok)
+    {
+        const size_t rows_per_write = std::max<size_t>(1, (4 << 20) / std::max<size_t>(1, row_bytes));
+        std::vector<char> buf;
+
+        #pragma omp for schedule(static)
+        for (size_t start = 0; start < points.N; start += rows_per_write) {
+            size_t rows = std::min(rows_per_write, points.N - start);
+            const char* src = reinterpret_cast<const char*>(points.row(start));
+            if (dtype != DTYPE_F32) {
+                buf.resize(rows * row_bytes);
+                narrow_from_float(points.row(start), reinterpret_cast<uint16_t*>(buf.data()), rows * points.D, dtype);
+                src = buf.data();
+            }
+            if (pwrite(fd, src, rows * row_bytes, h.offset + start * row_bytes) != (ssize_t)(rows * row_bytes)) {
+                ok = false;
+            }
+        }
+    }
+
+    if (close(fd) != 0) ok = false;
+    if (!ok) std::cerr << "Error: File write failed (Disk full or quota exceeded?)" << std::endl;
+    return ok;
+}
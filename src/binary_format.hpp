@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "PointSet.hpp"
+
+// Binary dataset layout (.kbin):
+//   [ 64-byte BinaryHeader ][ padding up to `offset` ][ N x D payload, row-major ]
+// The payload starts on an `alignment` boundary (a page by default) so a float32
+// file can be mmapped and handed to the distance kernels without any parsing.
+
+struct BinaryHeader {
+    char magic[8];        // "KNNBIN1\0"
+    uint32_t version;
+    uint32_t dtype;       // DType
+    uint64_t N;
+    uint32_t D;
+    uint32_t alignment;   // payload alignment in bytes
+    uint64_t offset;      // byte offset of the payload
+    uint8_t reserved[24];
+};
+static_assert(sizeof(BinaryHeader) == 64, "BinaryHeader must stay 64 bytes");
+
+constexpr char kBinaryMagic[8] = {'K', 'N', 'N', 'B', 'I', 'N', '1', '\0'};
+constexpr uint32_t kBinaryVersion = 1;
+constexpr uint32_t kDefaultAlignment = 4096;
+
+size_t dtype_size(uint32_t dtype);
+const char* dtype_name(uint32_t dtype);
+bool parse_dtype(const std::string& name, uint32_t& dtype);
+
+// Builds a header for an N x D dataset of the given dtype.
+BinaryHeader make_binary_header(uint64_t N, uint32_t D, uint32_t dtype, uint32_t alignment = kDefaultAlignment);
+
+// True if the mapped bytes start with a valid header: 0 < D <= INT_MAX,
+// N <= UINT32_MAX, and the payload (overflow-checked) fits in len.
+bool is_binary_dataset(const char* addr, size_t len);
+
+// Loads a binary dataset from a private (copy-on-write) PROT_READ|PROT_WRITE
+// mapping and takes ownership of it.
+// float32 payloads are used in place (zero-copy; points.storage unmaps on
+// release). float16 and bfloat16 payloads are widened into an owned float32
+// buffer, or with keep_dtype mapped in place like float32 (points.dtype says which).
+bool load_points_binary(char* addr, size_t len, PointSet& points, bool keep_dtype = false);
+
+// Writes `points` in the binary format with the given payload dtype.
+bool write_points_binary(const std::string& filename, const PointSet& points, uint32_t dtype);
@@ -0,0 +1,35 @@
+#include "binary_format.hpp"
+#include "load_points.hpp"
+#include <iostream>
+#include <string>
+#include <omp.h>
+
+// Converts a dataset (text or binary) into the binary format.
+int main(int argc, char** argv) {
+    if (argc != 3 && argc != 5) {
+        std::cout << "Usage: ./convert_points <input_file> <output_file> [--dtype f32|f16|bf16]\n";
+        return 1;
+    }
+
+    uint32_t dtype = DTYPE_F32;
+    if (argc == 5) {
+        if (std::string(argv[3]) != "--dtype" || !parse_dtype(argv[4], dtype)) {
+            std::cerr << "Invalid dtype option\n";
+            return 1;
+        }
+    }
+
+    double start_time = omp_get_wtime();
+    PointSet pts;
+    if (!load_points(argv[1], pts)) {
+        std::cerr << "Could not load dataset\n";
+        return 1;
+    }
+    double load_time = omp_get_wtime() - start_time;
+
+    if (!write_points_binary(argv[2], pts, dtype)) return 1;
+
+    std::cout << "Converted N=" << pts.size() << ", D=" << pts.D << " to " << dtype_name(dtype)
+              << " (load " << load_time << "s, total " << (omp_get_wtime() - start_time) << "s)\n";
+    return 0;
+}
@@ -0,0 +1,190 @@
+#include "cpu_batch.hpp"
+#include "cpu_topk.hpp"
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+// Tile shape: QB queries x NB data rows. A data tile of NB rows is sized to
+// stay in L2 while all QB queries of the block are scored against it.
+static constexpr int QB = 32;
+static constexpr size_t kTileBytes = 256 * 1024;
+
+static void sq_norms_into(const PointSet& pts, std::vector<float>& norms) {
+    const size_t N = pts.size();
+    const int D = pts.D;
+    norms.resize(N);
+
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < N; i++) {
+        const float* __restrict p = pts.row(i);
+        float sum = 0.0f;
+        #pragma omp simd reduction(+:sum)
+        for (int j = 0; j < D; j++) sum += p[j] * p[j];
+        norms[i] = sum;
+    }
+}
+
+std::vector<float> compute_sq_norms(const PointSet& pts) {
+    std::vector<float> norms;
+    sq_norms_into(pts, norms);
+    return norms;
+}
+
+// 4x4 register-blocked dot products: out[a*4+b] = q_a . x_b
+static inline void dot_4x4(const float* const* q, const float* const* x, int D, float* out) {
+    float s00 = 0, s01 = 0, s02 = 0, s03 = 0, s10 = 0, s11 = 0, s12 = 0, s13 = 0;
+    float s20 = 0, s21 = 0, s22 = 0, s23 = 0, s30 = 0, s31 = 0, s32 = 0, s33 = 0;
+    const float *q0 = q[0], *q1 = q[1], *q2 = q[2], *q3 = q[3];
+    const float *x0 = x[0], *x1 = x[1], *x2 = x[2], *x3 = x[3];
+
+    #pragma omp simd reduction(+:s00,s01,s02,s03,s10,s11,s12,s13,s20,s21,s22,s23,s30,s31,s32,s33)
+    for (int j = 0; j < D; j++) {
+        float a0 = q0[j], a1 = q1[j], a2 = q2[j], a3 = q3[j];
+        float b0 = x0[j], b1 = x1[j], b2 = x2[j], b3 = x3[j];
+        s00 += a0 * b0; s01 += a0 * b1; s02 += a0 * b2; s03 += a0 * b3;
+        s10 += a1 * b0; s11 += a1 * b1; s12 += a1 * b2; s13 += a1 * b3;
+        s20 += a2 * b0; s21 += a2 * b1; s22 += a2 * b2; s23 += a2 * b3;
+        s30 += a3 * b0; s31 += a3 * b1; s32 += a3 * b2; s33 += a3 * b3;
+    }
+    out[0] = s00;  out[1] = s01;  out[2] = s02;  out[3] = s03;
+    out[4] = s10;  out[5] = s11;  out[6] = s12;  out[7] = s13;
+    out[8] = s20;  out[9] = s21;  out[10] = s22; out[11] = s23;
+    out[12] = s30; out[13] = s31; out[14] = s32; out[15] = s33;
+}
+
+// Distances from a dot product and the two squared norms, per metric
+struct L2Form {
+    float operator()(float dot, float xn, float qn) const {
+        // Clamp: cancellation can push near-duplicates slightly negative
+        return std::max(0.0f, xn + qn - 2.0f * dot);
+    }
+};
+struct InnerProductForm {
+    float operator()(float dot, float, float) const { return -dot; }
+};
+struct CosineForm {
+    float operator()(float dot, float xn, float qn) const {
+        float denom = std::sqrt(xn * qn);
+        return denom > 0.0f ? 1.0f - dot / denom : 1.0f;
+    }
+};
+
+// Scores queries [q_begin, q_end) against data rows [x_begin, x_end), pushing
+// every distance into heaps[q - q_begin].
+template <class Form>
+static void score_block(const PointSet& data, const std::vector<float>& xn,
+                        const PointSet& queries, const std::vector<float>& qn,
+                        size_t q_begin, size_t q_end, size_t x_begin, size_t x_end,
+                        size_t nb, TopK* heaps, const Form& form) {
+    const int D = data.D;
+    float dots[16];
+    const float* q_rows[4];
+    const float* x_rows[4];
+
+    for (size_t t = x_begin; t < x_end; t += nb) {
+        size_t t_end = std::min(t + nb, x_end);
+
+        for (size_t q = q_begin; q < q_end; q += 4) {
+            int qc = (int)std::min<size_t>(4, q_end - q);
+            // Short edges reuse the last valid row; those lanes are discarded
+            for (int a = 0; a < 4; a++) q_rows[a] = queries.row(q + std::min(a, qc - 1));
+
+            for (size_t x = t; x < t_end; x += 4) {
+                int xc = (int)std::min<size_t>(4, t_end - x);
+                for (int b = 0; b < 4; b++) x_rows[b] = data.row(x + std::min(b, xc - 1));
+
+                dot_4x4(q_rows, x_rows, D, dots);
+
+                for (int a = 0; a < qc; a++) {
+                    TopK& heap = heaps[q + a - q_begin];
+                    for (int b = 0; b < xc; b++) {
+                        float d = form(dots[a * 4 + b], xn[x + b], qn[q + a]);
+                        if (d <= heap.worst()) heap.push({d, (uint32_t)(x + b)});
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <class Form>
+static void batch_topk_impl(const PointSet& data, const PointSet& queries, size_t k,
+                            const std::vector<float>& data_norms, const Form& form, TopKScratch& scratch,
+                            KeyIdx* out) {
+    const size_t N = data.size();
+    const size_t Q = queries.size();
+    k = std::min(k, N);
+
+    // Caller-supplied norms are used in place (a long-lived server passes the
+    // same vector on every batch)
+    std::vector<float> owned;
+    if (data_norms.empty() && !data.norms.empty()) {
+        // Reuse the norms precomputed at load time
+        owned.resize(N);
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < N; i++) owned[i] = data.norms[i] * data.norms[i];
+    } else if (data_norms.empty()) {
+        owned = compute_sq_norms(data);
+    }
+    const std::vector<float>& xn = data_norms.empty() ? owned : data_norms;
+    std::vector<float>& qn = scratch.query_norms;
+    sq_norms_into(queries, qn);
+
+    size_t nb = std::max<size_t>(16, kTileBytes / (sizeof(float) * std::max(1, data.D)));
+    nb = (nb + 3) / 4 * 4;
+
+    // Work items are (query block, data slice). With few queries the dataset is
+    // split into slices too, so every thread has work; each slice keeps its own
+    // heaps and the slices are merged per query afterwards.
+    size_t q_blocks = (Q + QB - 1) / QB;
+    size_t threads = omp_get_max_threads();
+    size_t slices = std::max<size_t>(1, std::min((threads + q_blocks - 1) / q_blocks, (N + nb - 1) / nb));
+    size_t slice_len = ((N + slices - 1) / slices + nb - 1) / nb * nb;
+
+    TopK* heaps = scratch.reset(slices * Q, k);
+
+    #pragma omp parallel for collapse(2) schedule(dynamic, 1)
+    for (size_t s = 0; s < slices; s++) {
+        for (size_t b = 0; b < q_blocks; b++) {
+            size_t x_begin = std::min(N, s * slice_len);
+            size_t x_end = std::min(N, x_begin + slice_len);
+            size_t q_begin = b * QB;
+            size_t q_end = std::min(Q, q_begin + QB);
+            score_block(data, xn, queries, qn, q_begin, q_end, x_begin, x_end, nb,
+                        &heaps[s * Q + q_begin], form);
+        }
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (size_t q = 0; q < Q; q++) {
+        for (size_t s = 1; s < slices; s++) heaps[q].merge(heaps[s * Q + q]);
+        heaps[q].drain(out + q * k);
+    }
+}
+
+void batch_topk_cpu(const PointSet& data, const PointSet& queries, size_t k, const std::vector<float>& data_norms,
+                    MetricKind metric, TopKScratch& scratch, KeyIdx* out) {
+    switch (metric) {
+        case MetricKind::InnerProduct:
+            return batch_topk_impl(data, queries, k, data_norms, InnerProductForm(), scratch, out);
+        case MetricKind::Cosine: return batch_topk_impl(data, queries, k, data_norms, CosineForm(), scratch, out);
+        case MetricKind::L2: return batch_topk_impl(data, queries, k, data_norms, L2Form(), scratch, out);
+        default: break;
+    }
+
+    // L1 has no dot-product form: fall back to one fused pass per query
+    k = std::min(k, data.size());
+    for (size_t i = 0; i < queries.size(); i++) topk_cpu(data, queries.row(i), k, metric, scratch, out + i * k);
+}
+
+std::vector<std::vector<KeyIdx>> batch_topk_cpu(const PointSet& data, const PointSet& queries, size_t k,
+                                                 const std::vector<float>& data_norms, MetricKind metric) {
+    k = std::min(k, data.size());
+    TopKScratch scratch;
+    std::vector<KeyIdx> flat(queries.size() * k);
+    batch_topk_cpu(data, queries, k, data_norms, metric, scratch, flat.data());
+
+    std::vector<std::vector<KeyIdx>> results(queries.size());
+    for (size_t q = 0; q < queries.size(); q++) results[q].assign(flat.begin() + q * k, flat.begin() + (q + 1) * k);
+    return results;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <vector>
+#include "PointSet.hpp"
+#include "cpu_topk.hpp"
+#include "metrics.hpp"
+
+// Squared L2 norm of every row, computed once and reused across query batches.
+std::vector<float> compute_sq_norms(const PointSet& pts);
+
+// Batched k-NN: top-k rows of `data` for every row of `queries`.
+// Distances are computed tile by tile as ||x||^2 + ||q||^2 - 2 x.q, so each
+// dataset tile is loaded once per block of queries instead of once per query.
+// Inner product and cosine come from the same dot-product tiles; L1 has no
+// such form and falls back to one fused pass per query.
+// `data_norms` (squared) may be empty, in which case it is computed here.
+// Returns one ascending list of min(k, N) keys per query.
+std::vector<std::vector<KeyIdx>> batch_topk_cpu(const PointSet& data, const PointSet& queries, size_t k,
+                                                 const std::vector<float>& data_norms = {},
+                                                 MetricKind metric = MetricKind::L2);
+
+// Same, written row-major to `out` (Q rows of min(k, N) keys) with the heaps
+// and query norms held in `scratch`.
+void batch_topk_cpu(const PointSet& data, const PointSet& queries, size_t k, const std::vector<float>& data_norms,
+                    MetricKind metric, TopKScratch& scratch, KeyIdx* out);
@@ -1,26 +1,67 @@
-#include "Point.hpp"
+#include "PointSet.hpp"
 #include "cpu_distance.hpp"
+#include "distance_kernels.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
 #include <vector>
 #include <cmath>
 
-void compute_distances_cpu(std::vector<Point>& pts, const std::vector<float>& ref) {
-    const int N = pts.size();
-    const int D = ref.size(); 
-    
-    // Pull the reference pointer out to ensure it's treated as a constant address
-    const float* __restrict r_ptr = ref.data();
+// T is the stored element: float, or uint16_t for fp16/bf16 rows
+template <class T, class Metric>
+static void compute_distances_impl(PointSet& pts, const T* base_rows, const Metric& metric) {
+    const size_t N = pts.size();
+    const int D = pts.D;
+
+    // Pull the pointers out to ensure they're treated as constant addresses
+    const T* __restrict base = base_rows;
+    const float* __restrict norms = pts.norms.empty() ? nullptr : pts.norms.data();
+    float* __restrict out = pts.dist.data();
+    uint32_t* __restrict ids = pts.id.data();
 
     #pragma omp parallel for schedule(static)
-    for (int i = 0; i < N; i++) {
-        float sum = 0.0f;
-        const float* __restrict p_ptr = pts[i].coords.data();
+    for (size_t i = 0; i < N; i++) {
+        const T* row = base + i * (size_t)D;
+        float xn = 0.0f;
+        if constexpr (Metric::kNeedsNorms) xn = norms ? norms[i] : row_norm(row, D, pts.dtype);
+        out[i] = metric(row, xn);
+        ids[i] = (uint32_t)i;
+    }
+}
+
+void compute_distances_cpu(PointSet& pts, const std::vector<float>& ref, MetricKind metric) {
+    TRACE_SCOPE("distance");
+    if (!pts.is_f32()) {
+        dispatch_half_metric(metric, pts.dtype, ref.data(), pts.D,
+                             [&](const auto& m) { compute_distances_impl(pts, pts.coords16, m); });
+        return;
+    }
+    dispatch_metric(metric, ref.data(), pts.D, [&](const auto& m) { compute_distances_impl(pts, pts.coords, m); });
+}
+
+void compute_norms(PointSet& pts) {
+    TRACE_SCOPE("norms");
+    const size_t N = pts.size();
+    const int D = pts.D;
+    const DotKernel dot = select_dot_kernel(D);
+    pts.norms.resize(N);
 
-        // The compiler will version this loop for small and large D automatically
-        #pragma omp simd reduction(+:sum)
-        for (int j = 0; j < D; j++) {
-            float diff = p_ptr[j] - r_ptr[j];
-            sum += diff * diff;
+    if (!pts.is_f32()) {
+        // Each row is widened once into a per-thread buffer
+        #pragma omp parallel
+        {
+            std::vector<float> wide(D);
+            #pragma omp for schedule(static)
+            for (size_t i = 0; i < N; i++) {
+                widen_to_float(pts.row16(i), wide.data(), D, pts.dtype);
+                pts.norms[i] = std::sqrt(dot(wide.data(), wide.data(), D));
+            }
         }
-        pts[i].dist = sum;
+        return;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < N; i++) {
+        const float* row = pts.row(i);
+        pts.norms[i] = std::sqrt(dot(row, row, D));
     }
 }
@@ -1,5 +1,23 @@
 #pragma once
 #include <vector>
-#include "Point.hpp"
+#include "PointSet.hpp"
+#include "metrics.hpp"
 
-void compute_distances_cpu(std::vector<Point>& pts, const std::vector<float>& ref);
+// Squared L2 distance between two D-dimensional rows.
+inline float l2_sq(const float* __restrict a, const float* __restrict b, int D) {
+    float sum = 0.0f;
+    // The compiler will version this loop for small and large D automatically
+    #pragma omp simd reduction(+:sum)
+    for (int j = 0; j < D; j++) {
+        float diff = a[j] - b[j];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// Fills pts.dist[i] with the distance of row i under `metric` and resets pts.id.
+void compute_distances_cpu(PointSet& pts, const std::vector<float>& ref, MetricKind metric = MetricKind::L2);
+
+// Fills pts.norms with the L2 norm of every row (once, at load time), so
+// norm-based metrics do not recompute them per query.
+void compute_norms(PointSet& pts);
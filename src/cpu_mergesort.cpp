@@ -2,88 +2,168 @@
 #include <vector>
 #include <omp.h>
 #include <algorithm>
-#include "Point.hpp"
+#include "PointSet.hpp"
+#include "cpu_mergesort.hpp"
+#include "cpu_radixsort.hpp"
+#include "trace.hpp"
+
+// Function object rather than a function pointer so std::sort can inline it
+struct DistLess {
+    bool operator()(const KeyIdx& a, const KeyIdx& b) const { return a.dist < b.dist; }
+};
+static constexpr DistLess dist_less{};
+
+// 1. Co-rank (merge path): how many of the first k outputs of merge(A, B) come
+//    from A. Ties go to A, which keeps the merge stable.
+static size_t co_rank(size_t k, const KeyIdx* A, size_t n1, const KeyIdx* B, size_t n2) {
+    size_t lo = k > n2 ? k - n2 : 0;
+    size_t hi = std::min(k, n1);
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2;
+        // A[i] still belongs before B[k - i - 1]: take more from A
+        if (!dist_less(B[k - i - 1], A[i])) lo = i + 1;
+        else hi = i;
+    }
+    return lo;
+}
+
+static void merge_sequential(const KeyIdx* __restrict A, size_t n1, const KeyIdx* __restrict B, size_t n2,
+                             KeyIdx* __restrict out) {
+    size_t i = 0, j = 0, k = 0;
+    while (i < n1 && j < n2) {
+        if (!dist_less(B[j], A[i])) out[k++] = A[i++];
+        else out[k++] = B[j++];
+    }
+    while (i < n1) out[k++] = A[i++];
+    while (j < n2) out[k++] = B[j++];
+}
 
-// 1. Optimized Merge: Uses a pre-allocated buffer to avoid malloc thrashing
-void merge_optimized(std::vector<Point>& pts, std::vector<Point>& scratch, int left, int mid, int right) {
-    int i = left, j = mid + 1, k = left;
+// 2. Parallel Merge: src[left, mid) and src[mid, right) into dst[left, right).
+//    The output is cut into equal pieces; each task finds its starting point on
+//    the merge path with co_rank and merges its piece independently.
+void merge_parallel(const KeyIdx* src, KeyIdx* dst, size_t left, size_t mid, size_t right, size_t merge_grain) {
+    const KeyIdx* A = src + left;
+    const KeyIdx* B = src + mid;
+    const size_t n1 = mid - left, n2 = right - mid, n = n1 + n2;
 
-    while (i <= mid && j <= right) {
-        if (pts[i].dist <= pts[j].dist) scratch[k++] = pts[i++];
-        else scratch[k++] = pts[j++];
+    if (n <= merge_grain) {
+        merge_sequential(A, n1, B, n2, dst + left);
+        return;
     }
-    while (i <= mid) scratch[k++] = pts[i++];
-    while (j <= right) scratch[k++] = pts[j++];
 
-    // Copy back to original array
-    for (int p = left; p <= right; ++p) {
-        pts[p] = scratch[p];
+    size_t pieces = (n + merge_grain - 1) / merge_grain;
+    #pragma omp taskloop grainsize(1)
+    for (size_t p = 0; p < pieces; p++) {
+        size_t k0 = n * p / pieces, k1 = n * (p + 1) / pieces;
+        size_t i0 = co_rank(k0, A, n1, B, n2), i1 = co_rank(k1, A, n1, B, n2);
+        merge_sequential(A + i0, i1 - i0, B + (k0 - i0), (k1 - i1) - (k0 - i0), dst + left + k0);
     }
 }
 
-// 2. Recursive Logic: Uses tasks and a sequential cutoff for cache efficiency
-void mergesort_recursive(std::vector<Point>& pts, std::vector<Point>& scratch, int left, int right, int grain_size) {
-    if (left >= right) return;
-
-    // Sequential Fallback: Below this size, the overhead of a 'task' costs more than the sort
-    if (right - left < grain_size) {
-        std::sort(pts.begin() + left, pts.begin() + right + 1, [](const Point& a, const Point& b) {
-            return a.dist < b.dist;
-        });
+// 3. Recursive Logic: tasks down to a sequential cutoff. Buffers ping-pong
+//    between levels: the halves are sorted into the other buffer and merged
+//    back, so no level copies its result back. `into_scratch` says which
+//    buffer must hold keys[left, right) sorted on return.
+void mergesort_recursive(KeyIdx* keys, KeyIdx* scratch, size_t left, size_t right, bool into_scratch,
+                         size_t grain_size, size_t merge_grain) {
+    if (right - left <= grain_size) {
+        std::sort(keys + left, keys + right, dist_less);
+        if (into_scratch) std::copy(keys + left, keys + right, scratch + left);
         return;
     }
 
-    int mid = left + (right - left) / 2;
+    size_t mid = left + (right - left) / 2;
 
-    #pragma omp task shared(pts, scratch)
-    mergesort_recursive(pts, scratch, left, mid, grain_size);
+    #pragma omp task
+    mergesort_recursive(keys, scratch, left, mid, !into_scratch, grain_size, merge_grain);
 
-    #pragma omp task shared(pts, scratch)
-    mergesort_recursive(pts, scratch, mid + 1, right, grain_size);
+    #pragma omp task
+    mergesort_recursive(keys, scratch, mid, right, !into_scratch, grain_size, merge_grain);
 
     #pragma omp taskwait
-    merge_optimized(pts, scratch, left, mid, right);
+    if (into_scratch) merge_parallel(keys, scratch, left, mid, right, merge_grain);
+    else merge_parallel(scratch, keys, left, mid, right, merge_grain);
 }
 
-// 3. Entry Point: Sets up the parallel environment
-void mergesort_cpu(std::vector<Point>& pts) {
-    int n = pts.size();
+size_t default_merge_grain(size_t n, int threads, size_t tasks_per_thread) {
+    return std::max<size_t>(2000, n / ((size_t)std::max(1, threads) * std::max<size_t>(1, tasks_per_thread)));
+}
+
+// Key Engine: Sorts packed (dist, idx) keys in place with the task mergesort
+void sort_keys_cpu(numa_vector<KeyIdx>& keys, size_t grain_size) {
+    size_t n = keys.size();
     if (n <= 1) return;
 
-    // Allocate scratchpad once (allocated on NUMA nodes based on first-touch)
-    std::vector<Point> scratch(n);
+    // Allocate scratchpad once; numa_vector places its pages by the NUMA policy
+    numa_vector<KeyIdx> scratch(n);
 
-    // Calculate grain size: aims for ~8 tasks per thread for load balancing
-    int num_threads = omp_get_max_threads();
-    int grain_size = std::max(2000, n / (num_threads * 8));
+    // Grain size: by default ~8 tasks per thread for load balancing (the
+    // autotuner may pick another). Merges are split into pieces of the same
+    // order, so the top levels keep every thread busy instead of merging all
+    // N keys on one core.
+    size_t num_threads = omp_get_max_threads();
+    if (grain_size == 0) grain_size = default_merge_grain(n, (int)num_threads);
+    size_t merge_grain = std::max<size_t>(1 << 14, n / (num_threads * 4));
 
     #pragma omp parallel
-    {
-        // First-touch initialization for the scratchpad
-        #pragma omp for
-        for(int i = 0; i < n; i++) {
-            scratch[i].dist = 0; 
-        }
-
-        #pragma omp single nowait
-        {
-            mergesort_recursive(pts, scratch, 0, n - 1, grain_size);
-        }
-    }
+    #pragma omp single nowait
+    mergesort_recursive(keys.data(), scratch.data(), 0, n, false, grain_size, merge_grain);
+}
+
+// 4. Permutation API: perm[i] is the row holding the i-th smallest distance
+std::vector<uint32_t> argsort_cpu(const float* dist, size_t n) {
+    numa_vector<KeyIdx> keys(n);
+
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++) keys[i] = {dist[i], (uint32_t)i};
+
+    sort_keys_cpu(keys);
+
+    std::vector<uint32_t> perm(n);
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++) perm[i] = keys[i].idx;
+    return perm;
 }
 
-// Distance computation: Spreads workload across all 128 cores
-void compute_distances(std::vector<Point>& pts, const std::vector<float>& ref) {
+// 5. PointSet Entry Point: Packs (dist, id), sorts the keys, unpacks in order
+void sort_points_cpu(PointSet& pts, SortAlgo algo, size_t grain_size) {
+    TRACE_SCOPE("sort_points");
     int n = pts.size();
-    int d = ref.size();
+    if (n <= 1) return;
+
+    numa_vector<KeyIdx> keys;
+    {
+        TRACE_SCOPE("sort.pack");
+        keys.resize(n);
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < n; i++) keys[i] = {pts.dist[i], pts.id[i]};
+    }
+
+    {
+        TRACE_SCOPE(algo == SortAlgo::Radix ? "sort.radix" : "sort.merge");
+        if (algo == SortAlgo::Radix) radix_sort_keys_cpu(keys);
+        else sort_keys_cpu(keys, grain_size);
+    }
 
+    TRACE_SCOPE("sort.unpack");
     #pragma omp parallel for schedule(static)
     for (int i = 0; i < n; i++) {
-        float sum = 0.0f;
-        for (int j = 0; j < d; j++) {
-            float diff = pts[i].coords[j] - ref[j];
-            sum += diff * diff;
-        }
-        pts[i].dist = sum;
+        pts.dist[i] = keys[i].dist;
+        pts.id[i] = keys[i].idx;
     }
 }
+
+void mergesort_cpu(PointSet& pts) {
+    sort_points_cpu(pts, SortAlgo::Merge);
+}
+
+bool parse_sort_algo(const std::string& name, SortAlgo& algo) {
+    if (name == "merge") algo = SortAlgo::Merge;
+    else if (name == "radix") algo = SortAlgo::Radix;
+    else return false;
+    return true;
+}
+
+const char* sort_algo_name(SortAlgo algo) {
+    return algo == SortAlgo::Radix ? "Radix" : "Mergesort";
+}
@@ -1,9 +1,38 @@
 #pragma once
+#include <string>
 #include <vector>
-#include "Point.hpp"
+#include "PointSet.hpp"
 
+// CPU sort algorithm for the (dist, idx) keys
+enum class SortAlgo { Merge, Radix };
 
-void mergesort_cpu(std::vector<Point>& pts);
+bool parse_sort_algo(const std::string& name, SortAlgo& algo);
+const char* sort_algo_name(SortAlgo algo);
 
-// The internal recursive function (optional to keep in header)
-void mergesort_recursive(std::vector<Point>& pts, std::vector<Point>& scratch, int left, int right, int grain_size);
+// Sorts packed (dist, idx) keys ascending in place. Only the 8-byte keys move.
+// grain_size is the largest range sorted sequentially by one task; 0 picks
+// default_merge_grain(n, threads).
+void sort_keys_cpu(numa_vector<KeyIdx>& keys, size_t grain_size = 0);
+
+// ~tasks_per_thread leaf tasks per thread, and never below 2000 keys
+size_t default_merge_grain(size_t n, int threads, size_t tasks_per_thread = 8);
+
+// Returns the permutation that orders dist[0, n) ascending: perm[i] is the index
+// of the i-th smallest value. Pair with PermutedView to read points in that order.
+std::vector<uint32_t> argsort_cpu(const float* dist, size_t n);
+
+// Sorts pts.dist ascending, carrying pts.id along; coordinates are not moved.
+void mergesort_cpu(PointSet& pts);
+
+// Same contract as mergesort_cpu with a selectable algorithm; grain_size is
+// passed to sort_keys_cpu (mergesort only).
+void sort_points_cpu(PointSet& pts, SortAlgo algo, size_t grain_size = 0);
+
+// Merges src[left, mid) and src[mid, right) into dst[left, right), split into
+// ~merge_grain-sized tasks along the merge path. Call inside a parallel region.
+void merge_parallel(const KeyIdx* src, KeyIdx* dst, size_t left, size_t mid, size_t right, size_t merge_grain);
+
+// The internal recursive function: sorts keys[left, right) into `scratch` if
+// into_scratch, otherwise into `keys`; the two buffers alternate per level.
+void mergesort_recursive(KeyIdx* keys, KeyIdx* scratch, size_t left, size_t right, bool into_scratch,
+                         size_t grain_size, size_t merge_grain);
@@ -0,0 +1,206 @@
+#include "cpu_prune.hpp"
+#include "cpu_topk.hpp"
+#include "distance_kernels.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <numeric>
+#include <omp.h>
+
+bool supports_early_abandon(MetricKind metric) {
+    return metric == MetricKind::L2 || metric == MetricKind::L1;
+}
+
+static AbandonKernel select_abandon(MetricKind metric, int D) {
+    return metric == MetricKind::L1 ? select_l1_abandon_kernel(D) : select_l2_abandon_kernel(D);
+}
+
+// Full-scan accounting for the paths that cannot prune
+static void count_full_scan(const PointSet& pts, PruneStats* stats) {
+    if (!stats) return;
+    *stats = PruneStats();
+    stats->rows = pts.size();
+    stats->coords = stats->coords_total = pts.size() * (uint64_t)pts.D;
+}
+
+std::vector<KeyIdx> topk_abandon_cpu(const PointSet& pts, const std::vector<float>& ref, size_t k, MetricKind metric,
+                                     PruneStats* stats) {
+    if (!supports_early_abandon(metric) || !pts.is_f32()) {
+        count_full_scan(pts, stats);
+        return topk_cpu(pts, ref, k, metric);
+    }
+    TRACE_SCOPE("distance+topk (abandon)");
+    const size_t N = pts.size();
+    const int D = pts.D;
+    k = std::min(k, N);
+    const AbandonKernel kernel = select_abandon(metric, D);
+    const int block = abandon_block(D);
+    const float* __restrict base = pts.coords;
+    const float* q = ref.data();
+
+    std::vector<TopK> partial(omp_get_max_threads(), TopK(k));
+    size_t abandoned = 0, rejected = 0;
+    uint64_t coords = 0;
+
+    #pragma omp parallel reduction(+:abandoned, rejected, coords)
+    {
+        TopK& local = partial[omp_get_thread_num()];
+
+        #pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < N; i++) {
+            // A row equal to the bound can still enter on a smaller index, so
+            // only rows strictly above it are abandoned
+            const float bound = local.worst();
+            int dims;
+            float d = kernel(base + i * (size_t)D, q, D, block, bound, dims);
+            coords += dims;
+            if (d > bound) {
+                // Only a row cut short saved any reads
+                if (dims < D) abandoned++;
+                else rejected++;
+                continue;
+            }
+            local.push({d, (uint32_t)i});
+        }
+    }
+
+    if (stats) {
+        stats->rows = N;
+        stats->abandoned = abandoned;
+        stats->rejected = rejected;
+        stats->coords = coords;
+        stats->coords_total = N * (uint64_t)D;
+    }
+
+    TopK result(k);
+    for (const TopK& t : partial) result.merge(t);
+    return result.sorted();
+}
+
+// Radius scan with the full metric policies (ip, cosine, fp16/bf16 stores)
+template <class T, class Metric>
+static void radius_full_impl(const PointSet& pts, const T* base, float radius, const Metric& metric,
+                             std::vector<std::vector<KeyIdx>>& partial) {
+    const size_t N = pts.size();
+    const int D = pts.D;
+    const float* __restrict norms = pts.norms.empty() ? nullptr : pts.norms.data();
+
+    #pragma omp parallel
+    {
+        std::vector<KeyIdx>& local = partial[omp_get_thread_num()];
+
+        #pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < N; i++) {
+            const T* row = base + i * (size_t)D;
+            float xn = 0.0f;
+            if constexpr (Metric::kNeedsNorms) xn = norms ? norms[i] : row_norm(row, D, pts.dtype);
+            float d = metric(row, xn);
+            if (d <= radius) local.push_back({d, (uint32_t)i});
+        }
+    }
+}
+
+std::vector<KeyIdx> radius_cpu(const PointSet& pts, const std::vector<float>& ref, float radius, MetricKind metric,
+                               PruneStats* stats) {
+    TRACE_SCOPE("radius");
+    const size_t N = pts.size();
+    const int D = pts.D;
+    std::vector<std::vector<KeyIdx>> partial(omp_get_max_threads());
+
+    if (!supports_early_abandon(metric) || !pts.is_f32()) {
+        count_full_scan(pts, stats);
+        if (!pts.is_f32()) {
+            dispatch_half_metric(metric, pts.dtype, ref.data(), D,
+                                 [&](const auto& m) { radius_full_impl(pts, pts.coords16, radius, m, partial); });
+        } else {
+            dispatch_metric(metric, ref.data(), D,
+                            [&](const auto& m) { radius_full_impl(pts, pts.coords, radius, m, partial); });
+        }
+    } else {
+        const AbandonKernel kernel = select_abandon(metric, D);
+        const int block = abandon_block(D);
+        const float* __restrict base = pts.coords;
+        const float* q = ref.data();
+        size_t abandoned = 0, rejected = 0;
+        uint64_t coords = 0;
+
+        #pragma omp parallel reduction(+:abandoned, rejected, coords)
+        {
+            std::vector<KeyIdx>& local = partial[omp_get_thread_num()];
+
+            #pragma omp for schedule(static) nowait
+            for (size_t i = 0; i < N; i++) {
+                int dims;
+                float d = kernel(base + i * (size_t)D, q, D, block, radius, dims);
+                coords += dims;
+                if (d > radius) {
+                    if (dims < D) abandoned++;
+                    else rejected++;
+                    continue;
+                }
+                local.push_back({d, (uint32_t)i});
+            }
+        }
+
+        if (stats) {
+            stats->rows = N;
+            stats->abandoned = abandoned;
+            stats->rejected = rejected;
+            stats->coords = coords;
+            stats->coords_total = N * (uint64_t)D;
+        }
+    }
+
+    size_t total = 0;
+    for (const auto& p : partial) total += p.size();
+    std::vector<KeyIdx> out;
+    out.reserve(total);
+    for (const auto& p : partial) out.insert(out.end(), p.begin(), p.end());
+    std::sort(out.begin(), out.end(), key_less);
+    return out;
+}
+
+std::vector<uint32_t> dims_by_variance(const PointSet& pts) {
+    TRACE_SCOPE("dim variance");
+    const size_t N = pts.size();
+    const int D = pts.D;
+    // Per-column sums in double: sum x and sum x^2 over millions of rows
+    std::vector<double> sum(D, 0.0), sum_sq(D, 0.0);
+
+    #pragma omp parallel
+    {
+        std::vector<double> s(D, 0.0), s2(D, 0.0);
+        std::vector<float> wide(pts.is_f32() ? 0 : D);
+
+        #pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < N; i++) {
+            const float* r = pts.is_f32() ? pts.row(i) : wide.data();
+            if (!pts.is_f32()) widen_to_float(pts.row16(i), wide.data(), D, pts.dtype);
+            for (int j = 0; j < D; j++) {
+                s[j] += r[j];
+                s2[j] += (double)r[j] * r[j];
+            }
+        }
+
+        #pragma omp critical
+        for (int j = 0; j < D; j++) {
+            sum[j] += s[j];
+            sum_sq[j] += s2[j];
+        }
+    }
+
+    std::vector<double> var(D, 0.0);
+    for (int j = 0; j < D && N > 0; j++) {
+        double mean = sum[j] / N;
+        var[j] = sum_sq[j] / N - mean * mean;
+    }
+
+    // Stable, so equal variances keep the stored order
+    std::vector<uint32_t> order(D);
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return var[a] > var[b]; });
+    return order;
+}
+
+void permute_query(const float* q, const std::vector<uint32_t>& order, float* out) {
+    for (size_t j = 0; j < order.size(); j++) out[j] = q[order[j]];
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "PointSet.hpp"
+#include "metrics.hpp"
+
+// Early-abandoning single-query scans. For l2 and l1 the partial sum over
+// the first j dimensions never decreases, so a row can be dropped as soon as
+// it exceeds the current threshold: the top-k heap's worst entry, or the
+// radius. The scans use the AbandonKernel variants of the distance kernels;
+// ip and cosine (not monotone) and fp16/bf16 stores fall back to the full
+// kernels, so every metric is supported and only l2/l1 prune.
+//
+// Reordering the columns by decreasing variance (dims_by_variance) puts the
+// dimensions that separate rows best first, so partial sums cross the
+// threshold after fewer blocks. Every metric here is invariant under a
+// column permutation, as long as the query is permuted the same way.
+
+struct PruneStats {
+    size_t rows = 0;           // rows scanned
+    size_t abandoned = 0;      // rows dropped before their last dimension
+    size_t rejected = 0;       // rows read in full, then found past the bound
+    uint64_t coords = 0;       // coordinates read
+    uint64_t coords_total = 0; // rows * D: what a full scan reads
+
+    double abandoned_fraction() const { return rows ? (double)abandoned / rows : 0.0; }
+    double skipped_fraction() const { return coords_total ? 1.0 - (double)coords / coords_total : 0.0; }
+};
+
+// True for the metrics whose scans can abandon rows early (l2, l1).
+bool supports_early_abandon(MetricKind metric);
+
+// Top-k like topk_cpu, with rows abandoned against each thread's heap bound.
+std::vector<KeyIdx> topk_abandon_cpu(const PointSet& pts, const std::vector<float>& ref, size_t k,
+                                     MetricKind metric = MetricKind::L2, PruneStats* stats = nullptr);
+
+// Every row with distance <= radius under `metric` (squared for l2, as the
+// distances are reported), ascending by distance.
+std::vector<KeyIdx> radius_cpu(const PointSet& pts, const std::vector<float>& ref, float radius,
+                               MetricKind metric = MetricKind::L2, PruneStats* stats = nullptr);
+
+// Column order by decreasing variance over all rows, for
+// PointSet::permute_dims. Queries then go through permute_query.
+std::vector<uint32_t> dims_by_variance(const PointSet& pts);
+// out[j] = q[order[j]] for every column j of the reordered set
+void permute_query(const float* q, const std::vector<uint32_t>& order, float* out);
@@ -0,0 +1,85 @@
+#include "cpu_radixsort.hpp"
+#include <algorithm>
+#include <cstring>
+#include <omp.h>
+
+static constexpr int kDigitBits = 11;
+static constexpr int kBuckets = 1 << kDigitBits;
+static constexpr int kPasses = (32 + kDigitBits - 1) / kDigitBits;
+
+// Order-preserving float -> uint32: flip all bits of negatives, only the sign of positives
+static inline uint32_t sortable_bits(float f) {
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+}
+
+void radix_sort_keys_cpu(numa_vector<KeyIdx>& keys) {
+    const size_t n = keys.size();
+    if (n <= 1) return;
+
+    // Small inputs: the histogram passes cost more than a comparison sort
+    if (n < 4096) {
+        std::stable_sort(keys.begin(), keys.end(), [](const KeyIdx& a, const KeyIdx& b) { return a.dist < b.dist; });
+        return;
+    }
+
+    numa_vector<KeyIdx> scratch(n);
+    const int T = omp_get_max_threads();
+    // hist[t * kBuckets + d]: count of digit d in thread t's block, then its scatter offset
+    std::vector<size_t> hist((size_t)T * kBuckets);
+
+    KeyIdx* src = keys.data();
+    KeyIdx* dst = scratch.data();
+
+    for (int pass = 0; pass < kPasses; pass++) {
+        const int shift = pass * kDigitBits;
+        bool skip = false;
+
+        #pragma omp parallel num_threads(T)
+        {
+            const int t = omp_get_thread_num();
+            const int nt = omp_get_num_threads();
+            const size_t begin = n * t / nt;
+            const size_t end = n * (t + 1) / nt;
+            size_t* h = &hist[(size_t)t * kBuckets];
+
+            // 1. Per-thread histogram
+            std::fill(h, h + kBuckets, 0);
+            for (size_t i = begin; i < end; i++) {
+                h[(sortable_bits(src[i].dist) >> shift) & (kBuckets - 1)]++;
+            }
+
+            #pragma omp barrier
+            // 2. Exclusive prefix sum in (digit, thread) order keeps the scatter stable
+            #pragma omp single
+            {
+                size_t sum = 0;
+                for (int d = 0; d < kBuckets; d++) {
+                    size_t digit_total = 0;
+                    for (int tt = 0; tt < nt; tt++) {
+                        size_t c = hist[(size_t)tt * kBuckets + d];
+                        hist[(size_t)tt * kBuckets + d] = sum;
+                        sum += c;
+                        digit_total += c;
+                    }
+                    // Every key has this digit: the pass would be an identity permutation
+                    if (digit_total == n) skip = true;
+                }
+            }
+
+            // 3. Scatter
+            if (!skip) {
+                for (size_t i = begin; i < end; i++) {
+                    uint32_t d = (sortable_bits(src[i].dist) >> shift) & (kBuckets - 1);
+                    dst[h[d]++] = src[i];
+                }
+            }
+        }
+
+        if (!skip) std::swap(src, dst);
+    }
+
+    // An odd number of effective passes leaves the result in scratch
+    if (src != keys.data()) keys.swap(scratch);
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <vector>
+#include "PointSet.hpp"
+
+// Parallel LSD radix sort of packed (dist, idx) keys, ascending by dist.
+// Float bits are mapped to order-preserving unsigned integers (negative
+// distances from the ip/cosine metrics sort correctly too), then sorted with
+// 11-bit digits: per-thread histograms, a prefix sum over (digit, thread),
+// and a stable scatter. Passes where every key shares a digit are skipped.
+void radix_sort_keys_cpu(numa_vector<KeyIdx>& keys);
@@ -0,0 +1,120 @@
+#include "cpu_topk.hpp"
+#include "cpu_distance.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <omp.h>
+
+void TopK::reset(size_t k_) {
+    k = k_;
+    heap.clear();
+    heap.reserve(k_);
+}
+
+float TopK::worst() const {
+    return heap.size() < k ? std::numeric_limits<float>::infinity() : heap.front().dist;
+}
+
+void TopK::push(KeyIdx key) {
+    if (k == 0) return;
+    if (heap.size() < k) {
+        heap.push_back(key);
+        std::push_heap(heap.begin(), heap.end(), key_less);
+    } else if (key_less(key, heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), key_less);
+        heap.back() = key;
+        std::push_heap(heap.begin(), heap.end(), key_less);
+    }
+}
+
+void TopK::merge(const TopK& other) {
+    for (const KeyIdx& key : other.heap) push(key);
+}
+
+std::vector<KeyIdx> TopK::sorted() {
+    std::sort_heap(heap.begin(), heap.end(), key_less);
+    return std::move(heap);
+}
+
+size_t TopK::drain(KeyIdx* out) {
+    std::sort_heap(heap.begin(), heap.end(), key_less);
+    const size_t n = heap.size();
+    std::copy(heap.begin(), heap.end(), out);
+    heap.clear();
+    return n;
+}
+
+TopK* TopKScratch::reset(size_t n, size_t k) {
+    if (heaps.size() < n) heaps.resize(n);
+    for (size_t i = 0; i < n; i++) heaps[i].reset(k);
+    return heaps.data();
+}
+
+// T is the stored element: float, or uint16_t for fp16/bf16 rows
+template <class T, class Metric>
+static size_t topk_impl(const PointSet& pts, const T* base_rows, size_t k, const Metric& metric,
+                        TopKScratch& scratch, KeyIdx* out) {
+    const size_t N = pts.size();
+    const int D = pts.D;
+    k = std::min(k, N);
+
+    const T* __restrict base = base_rows;
+    const float* __restrict norms = pts.norms.empty() ? nullptr : pts.norms.data();
+
+    const int threads = omp_get_max_threads();
+    TopK* partial = scratch.reset(threads, k);
+
+    #pragma omp parallel
+    {
+        TopK& local = partial[omp_get_thread_num()];
+
+        #pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < N; i++) {
+            const T* row = base + i * (size_t)D;
+            float xn = 0.0f;
+            if constexpr (Metric::kNeedsNorms) xn = norms ? norms[i] : row_norm(row, D, pts.dtype);
+            float d = metric(row, xn);
+            // Cheap reject before touching the heap: the common case once it is full
+            if (d <= local.worst()) local.push({d, (uint32_t)i});
+        }
+    }
+
+    // Merge per-thread results into the first heap: O(T * k log k)
+    for (int t = 1; t < threads; t++) partial[0].merge(partial[t]);
+    return partial[0].drain(out);
+}
+
+std::vector<KeyIdx> rerank_exact(const PointSet& pts, const float* q, const std::vector<KeyIdx>& cands, size_t k,
+                                 MetricKind metric) {
+    TopK best(k);
+    dispatch_metric(metric, q, pts.D, [&](const auto& m) {
+        using Metric = std::decay_t<decltype(m)>;
+        for (const KeyIdx& c : cands) {
+            const float* row = pts.row(c.idx);
+            float xn = 0.0f;
+            if constexpr (Metric::kNeedsNorms) xn = pts.norms.empty() ? row_norm(row, pts.D) : pts.norms[c.idx];
+            best.push({m(row, xn), c.idx});
+        }
+    });
+    return best.sorted();
+}
+
+size_t topk_cpu(const PointSet& pts, const float* ref, size_t k, MetricKind metric, TopKScratch& scratch,
+                KeyIdx* out) {
+    TRACE_SCOPE("distance+topk");
+    if (!pts.is_f32()) {
+        return dispatch_half_metric(metric, pts.dtype, ref, pts.D,
+                                    [&](const auto& m) { return topk_impl(pts, pts.coords16, k, m, scratch, out); });
+    }
+    return dispatch_metric(metric, ref, pts.D,
+                           [&](const auto& m) { return topk_impl(pts, pts.coords, k, m, scratch, out); });
+}
+
+std::vector<KeyIdx> topk_cpu(const PointSet& pts, const std::vector<float>& ref, size_t k, MetricKind metric) {
+    TopKScratch scratch;
+    std::vector<KeyIdx> out(std::min(k, pts.size()));
+    out.resize(topk_cpu(pts, ref.data(), k, metric, scratch, out.data()));
+    return out;
+}
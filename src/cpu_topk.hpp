@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include "PointSet.hpp"
+#include "metrics.hpp"
+
+// Strict ordering on (dist, idx) so ties resolve the same way on every run.
+inline bool key_less(const KeyIdx& a, const KeyIdx& b) {
+    return a.dist < b.dist || (a.dist == b.dist && a.idx < b.idx);
+}
+
+// Bounded max-heap holding the k smallest keys seen so far.
+struct TopK {
+    size_t k = 0;
+    std::vector<KeyIdx> heap;
+
+    explicit TopK(size_t k_ = 0) : k(k_) { heap.reserve(k_); }
+
+    // Empties the heap for a new bound, keeping its storage.
+    void reset(size_t k_);
+    // Current admission threshold: anything at or above it cannot enter.
+    float worst() const;
+    void push(KeyIdx key);
+    void merge(const TopK& other);
+    // Drains the heap into ascending order.
+    std::vector<KeyIdx> sorted();
+    // Same, into out[0, n); returns n and keeps the storage.
+    size_t drain(KeyIdx* out);
+};
+
+// Heaps (and batch query norms) a caller keeps across searches, so repeated
+// top-k calls of the same shape reuse them instead of allocating.
+struct TopKScratch {
+    std::vector<TopK> heaps;
+    std::vector<float> query_norms;
+
+    // The first `n` heaps, emptied, with bound k
+    TopK* reset(size_t n, size_t k);
+};
+
+// Fused distance + selection: one pass over the coordinates, each thread keeps
+// its own bounded heap, and the per-thread heaps are merged at the end.
+// Returns the min(k, N) nearest rows in ascending distance under `metric`;
+// pts.norms is used when filled and the metric needs norms.
+std::vector<KeyIdx> topk_cpu(const PointSet& pts, const std::vector<float>& ref, size_t k,
+                             MetricKind metric = MetricKind::L2);
+
+// Same, written to out[0, min(k, N)) with the heaps held in `scratch`;
+// returns the number of keys written.
+size_t topk_cpu(const PointSet& pts, const float* ref, size_t k, MetricKind metric, TopKScratch& scratch,
+                KeyIdx* out);
+
+// Exact top-k of the candidate rows `cands` (any order; only idx is read)
+// under `metric`: the re-rank step of the approximate scans.
+std::vector<KeyIdx> rerank_exact(const PointSet& pts, const float* q, const std::vector<KeyIdx>& cands, size_t k,
+                                 MetricKind metric);
@@ -0,0 +1,496 @@
+#include "distance_kernels.hpp"
+#include "cpu_distance.hpp"
+#include "half.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KNN_X86 1
+#endif
+
+/* ---------------- scalar ---------------- */
+template <int DIM>
+static float l2_scalar(const float* a, const float* b, int D) {
+    return l2_sq(a, b, DIM > 0 ? DIM : D);
+}
+
+template <int DIM>
+static float dot_scalar(const float* __restrict a, const float* __restrict b, int D_) {
+    const int D = DIM > 0 ? DIM : D_;
+    float sum = 0.0f;
+    #pragma omp simd reduction(+:sum)
+    for (int j = 0; j < D; j++) sum += a[j] * b[j];
+    return sum;
+}
+
+#if KNN_X86
+/* ---------------- AVX2 + FMA ---------------- */
+__attribute__((target("avx2,fma")))
+static inline float hsum256(__m256 v) {
+    __m128 lo = _mm256_castps256_ps128(v);
+    __m128 hi = _mm256_extractf128_ps(v, 1);
+    lo = _mm_add_ps(lo, hi);
+    lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+    lo = _mm_add_ss(lo, _mm_movehdup_ps(lo));
+    return _mm_cvtss_f32(lo);
+}
+
+// Four independent accumulators hide the 4-cycle FMA latency
+template <int DIM>
+__attribute__((target("avx2,fma")))
+static float l2_avx2(const float* a, const float* b, int D_) {
+    const int D = DIM > 0 ? DIM : D_;
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+    int j = 0;
+    for (; j + 32 <= D; j += 32) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + j), _mm256_loadu_ps(b + j));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + j + 8), _mm256_loadu_ps(b + j + 8));
+        __m256 d2 = _mm256_sub_ps(_mm256_loadu_ps(a + j + 16), _mm256_loadu_ps(b + j + 16));
+        __m256 d3 = _mm256_sub_ps(_mm256_loadu_ps(a + j + 24), _mm256_loadu_ps(b + j + 24));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+        acc2 = _mm256_fmadd_ps(d2, d2, acc2);
+        acc3 = _mm256_fmadd_ps(d3, d3, acc3);
+    }
+    for (; j + 8 <= D; j += 8) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + j), _mm256_loadu_ps(b + j));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+    }
+    float sum = hsum256(_mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3)));
+    for (; j < D; j++) {
+        float diff = a[j] - b[j];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+template <int DIM>
+__attribute__((target("avx2,fma")))
+static float dot_avx2(const float* a, const float* b, int D_) {
+    const int D = DIM > 0 ? DIM : D_;
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+    int j = 0;
+    for (; j + 32 <= D; j += 32) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + j), _mm256_loadu_ps(b + j), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + j + 8), _mm256_loadu_ps(b + j + 8), acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + j + 16), _mm256_loadu_ps(b + j + 16), acc2);
+        acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + j + 24), _mm256_loadu_ps(b + j + 24), acc3);
+    }
+    for (; j + 8 <= D; j += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + j), _mm256_loadu_ps(b + j), acc0);
+    }
+    float sum = hsum256(_mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3)));
+    for (; j < D; j++) sum += a[j] * b[j];
+    return sum;
+}
+
+/* ---------------- AVX-512 ---------------- */
+template <int DIM>
+__attribute__((target("avx512f,avx2,fma")))
+static float l2_avx512(const float* a, const float* b, int D_) {
+    const int D = DIM > 0 ? DIM : D_;
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+    int j = 0;
+    for (; j + 64 <= D; j += 64) {
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + j), _mm512_loadu_ps(b + j));
+        __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + j + 16), _mm512_loadu_ps(b + j + 16));
+        __m512 d2 = _mm512_sub_ps(_mm512_loadu_ps(a + j + 32), _mm512_loadu_ps(b + j + 32));
+        __m512 d3 = _mm512_sub_ps(_mm512_loadu_ps(a + j + 48), _mm512_loadu_ps(b + j + 48));
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+        acc2 = _mm512_fmadd_ps(d2, d2, acc2);
+        acc3 = _mm512_fmadd_ps(d3, d3, acc3);
+    }
+    for (; j + 16 <= D; j += 16) {
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + j), _mm512_loadu_ps(b + j));
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+    }
+    if (j < D) {
+        // Masked tail: no scalar cleanup loop
+        __mmask16 m = (__mmask16)((1u << (D - j)) - 1);
+        __m512 d0 = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, a + j), _mm512_maskz_loadu_ps(m, b + j));
+        acc1 = _mm512_fmadd_ps(d0, d0, acc1);
+    }
+    // Fold to 256 bits through memory (GCC 12 warns spuriously on _mm512_reduce_add_ps)
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, _mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3)));
+    return hsum256(_mm256_add_ps(_mm256_load_ps(lanes), _mm256_load_ps(lanes + 8)));
+}
+
+template <int DIM>
+__attribute__((target("avx512f,avx2,fma")))
+static float dot_avx512(const float* a, const float* b, int D_) {
+    const int D = DIM > 0 ? DIM : D_;
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+    int j = 0;
+    for (; j + 64 <= D; j += 64) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + j), _mm512_loadu_ps(b + j), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + j + 16), _mm512_loadu_ps(b + j + 16), acc1);
+        acc2 = _mm512_fmadd_ps(_mm512_loadu_ps(a + j + 32), _mm512_loadu_ps(b + j + 32), acc2);
+        acc3 = _mm512_fmadd_ps(_mm512_loadu_ps(a + j + 48), _mm512_loadu_ps(b + j + 48), acc3);
+    }
+    for (; j + 16 <= D; j += 16) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + j), _mm512_loadu_ps(b + j), acc0);
+    }
+    if (j < D) {
+        __mmask16 m = (__mmask16)((1u << (D - j)) - 1);
+        acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + j), _mm512_maskz_loadu_ps(m, b + j), acc1);
+    }
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, _mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3)));
+    return hsum256(_mm256_add_ps(_mm256_load_ps(lanes), _mm256_load_ps(lanes + 8)));
+}
+#endif
+
+/* ---------------- 16-bit rows ---------------- */
+// One template per ISA covers all three metrics and both storage types; the
+// row is widened right after the load and everything else is float32.
+enum class HalfOp { L2, Dot, L1 };
+
+template <uint32_t DT>
+static inline float widen1(uint16_t h) {
+    return DT == DTYPE_BF16 ? bf16_to_float(h) : half_to_float(h);
+}
+
+template <HalfOp OP>
+static inline float half_term(float x, float q) {
+    if (OP == HalfOp::Dot) return x * q;
+    float diff = x - q;
+    return OP == HalfOp::L2 ? diff * diff : std::fabs(diff);
+}
+
+template <HalfOp OP, uint32_t DT>
+static float half_scalar(const uint16_t* __restrict x, const float* __restrict q, int D) {
+    float sum = 0.0f;
+    for (int j = 0; j < D; j++) sum += half_term<OP>(widen1<DT>(x[j]), q[j]);
+    return sum;
+}
+
+#if KNN_X86
+template <uint32_t DT>
+__attribute__((target("avx2,fma,f16c")))
+static inline __m256 load_half8(const uint16_t* x) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x));
+    if constexpr (DT == DTYPE_BF16) return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+    else return _mm256_cvtph_ps(h);
+}
+
+template <HalfOp OP>
+__attribute__((target("avx2,fma,f16c")))
+static inline __m256 half_step8(__m256 x, __m256 q, __m256 acc) {
+    if constexpr (OP == HalfOp::Dot) return _mm256_fmadd_ps(x, q, acc);
+    __m256 d = _mm256_sub_ps(x, q);
+    if constexpr (OP == HalfOp::L2) return _mm256_fmadd_ps(d, d, acc);
+    return _mm256_add_ps(acc, _mm256_andnot_ps(_mm256_set1_ps(-0.0f), d));
+}
+
+template <HalfOp OP, uint32_t DT>
+__attribute__((target("avx2,fma,f16c")))
+static float half_avx2(const uint16_t* x, const float* q, int D) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+    int j = 0;
+    for (; j + 32 <= D; j += 32) {
+        acc0 = half_step8<OP>(load_half8<DT>(x + j), _mm256_loadu_ps(q + j), acc0);
+        acc1 = half_step8<OP>(load_half8<DT>(x + j + 8), _mm256_loadu_ps(q + j + 8), acc1);
+        acc2 = half_step8<OP>(load_half8<DT>(x + j + 16), _mm256_loadu_ps(q + j + 16), acc2);
+        acc3 = half_step8<OP>(load_half8<DT>(x + j + 24), _mm256_loadu_ps(q + j + 24), acc3);
+    }
+    for (; j + 8 <= D; j += 8) acc0 = half_step8<OP>(load_half8<DT>(x + j), _mm256_loadu_ps(q + j), acc0);
+    float sum = hsum256(_mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3)));
+    for (; j < D; j++) sum += half_term<OP>(widen1<DT>(x[j]), q[j]);
+    return sum;
+}
+
+template <uint32_t DT>
+__attribute__((target("avx512f,avx2,fma,f16c")))
+static inline __m512 load_half16(const uint16_t* x) {
+    // All-ones maskz forms: same code, but GCC 12 warns spuriously on the
+    // _mm512_undefined_* inside the unmasked intrinsics
+    const __mmask16 all = 0xffff;
+    __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x));
+    if constexpr (DT == DTYPE_BF16) return _mm512_castsi512_ps(_mm512_maskz_slli_epi32(all, _mm512_maskz_cvtepu16_epi32(all, h), 16));
+    else return _mm512_maskz_cvtph_ps(all, h);
+}
+
+template <HalfOp OP>
+__attribute__((target("avx512f,avx2,fma,f16c")))
+static inline __m512 half_step16(__m512 x, __m512 q, __m512 acc) {
+    if constexpr (OP == HalfOp::Dot) return _mm512_fmadd_ps(x, q, acc);
+    __m512 d = _mm512_sub_ps(x, q);
+    if constexpr (OP == HalfOp::L2) return _mm512_fmadd_ps(d, d, acc);
+    return _mm512_add_ps(acc, _mm512_abs_ps(d));
+}
+
+template <HalfOp OP, uint32_t DT>
+__attribute__((target("avx512f,avx2,fma,f16c")))
+static float half_avx512(const uint16_t* x, const float* q, int D) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+    int j = 0;
+    for (; j + 64 <= D; j += 64) {
+        acc0 = half_step16<OP>(load_half16<DT>(x + j), _mm512_loadu_ps(q + j), acc0);
+        acc1 = half_step16<OP>(load_half16<DT>(x + j + 16), _mm512_loadu_ps(q + j + 16), acc1);
+        acc2 = half_step16<OP>(load_half16<DT>(x + j + 32), _mm512_loadu_ps(q + j + 32), acc2);
+        acc3 = half_step16<OP>(load_half16<DT>(x + j + 48), _mm512_loadu_ps(q + j + 48), acc3);
+    }
+    for (; j + 16 <= D; j += 16) acc0 = half_step16<OP>(load_half16<DT>(x + j), _mm512_loadu_ps(q + j), acc0);
+    if (j < D) {
+        // 16-bit masked loads need AVX-512BW: stage the tail in a zeroed block
+        // instead. Zero lanes of x and q add nothing for any of the three ops.
+        alignas(32) uint16_t tail[16] = {};
+        std::memcpy(tail, x + j, sizeof(uint16_t) * (D - j));
+        __mmask16 m = (__mmask16)((1u << (D - j)) - 1);
+        acc1 = half_step16<OP>(load_half16<DT>(tail), _mm512_maskz_loadu_ps(m, q + j), acc1);
+    }
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, _mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3)));
+    return hsum256(_mm256_add_ps(_mm256_load_ps(lanes), _mm256_load_ps(lanes + 8)));
+}
+#endif
+
+/* ---------------- early abandon ---------------- */
+// The L2 and L1 steps above are plain float32 operations and are reused
+// here. One horizontal sum per block of coordinates pays for the check.
+int abandon_block(int D) {
+    // Short rows go to the scalar kernel, checked every quarter row
+    if (D < 16) return D / 4 > 1 ? D / 4 : 1;
+    int block = D / 4 < 8 ? 8 : (D / 4 > 64 ? 64 : D / 4);
+    return block & ~7;  // whole AVX2 vectors
+}
+
+template <HalfOp OP>
+static float abandon_scalar(const float* __restrict x, const float* __restrict q, int D, int block, float bound,
+                            int& dims) {
+    float sum = 0.0f;
+    for (int j0 = 0; j0 < D; j0 += block) {
+        const int end = j0 + block < D ? j0 + block : D;
+        float partial = 0.0f;
+        #pragma omp simd reduction(+:partial)
+        for (int j = j0; j < end; j++) partial += half_term<OP>(x[j], q[j]);
+        sum += partial;
+        if (sum > bound) {
+            dims = end;
+            return sum;
+        }
+    }
+    dims = D;
+    return sum;
+}
+
+#if KNN_X86
+// `block` is a multiple of 8 here (abandon_block for D >= 16)
+template <HalfOp OP>
+__attribute__((target("avx2,fma,f16c")))
+static float abandon_avx2(const float* x, const float* q, int D, int block, float bound, int& dims) {
+    float sum = 0.0f;
+    int j = 0;
+    for (; j + block <= D; j += block) {
+        const int end = j + block;
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        int b = j;
+        for (; b + 16 <= end; b += 16) {
+            acc0 = half_step8<OP>(_mm256_loadu_ps(x + b), _mm256_loadu_ps(q + b), acc0);
+            acc1 = half_step8<OP>(_mm256_loadu_ps(x + b + 8), _mm256_loadu_ps(q + b + 8), acc1);
+        }
+        if (b < end) acc0 = half_step8<OP>(_mm256_loadu_ps(x + b), _mm256_loadu_ps(q + b), acc0);
+        sum += hsum256(_mm256_add_ps(acc0, acc1));
+        if (sum > bound) {
+            dims = end;
+            return sum;
+        }
+    }
+    // Last partial block: nothing left to skip, so no check
+    __m256 acc = _mm256_setzero_ps();
+    for (; j + 8 <= D; j += 8) acc = half_step8<OP>(_mm256_loadu_ps(x + j), _mm256_loadu_ps(q + j), acc);
+    sum += hsum256(acc);
+    for (; j < D; j++) sum += half_term<OP>(x[j], q[j]);
+    dims = D;
+    return sum;
+}
+
+template <HalfOp OP>
+__attribute__((target("avx512f,avx2,fma,f16c")))
+static float abandon_avx512(const float* x, const float* q, int D, int block, float bound, int& dims) {
+    alignas(64) float lanes[16];
+    float sum = 0.0f;
+    int j = 0;
+    for (; j + block <= D; j += block) {
+        const int end = j + block;
+        __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+        int b = j;
+        for (; b + 32 <= end; b += 32) {
+            acc0 = half_step16<OP>(_mm512_loadu_ps(x + b), _mm512_loadu_ps(q + b), acc0);
+            acc1 = half_step16<OP>(_mm512_loadu_ps(x + b + 16), _mm512_loadu_ps(q + b + 16), acc1);
+        }
+        if (b + 16 <= end) {
+            acc0 = half_step16<OP>(_mm512_loadu_ps(x + b), _mm512_loadu_ps(q + b), acc0);
+            b += 16;
+        }
+        if (b < end) {
+            // An 8-wide remainder; zero lanes add nothing to either sum
+            acc1 = half_step16<OP>(_mm512_maskz_loadu_ps(0xFF, x + b), _mm512_maskz_loadu_ps(0xFF, q + b), acc1);
+        }
+        _mm512_store_ps(lanes, _mm512_add_ps(acc0, acc1));
+        sum += hsum256(_mm256_add_ps(_mm256_load_ps(lanes), _mm256_load_ps(lanes + 8)));
+        if (sum > bound) {
+            dims = end;
+            return sum;
+        }
+    }
+    __m512 acc = _mm512_setzero_ps();
+    for (; j + 16 <= D; j += 16) acc = half_step16<OP>(_mm512_loadu_ps(x + j), _mm512_loadu_ps(q + j), acc);
+    if (j < D) {
+        __mmask16 m = (__mmask16)((1u << (D - j)) - 1);
+        acc = half_step16<OP>(_mm512_maskz_loadu_ps(m, x + j), _mm512_maskz_loadu_ps(m, q + j), acc);
+    }
+    _mm512_store_ps(lanes, acc);
+    sum += hsum256(_mm256_add_ps(_mm256_load_ps(lanes), _mm256_load_ps(lanes + 8)));
+    dims = D;
+    return sum;
+}
+#endif
+
+template <HalfOp OP>
+static AbandonKernel select_abandon_kernel(int D, KernelISA isa) {
+#if KNN_X86
+    if (D < 16) return abandon_scalar<OP>;
+    if (isa == KernelISA::AVX512) return abandon_avx512<OP>;
+    if (isa == KernelISA::AVX2) return abandon_avx2<OP>;
+#endif
+    return abandon_scalar<OP>;
+}
+
+template <HalfOp OP>
+static HalfKernel select_half_kernel(uint32_t dtype, KernelISA isa) {
+    const bool bf16 = dtype == DTYPE_BF16;
+#if KNN_X86
+    if (isa == KernelISA::AVX512) return bf16 ? half_avx512<OP, DTYPE_BF16> : half_avx512<OP, DTYPE_F16>;
+    // Every AVX2 CPU so far has F16C, but fp16 rows still check for it
+    static const bool f16c = (__builtin_cpu_init(), __builtin_cpu_supports("f16c"));
+    if (isa == KernelISA::AVX2 && (bf16 || f16c)) return bf16 ? half_avx2<OP, DTYPE_BF16> : half_avx2<OP, DTYPE_F16>;
+#endif
+    return bf16 ? half_scalar<OP, DTYPE_BF16> : half_scalar<OP, DTYPE_F16>;
+}
+
+/* ---------------- dispatch ---------------- */
+static const int kSpecialisedDims[] = {3, 128, 384, 768, 1536};
+
+bool is_specialised_dim(int D) {
+    for (int d : kSpecialisedDims) {
+        if (d == D) return true;
+    }
+    return false;
+}
+
+KernelISA detect_isa() {
+    KernelISA best = KernelISA::Scalar;
+#if KNN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) best = KernelISA::AVX2;
+    if (__builtin_cpu_supports("avx512f")) best = KernelISA::AVX512;
+#endif
+    if (const char* cap = std::getenv("KNN_ISA")) {
+        KernelISA want = best;
+        if (std::strcmp(cap, "scalar") == 0) want = KernelISA::Scalar;
+        else if (std::strcmp(cap, "avx2") == 0) want = KernelISA::AVX2;
+        else if (std::strcmp(cap, "avx512") == 0) want = KernelISA::AVX512;
+        if (want < best) best = want;
+    }
+    return best;
+}
+
+const char* isa_name(KernelISA isa) {
+    switch (isa) {
+        case KernelISA::AVX512: return "avx512";
+        case KernelISA::AVX2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+template <template <int> class Pick>
+static DistKernel pick_dim(int D) {
+    switch (D) {
+        case 3: return Pick<3>::fn;
+        case 128: return Pick<128>::fn;
+        case 384: return Pick<384>::fn;
+        case 768: return Pick<768>::fn;
+        case 1536: return Pick<1536>::fn;
+        default: return Pick<0>::fn;
+    }
+}
+
+template <int DIM> struct PickScalar { static constexpr DistKernel fn = l2_scalar<DIM>; };
+template <int DIM> struct PickDotScalar { static constexpr DistKernel fn = dot_scalar<DIM>; };
+#if KNN_X86
+template <int DIM> struct PickAVX2 { static constexpr DistKernel fn = l2_avx2<DIM>; };
+template <int DIM> struct PickAVX512 { static constexpr DistKernel fn = l2_avx512<DIM>; };
+template <int DIM> struct PickDotAVX2 { static constexpr DistKernel fn = dot_avx2<DIM>; };
+template <int DIM> struct PickDotAVX512 { static constexpr DistKernel fn = dot_avx512<DIM>; };
+#endif
+
+L2Kernel select_l2_kernel(int D, KernelISA isa) {
+    // D=3 is too short for vector registers: the unrolled scalar form wins
+    if (D == 3) return pick_dim<PickScalar>(D);
+#if KNN_X86
+    if (isa == KernelISA::AVX512) return pick_dim<PickAVX512>(D);
+    if (isa == KernelISA::AVX2) return pick_dim<PickAVX2>(D);
+#endif
+    return pick_dim<PickScalar>(D);
+}
+
+L2Kernel select_l2_kernel(int D) {
+    static const KernelISA isa = detect_isa();
+    return select_l2_kernel(D, isa);
+}
+
+DotKernel select_dot_kernel(int D, KernelISA isa) {
+    if (D == 3) return pick_dim<PickDotScalar>(D);
+#if KNN_X86
+    if (isa == KernelISA::AVX512) return pick_dim<PickDotAVX512>(D);
+    if (isa == KernelISA::AVX2) return pick_dim<PickDotAVX2>(D);
+#endif
+    return pick_dim<PickDotScalar>(D);
+}
+
+DotKernel select_dot_kernel(int D) {
+    static const KernelISA isa = detect_isa();
+    return select_dot_kernel(D, isa);
+}
+
+HalfKernel select_half_l2_kernel(uint32_t dtype, KernelISA isa) { return select_half_kernel<HalfOp::L2>(dtype, isa); }
+HalfKernel select_half_dot_kernel(uint32_t dtype, KernelISA isa) { return select_half_kernel<HalfOp::Dot>(dtype, isa); }
+HalfKernel select_half_l1_kernel(uint32_t dtype, KernelISA isa) { return select_half_kernel<HalfOp::L1>(dtype, isa); }
+
+HalfKernel select_half_l2_kernel(uint32_t dtype) {
+    static const KernelISA isa = detect_isa();
+    return select_half_l2_kernel(dtype, isa);
+}
+
+HalfKernel select_half_dot_kernel(uint32_t dtype) {
+    static const KernelISA isa = detect_isa();
+    return select_half_dot_kernel(dtype, isa);
+}
+
+HalfKernel select_half_l1_kernel(uint32_t dtype) {
+    static const KernelISA isa = detect_isa();
+    return select_half_l1_kernel(dtype, isa);
+}
+
+AbandonKernel select_l2_abandon_kernel(int D, KernelISA isa) { return select_abandon_kernel<HalfOp::L2>(D, isa); }
+AbandonKernel select_l1_abandon_kernel(int D, KernelISA isa) { return select_abandon_kernel<HalfOp::L1>(D, isa); }
+
+AbandonKernel select_l2_abandon_kernel(int D) {
+    static const KernelISA isa = detect_isa();
+    return select_l2_abandon_kernel(D, isa);
+}
+
+AbandonKernel select_l1_abandon_kernel(int D) {
+    static const KernelISA isa = detect_isa();
+    return select_l1_abandon_kernel(D, isa);
+}
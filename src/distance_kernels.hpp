@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+
+// Hand-vectorised squared-L2 and dot-product kernels with runtime ISA dispatch.
+// The build targets generic x86-64; AVX2+FMA and AVX-512 variants are compiled
+// with per-function target attributes and picked at startup from CPUID, so one
+// binary runs everywhere and still uses the widest units available.
+// Common dimensions (3, 128, 384, 768, 1536) get fully specialised kernels.
+
+using DistKernel = float (*)(const float* a, const float* b, int D);
+using L2Kernel = DistKernel;   // sum (a - b)^2
+using DotKernel = DistKernel;  // sum a * b
+
+enum class KernelISA { Scalar, AVX2, AVX512 };
+
+// Best ISA supported by this CPU. KNN_ISA=scalar|avx2|avx512 caps it.
+KernelISA detect_isa();
+const char* isa_name(KernelISA isa);
+
+// Kernel for dimension D on the detected ISA. Resolve once, call per row.
+L2Kernel select_l2_kernel(int D);
+L2Kernel select_l2_kernel(int D, KernelISA isa);
+
+// Dot-product kernel (inner-product and cosine metrics), same dispatch rules.
+DotKernel select_dot_kernel(int D);
+DotKernel select_dot_kernel(int D, KernelISA isa);
+
+// True if D has a compile-time specialised kernel.
+bool is_specialised_dim(int D);
+
+// Kernels over 16-bit rows (DTYPE_F16 or DTYPE_BF16): x is a stored row, q the
+// float32 query, and the sum is accumulated in float32. Rows are widened in
+// registers (F16C / AVX-512F conversions; bf16 is a 16-bit shift), so a scan
+// streams half the bytes of a float32 store. Same ISA dispatch, no
+// per-dimension specialisation.
+using HalfKernel = float (*)(const uint16_t* x, const float* q, int D);
+
+HalfKernel select_half_l2_kernel(uint32_t dtype);   // sum (x - q)^2
+HalfKernel select_half_l2_kernel(uint32_t dtype, KernelISA isa);
+HalfKernel select_half_dot_kernel(uint32_t dtype);  // sum x * q
+HalfKernel select_half_dot_kernel(uint32_t dtype, KernelISA isa);
+HalfKernel select_half_l1_kernel(uint32_t dtype);   // sum |x - q|
+HalfKernel select_half_l1_kernel(uint32_t dtype, KernelISA isa);
+
+// Early-abandoning squared L2 and L1 over float32 rows. The sum is built
+// `block` dimensions at a time and compared with `bound` after each block;
+// once it exceeds the bound the kernel stops and returns the partial sum,
+// which is then only a lower bound (> bound) of the distance. Otherwise the
+// full distance is returned. `dims` receives the coordinates read.
+// abandon_block(D) is a quarter of the row: 8..64 dims in whole AVX2
+// vectors, or max(1, D/4) below D = 16, where the scalar kernel is used.
+// Short rows then still get checks before their last coordinate.
+int abandon_block(int D);
+using AbandonKernel = float (*)(const float* x, const float* q, int D, int block, float bound, int& dims);
+
+AbandonKernel select_l2_abandon_kernel(int D);
+AbandonKernel select_l2_abandon_kernel(int D, KernelISA isa);
+AbandonKernel select_l1_abandon_kernel(int D);
+AbandonKernel select_l1_abandon_kernel(int D, KernelISA isa);
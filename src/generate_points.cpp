@@ -1,90 +1,138 @@
 #include "generate_points.hpp"
+#include "binary_format.hpp"
+#include "half.hpp"
 #include <iostream>
-#include <fstream>
-#include <random>
 #include <vector>
 #include <string>
 #include <omp.h>
-#include <charconv>
 #include <algorithm>
-#include <iomanip>
-#include <ctime>
 #include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
 
-bool run_parallel_generator(long long num_points, int dims, const std::string& filename) {
-    // Open with binary + trunc to explicitly overwrite existing files
-    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
-    if (!out) {
+static void print_config(const char* title, int dims, const char* dtype, long long batch_size,
+                         const GeneratorConfig& cfg) {
+    std::cout << title << ":\n"
+              << " - Threads:    " << omp_get_max_threads() << "\n"
+              << " - Dimensions: " << dims << " (" << dtype << ")\n"
+              << " - Data:       " << distribution_name(cfg.dist);
+    if (cfg.dist == PointDistribution::Mixture) std::cout << " (" << cfg.clusters << " clusters, spread " << cfg.spread << ")";
+    std::cout << (cfg.normalize ? ", unit-normalised" : "") << ", seed " << cfg.seed << "\n"
+              << " - Batch Size: " << batch_size << " points per write\n"
+              << "-------------------------------------------\n";
+}
+
+bool run_parallel_generator(long long num_points, int dims, const std::string& filename, const GeneratorConfig& cfg) {
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
         std::cerr << "System Error: " << std::strerror(errno) << " (" << filename << ")" << std::endl;
         return false;
     }
 
     // --- High-Memory Tuning ---
-    // Target 32MB per write to minimize 'omp critical' lock contention
+    // ~32MB of text per batch keeps the number of rounds (and barriers) low
     const int bytes_per_point = dims * 12;
     const int target_write_size = 32 * 1024 * 1024;
-    
+
     int batch_size = std::max(1, target_write_size / std::max(1, bytes_per_point));
     batch_size = std::min(batch_size, 100000); // Cap to keep per-thread memory reasonable
 
-    std::cout << "EPYC 7V13 Optimized Config:\n"
-              << " - Threads:    " << omp_get_max_threads() << "\n"
-              << " - Dimensions: " << dims << "\n"
-              << " - Batch Size: " << batch_size << " points per write\n"
-              << "-------------------------------------------\n";
+    const PointGenerator gen(cfg, dims);
+    print_config("Text Generator Config", dims, "text", batch_size, cfg);
 
     double start_time = omp_get_wtime();
-
-    #pragma omp parallel
+    bool ok = true;
+    std::vector<size_t> lengths(omp_get_max_threads());
+    std::vector<off_t> offsets(omp_get_max_threads());
+    off_t file_end = 0;
+
+    // Text rows have no fixed size, so batches are written in rounds: every
+    // thread formats one batch, a prefix sum over the batch lengths gives each
+    // its file offset, and all of them pwrite at once. Batches land in row
+    // order, so the file is the same for any thread count.
+    #pragma omp parallel reduction(&&:ok)
     {
-        int tid = omp_get_thread_num();
-        // Seed uniquely per thread
-        std::mt19937 rng(static_cast<unsigned>(std::time(nullptr)) + tid);
-        std::uniform_real_distribution<float> dist(-1000.0f, 1000.0f);
+        const int T = omp_get_num_threads();
+        const int tid = omp_get_thread_num();
+        std::vector<float> rows((size_t)batch_size * dims);
+        std::vector<char> text((size_t)batch_size * dims * 16);
+
+        for (long long round = 0; round < num_points; round += (long long)T * batch_size) {
+            long long first = std::min(num_points, round + (long long)tid * batch_size);
+            long long count = std::min<long long>(batch_size, num_points - first);
+            size_t bytes = 0;
+            gen.rows(first, count, rows.data());
+            for (long long r = 0; r < count; r++) {
+                bytes += format_row_text(&rows[(size_t)r * dims], dims, fixed_text_format(cfg), text.data() + bytes);
+            }
+            lengths[tid] = bytes;
 
-        std::string thread_buffer;
-        // Pre-reserve memory to avoid reallocations during loop
-        thread_buffer.reserve(batch_size * dims * 13);
+            #pragma omp barrier
+            #pragma omp single
+            {
+                for (int t = 0; t < T; t++) {
+                    offsets[t] = file_end;
+                    file_end += lengths[t];
+                }
+            }
+            if (bytes > 0 && pwrite(fd, text.data(), bytes, offsets[tid]) != (ssize_t)bytes) ok = false;
+        }
+    }
 
-        #pragma omp for schedule(static)
-        for (long long i = 0; i < num_points; ++i) {
-            char temp_buf[32];
+    if (close(fd) != 0) ok = false;
+    if (!ok) {
+        std::cerr << "Error: File write failed (Disk full or quota exceeded?)" << std::endl;
+        return false;
+    }
 
-            for (int d = 0; d < dims; ++d) {
-                float val = dist(rng);
+    std::cout << "\nGeneration finished in " << (omp_get_wtime() - start_time) << "s\n";
+    return true;
+}
 
-                // Faster than sprintf/cout: std::to_chars converts float to string directly
-                auto [ptr, ec] = std::to_chars(temp_buf, temp_buf + 32, val, std::chars_format::fixed, 4);
-                thread_buffer.append(temp_buf, ptr - temp_buf);
+bool run_parallel_generator_binary(long long num_points, int dims, const std::string& filename, uint32_t dtype,
+                                   const GeneratorConfig& cfg) {
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        std::cerr << "System Error: " << std::strerror(errno) << " (" << filename << ")" << std::endl;
+        return false;
+    }
 
-                if (d < dims - 1) thread_buffer += " ";
-            }
-            thread_buffer += "\n";
+    BinaryHeader header = make_binary_header(num_points, dims, dtype);
+    const size_t row_bytes = (size_t)dims * dtype_size(dtype);
+    const int batch_size = std::max<int>(1, std::min<size_t>(100000, (32 * 1024 * 1024) / row_bytes));
 
-            // Periodic flush: Check if we reached our batch size
-            if ((i + 1) % batch_size == 0) {
-                #pragma omp critical
-                {
-                    out.write(thread_buffer.data(), thread_buffer.size());
-                }
-                thread_buffer.clear();
-            }
-        }
+    bool ok = ftruncate(fd, header.offset + num_points * row_bytes) == 0 &&
+              pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
 
-        // --- FINAL SAFE FLUSH ---
-        // Crucial: Every thread must write its remaining points after the loop
-        if (!thread_buffer.empty()) {
-            #pragma omp critical
-            {
-                out.write(thread_buffer.data(), thread_buffer.size());
+    const PointGenerator gen(cfg, dims);
+    print_config("Binary Generator Config", dims, dtype_name(dtype), batch_size, cfg);
+
+    double start_time = omp_get_wtime();
+
+    // Rows have fixed offsets, so every batch is written in place: no lock
+    #pragma omp parallel reduction(&&:ok)
+    {
+        std::vector<char> buf((size_t)batch_size * row_bytes);
+        std::vector<float> wide(dtype == DTYPE_F32 ? 0 : (size_t)batch_size * dims);
+
+        #pragma omp for schedule(static)
+        for (long long start = 0; start < num_points; start += batch_size) {
+            long long rows = std::min<long long>(batch_size, num_points - start);
+            size_t count = (size_t)rows * dims;
+            if (dtype != DTYPE_F32) {
+                // Drawn in float32, then narrowed in one vectorised pass
+                gen.rows(start, rows, wide.data());
+                narrow_from_float(wide.data(), reinterpret_cast<uint16_t*>(buf.data()), count, dtype);
+            } else {
+                gen.rows(start, rows, reinterpret_cast<float*>(buf.data()));
             }
-            thread_buffer.clear();
+            size_t bytes = (size_t)rows * row_bytes;
+            if (pwrite(fd, buf.data(), bytes, header.offset + start * row_bytes) != (ssize_t)bytes) ok = false;
         }
     }
 
-    out.close();
-    
-    if (out.fail()) {
+    if (close(fd) != 0) ok = false;
+    if (!ok) {
         std::cerr << "Error: File write failed (Disk full or quota exceeded?)" << std::endl;
         return false;
     }
@@ -94,8 +142,9 @@ bool run_parallel_generator(long long num_points, int dims, const std::string& f
 }
 
 int main(int argc, char** argv) {
-    if (argc != 4) {
-        std::cout << "Usage: ./gen <num_points> <dimensions> <output_file>\n";
+    if (argc < 4) {
+        std::cout << "Usage: ./gen <num_points> <dimensions> <output_file> [--binary] [--dtype f32|f16|bf16]"
+                  << " [--seed S] [--dist uniform|normal|mixture] [--clusters K] [--spread S] [--normalize]\n";
         return 1;
     }
 
@@ -104,7 +153,35 @@ int main(int argc, char** argv) {
         int d = std::stoi(argv[2]);
         std::string fname = argv[3];
 
-        if (!run_parallel_generator(n, d, fname)) {
+        bool binary = false;
+        uint32_t dtype = DTYPE_F32;
+        GeneratorConfig cfg;
+        for (int a = 4; a < argc; a++) {
+            std::string opt = argv[a];
+            if (opt == "--binary") {
+                binary = true;
+            } else if (opt == "--dtype" && a + 1 < argc && parse_dtype(argv[a + 1], dtype)) {
+                binary = true; // Reduced-precision output only exists in the binary format
+                a++;
+            } else if (opt == "--seed" && a + 1 < argc) {
+                cfg.seed = std::stoull(argv[++a]);
+            } else if (opt == "--dist" && a + 1 < argc && parse_distribution(argv[a + 1], cfg.dist)) {
+                a++;
+            } else if (opt == "--clusters" && a + 1 < argc) {
+                cfg.clusters = (uint32_t)std::max(1, std::stoi(argv[++a]));
+            } else if (opt == "--spread" && a + 1 < argc) {
+                cfg.spread = std::stof(argv[++a]);
+            } else if (opt == "--normalize") {
+                cfg.normalize = true;
+            } else {
+                std::cerr << "Invalid option: " << opt << std::endl;
+                return 1;
+            }
+        }
+
+        bool ok = binary ? run_parallel_generator_binary(n, d, fname, dtype, cfg)
+                         : run_parallel_generator(n, d, fname, cfg);
+        if (!ok) {
             return 1;
         }
     } catch (const std::exception& e) {
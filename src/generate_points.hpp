@@ -1,15 +1,30 @@
 #ifndef GENERATE_POINTS_HPP
 #define GENERATE_POINTS_HPP
 
+#include <cstdint>
 #include <string>
+#include "point_generator.hpp"
 
 /**
- * Generates random point data in parallel.
+ * Generates random point data in parallel, as text.
+ * The output depends only on the arguments and `cfg` (seed included), never on
+ * the thread count: rows come from a counter-based generator and are written
+ * in order with pwrite, without a lock.
  * @param num_points Total number of points to generate.
  * @param dims Number of dimensions per point.
  * @param filename Output path for the text file.
+ * @param cfg Distribution and seed (see point_generator.hpp).
  * @return true if successful, false otherwise.
  */
-bool run_parallel_generator(long long num_points, int dims, const std::string& filename);
+bool run_parallel_generator(long long num_points, int dims, const std::string& filename,
+                            const GeneratorConfig& cfg = GeneratorConfig());
+
+/**
+ * Generates random point data directly in the binary dataset format.
+ * Each batch is written at its fixed file offset, so threads never serialise.
+ * @param dtype Payload type (DTYPE_F32, DTYPE_F16 or DTYPE_BF16).
+ */
+bool run_parallel_generator_binary(long long num_points, int dims, const std::string& filename, uint32_t dtype,
+                                   const GeneratorConfig& cfg = GeneratorConfig());
 
 #endif
@@ -1,6 +1,8 @@
 // src/gpu_hip.cpp
 #include "gpu_hip.hpp"
-#include "Point.hpp"
+#include "PointSet.hpp"
+#include "cpu_distance.hpp"
+#include "trace.hpp"
 #include <hip/hip_runtime.h>
 #include <vector>
 #include <cstdio>
@@ -13,10 +15,10 @@
 // --- Timing Helpers ---
 #define START_TIMER(event) HIP_CHECK(hipEventRecord(event##Start, 0))
 #define STOP_TIMER(event) HIP_CHECK(hipEventRecord(event##Stop, 0)); HIP_CHECK(hipEventSynchronize(event##Stop))
-#define GET_TIME(event) { \
+#define GET_TIME(event, label) { \
     float ms; \
     HIP_CHECK(hipEventElapsedTime(&ms, event##Start, event##Stop)); \
-    printf(#event " Time: %.3f ms\n", ms); \
+    print_timing(label, ms / 1000.0); \
 }
 // ----------------------
 
@@ -29,10 +31,14 @@ static inline void hip_check(hipError_t e, const char* file, int line) {
 #define HIP_CHECK(x) hip_check((x), __FILE__, __LINE__)
 
 /* ---------------- distance kernel ---------------- */
+// Cosine divides by the row norms computed at load (x_norms) and by the
+// query norm, computed once on the host; the other metrics ignore both.
 __global__ void distance_kernel(const float* coords_flat,
                                 const float* ref,
+                                const float* x_norms,
+                                float q_norm,
                                 float* out_dists,
-                                int N, int D, int M) {
+                                int N, int D, int M, MetricKind metric) {
     int i = blockIdx.x * blockDim.x + threadIdx.x;
     if (i >= M) return;
     if (i >= N) {
@@ -41,9 +47,20 @@ __global__ void distance_kernel(const float* coords_flat,
     }
     const float* row = coords_flat + (size_t)i * (size_t)D;
     float s = 0.0f;
-    for (int j = 0; j < D; ++j) {
-        float diff = row[j] - ref[j];
-        s += diff * diff;
+    if (metric == MetricKind::L2) {
+        for (int j = 0; j < D; ++j) {
+            float diff = row[j] - ref[j];
+            s += diff * diff;
+        }
+    } else if (metric == MetricKind::L1) {
+        for (int j = 0; j < D; ++j) s += fabsf(row[j] - ref[j]);
+    } else if (metric == MetricKind::InnerProduct) {
+        for (int j = 0; j < D; ++j) s += row[j] * ref[j];
+        s = -s;
+    } else {
+        for (int j = 0; j < D; ++j) s += row[j] * ref[j];
+        float denom = x_norms[i] * q_norm;
+        s = denom > 0.0f ? 1.0f - s / denom : 1.0f;
     }
     out_dists[i] = s;
 }
@@ -81,31 +98,36 @@ static int next_pow2(int v) {
     return p;
 }
 
-void run_gpu_sort(std::vector<Point>& pts, const std::vector<float>& ref) {
+void run_gpu_sort(PointSet& pts, const std::vector<float>& ref, MetricKind metric) {
     int N = (int)pts.size();
     if (N == 0) return;
-    int D = (int)ref.size();
+    int D = pts.D;
+    TRACE_SCOPE("run_gpu_sort");
 
     auto host_prep_start = std::chrono::high_resolution_clock::now();
 
+    // Coordinates are already one flat row-major buffer: copy straight from it
     size_t coords_count = (size_t)N * (size_t)D;
-    std::vector<float> h_coords(coords_count);
-    
-    #pragma omp parallel for
-    for (int i = 0; i < N; ++i) {
-        for (int j = 0; j < D; ++j) {
-            h_coords[(size_t)i * D + j] = pts[i].coords[j];
-        }
-    }
 
     int M = next_pow2(N);
-    std::vector<int> h_idx(M);
-    #pragma omp parallel for
-    for (int i = 0; i < M; ++i) h_idx[i] = i < N ? i : (N + i);
+    std::vector<int> h_idx;
+    {
+        TRACE_SCOPE("gpu.host_prep");
+        h_idx.resize(M);
+        #pragma omp parallel for
+        for (int i = 0; i < M; ++i) h_idx[i] = i < N ? i : (N + i);
+    }
 
     auto host_prep_stop = std::chrono::high_resolution_clock::now();
 
-    float *d_coords, *d_ref, *d_keys;
+    // Cosine reads the load-time row norms; the query norm is computed once here
+    const bool cosine = metric == MetricKind::Cosine;
+    if (cosine && pts.norms.size() != pts.size()) compute_norms(pts);
+    float q_norm = 0.0f;
+    for (int j = 0; j < D; ++j) q_norm += ref[j] * ref[j];
+    q_norm = std::sqrt(q_norm);
+
+    float *d_coords, *d_ref, *d_keys, *d_norms = nullptr;
     int *d_vals;
 
     hipEvent_t allocStart, allocStop, h2dStart, h2dStop, distKernelStart, distKernelStop, sortKernelStart, sortKernelStop, d2hStart, d2hStop;
@@ -115,58 +137,80 @@ void run_gpu_sort(std::vector<Point>& pts, const std::vector<float>& ref) {
     HIP_CHECK(hipEventCreate(&sortKernelStart)); HIP_CHECK(hipEventCreate(&sortKernelStop));
     HIP_CHECK(hipEventCreate(&d2hStart));   HIP_CHECK(hipEventCreate(&d2hStop));
 
-    START_TIMER(alloc);
-    HIP_CHECK(hipMalloc(&d_coords, sizeof(float) * coords_count));
-    HIP_CHECK(hipMalloc(&d_ref, sizeof(float) * D));
-    HIP_CHECK(hipMalloc(&d_keys, sizeof(float) * (size_t)M));
-    HIP_CHECK(hipMalloc(&d_vals, sizeof(int) * (size_t)M));
-    STOP_TIMER(alloc);
+    // Each stage is bracketed by events for the device time and by a trace
+    // span on the host; STOP_TIMER synchronises, so the span covers the device work
+    {
+        TRACE_SCOPE("gpu.alloc");
+        START_TIMER(alloc);
+        HIP_CHECK(hipMalloc(&d_coords, sizeof(float) * coords_count));
+        HIP_CHECK(hipMalloc(&d_ref, sizeof(float) * D));
+        HIP_CHECK(hipMalloc(&d_keys, sizeof(float) * (size_t)M));
+        HIP_CHECK(hipMalloc(&d_vals, sizeof(int) * (size_t)M));
+        if (cosine) HIP_CHECK(hipMalloc(&d_norms, sizeof(float) * (size_t)N));
+        STOP_TIMER(alloc);
+    }
 
-    START_TIMER(h2d);
-    HIP_CHECK(hipMemcpy(d_coords, h_coords.data(), sizeof(float) * coords_count, hipMemcpyHostToDevice));
-    HIP_CHECK(hipMemcpy(d_ref, ref.data(), sizeof(float) * D, hipMemcpyHostToDevice));
-    HIP_CHECK(hipMemcpy(d_vals, h_idx.data(), sizeof(int) * (size_t)M, hipMemcpyHostToDevice));
-    STOP_TIMER(h2d);
+    {
+        TRACE_SCOPE("gpu.h2d");
+        START_TIMER(h2d);
+        HIP_CHECK(hipMemcpy(d_coords, pts.coords, sizeof(float) * coords_count, hipMemcpyHostToDevice));
+        HIP_CHECK(hipMemcpy(d_ref, ref.data(), sizeof(float) * D, hipMemcpyHostToDevice));
+        HIP_CHECK(hipMemcpy(d_vals, h_idx.data(), sizeof(int) * (size_t)M, hipMemcpyHostToDevice));
+        if (cosine) HIP_CHECK(hipMemcpy(d_norms, pts.norms.data(), sizeof(float) * (size_t)N, hipMemcpyHostToDevice));
+        STOP_TIMER(h2d);
+    }
 
     int block = 256;
     int grid = (M + block - 1) / block;
-    START_TIMER(distKernel);
-    hipLaunchKernelGGL(distance_kernel, dim3(grid), dim3(block), 0, 0, d_coords, d_ref, d_keys, N, D, M);
-    HIP_CHECK(hipGetLastError());
-    STOP_TIMER(distKernel);
-
-    START_TIMER(sortKernel);
-    for (int k = 2; k <= M; k <<= 1) {
-        for (int j = k >> 1; j > 0; j >>= 1) {
-            hipLaunchKernelGGL(bitonic_step_kernel, dim3((M + block - 1) / block), dim3(block), 0, 0, d_keys, d_vals, M, k, j);
-            HIP_CHECK(hipGetLastError());
+    {
+        TRACE_SCOPE("gpu.distance_kernel");
+        START_TIMER(distKernel);
+        hipLaunchKernelGGL(distance_kernel, dim3(grid), dim3(block), 0, 0, d_coords, d_ref, d_norms, q_norm,
+                           d_keys, N, D, M, metric);
+        HIP_CHECK(hipGetLastError());
+        STOP_TIMER(distKernel);
+    }
+
+    {
+        TRACE_SCOPE("gpu.sort_kernel");
+        START_TIMER(sortKernel);
+        for (int k = 2; k <= M; k <<= 1) {
+            for (int j = k >> 1; j > 0; j >>= 1) {
+                hipLaunchKernelGGL(bitonic_step_kernel, dim3((M + block - 1) / block), dim3(block), 0, 0, d_keys, d_vals, M, k, j);
+                HIP_CHECK(hipGetLastError());
+            }
+            HIP_CHECK(hipDeviceSynchronize());
         }
-        HIP_CHECK(hipDeviceSynchronize());
+        STOP_TIMER(sortKernel);
     }
-    STOP_TIMER(sortKernel);
 
     std::vector<int> sorted_idx(M);
     std::vector<float> sorted_keys(M);
-    START_TIMER(d2h);
-    HIP_CHECK(hipMemcpy(sorted_idx.data(), d_vals, sizeof(int) * (size_t)M, hipMemcpyDeviceToHost));
-    HIP_CHECK(hipMemcpy(sorted_keys.data(), d_keys, sizeof(float) * (size_t)M, hipMemcpyDeviceToHost));
-    STOP_TIMER(d2h);
+    {
+        TRACE_SCOPE("gpu.d2h");
+        START_TIMER(d2h);
+        HIP_CHECK(hipMemcpy(sorted_idx.data(), d_vals, sizeof(int) * (size_t)M, hipMemcpyDeviceToHost));
+        HIP_CHECK(hipMemcpy(sorted_keys.data(), d_keys, sizeof(float) * (size_t)M, hipMemcpyDeviceToHost));
+        STOP_TIMER(d2h);
+    }
 
     // --- 7. Host Reordering Timing (Parallelized) ---
     auto host_reorder_start = std::chrono::high_resolution_clock::now();
-    std::vector<Point> temp_pts(N);
-    for (int i = 0; i < N; ++i) {
-      int old_idx = sorted_idx[i];
-      temp_pts[i] = std::move(pts[old_idx]);
-      temp_pts[i].dist = sorted_keys[i];
+    {
+        TRACE_SCOPE("gpu.host_reorder");
+        #pragma omp parallel for
+        for (int i = 0; i < N; ++i) {
+          pts.id[i] = (uint32_t)sorted_idx[i];
+          pts.dist[i] = sorted_keys[i];
+        }
     }
-    pts.swap(temp_pts);
 
     auto host_reorder_stop = std::chrono::high_resolution_clock::now();
 
-    GET_TIME(alloc); GET_TIME(h2d); GET_TIME(distKernel); GET_TIME(sortKernel); GET_TIME(d2h);
-    printf("Host Preparation Time: %.3f ms\n", std::chrono::duration_cast<std::chrono::nanoseconds>(host_prep_stop - host_prep_start).count() / 1000000.0f);
-    printf("Host Reorder Time: %.3f ms\n", std::chrono::duration_cast<std::chrono::nanoseconds>(host_reorder_stop - host_reorder_start).count() / 1000000.0f);
+    GET_TIME(alloc, "Alloc"); GET_TIME(h2d, "Host-to-Device (H2D)"); GET_TIME(distKernel, "Distance Kernel");
+    GET_TIME(sortKernel, "Sort Kernel"); GET_TIME(d2h, "Device-to-Host (D2H)");
+    print_timing("Host Preparation", std::chrono::duration<double>(host_prep_stop - host_prep_start).count());
+    print_timing("Host Reorder", std::chrono::duration<double>(host_reorder_stop - host_reorder_start).count());
 
     HIP_CHECK(hipEventDestroy(allocStart)); HIP_CHECK(hipEventDestroy(allocStop));
     HIP_CHECK(hipEventDestroy(h2dStart)); HIP_CHECK(hipEventDestroy(h2dStop));
@@ -174,4 +218,10 @@ void run_gpu_sort(std::vector<Point>& pts, const std::vector<float>& ref) {
     HIP_CHECK(hipEventDestroy(sortKernelStart)); HIP_CHECK(hipEventDestroy(sortKernelStop));
     HIP_CHECK(hipEventDestroy(d2hStart)); HIP_CHECK(hipEventDestroy(d2hStop));
     HIP_CHECK(hipFree(d_coords)); HIP_CHECK(hipFree(d_ref)); HIP_CHECK(hipFree(d_keys)); HIP_CHECK(hipFree(d_vals));
+    if (d_norms) HIP_CHECK(hipFree(d_norms));
+}
+
+bool gpu_available() {
+    int count = 0;
+    return hipGetDeviceCount(&count) == hipSuccess && count > 0;
 }
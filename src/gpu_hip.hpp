@@ -1,6 +1,10 @@
 #pragma once
 #include <vector>
-#include "Point.hpp"
+#include "PointSet.hpp"
+#include "metrics.hpp"
 
 // GPU entry point
-void run_gpu_sort(std::vector<Point>& pts, const std::vector<float>& ref);
+void run_gpu_sort(PointSet& pts, const std::vector<float>& ref, MetricKind metric = MetricKind::L2);
+
+// True if the HIP runtime reports at least one device.
+bool gpu_available();
@@ -0,0 +1,112 @@
+#include "half.hpp"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KNN_X86 1
+#endif
+
+// Same structure as distance_kernels.cpp: the build targets generic x86-64 and
+// the vector loops carry their own target attributes, picked once from CPUID.
+
+#if KNN_X86
+__attribute__((target("avx2,f16c")))
+static void widen_f16_f16c(const uint16_t* src, float* dst, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+    for (; i < n; i++) dst[i] = half_to_float(src[i]);
+}
+
+__attribute__((target("avx2,f16c")))
+static void narrow_f16_f16c(const float* src, uint16_t* dst, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+    }
+    for (; i < n; i++) dst[i] = float_to_half(src[i]);
+}
+
+__attribute__((target("avx512f,avx2,f16c")))
+static void widen_f16_avx512(const uint16_t* src, float* dst, size_t n) {
+    // All-ones maskz forms: GCC 12 warns spuriously on the unmasked intrinsics
+    const __mmask16 all = 0xffff;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm512_storeu_ps(dst + i, _mm512_maskz_cvtph_ps(all, h));
+    }
+    for (; i < n; i++) dst[i] = half_to_float(src[i]);
+}
+
+__attribute__((target("avx512f,avx2,f16c")))
+static void widen_bf16_avx512(const uint16_t* src, float* dst, size_t n) {
+    const __mmask16 all = 0xffff;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm512_storeu_si512(dst + i, _mm512_maskz_slli_epi32(all, _mm512_maskz_cvtepu16_epi32(all, h), 16));
+    }
+    for (; i < n; i++) dst[i] = bf16_to_float(src[i]);
+}
+
+// VCVTNEPS2BF16 rounds to nearest-even like float_to_bf16, but flushes
+// float32 subnormals (|x| < 1.2e-38) to zero
+__attribute__((target("avx512bf16,avx512f,avx2")))
+static void narrow_bf16_avx512(const float* src, uint16_t* dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256bh h = _mm512_cvtneps_pbh(_mm512_loadu_ps(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), (__m256i)h);
+    }
+    for (; i < n; i++) dst[i] = float_to_bf16(src[i]);
+}
+
+struct ConvertISA {
+    bool f16c = false;
+    bool avx512 = false;
+    bool avx512bf16 = false;
+
+    ConvertISA() {
+        __builtin_cpu_init();
+        f16c = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c");
+        avx512 = f16c && __builtin_cpu_supports("avx512f");
+        avx512bf16 = avx512 && __builtin_cpu_supports("avx512bf16");
+    }
+};
+
+static const ConvertISA& convert_isa() {
+    static const ConvertISA isa;
+    return isa;
+}
+#endif
+
+void widen_to_float(const uint16_t* src, float* dst, size_t n, uint32_t dtype) {
+#if KNN_X86
+    const ConvertISA& isa = convert_isa();
+    if (dtype == DTYPE_BF16 && isa.avx512) return widen_bf16_avx512(src, dst, n);
+    if (dtype == DTYPE_F16 && isa.avx512) return widen_f16_avx512(src, dst, n);
+    if (dtype == DTYPE_F16 && isa.f16c) return widen_f16_f16c(src, dst, n);
+#endif
+    if (dtype == DTYPE_BF16) {
+        // A shift per element: the compiler vectorises this on its own
+        #pragma omp simd
+        for (size_t i = 0; i < n; i++) dst[i] = bf16_to_float(src[i]);
+        return;
+    }
+    for (size_t i = 0; i < n; i++) dst[i] = half_to_float(src[i]);
+}
+
+void narrow_from_float(const float* src, uint16_t* dst, size_t n, uint32_t dtype) {
+#if KNN_X86
+    const ConvertISA& isa = convert_isa();
+    if (dtype == DTYPE_BF16 && isa.avx512bf16) return narrow_bf16_avx512(src, dst, n);
+    if (dtype == DTYPE_F16 && isa.f16c) return narrow_f16_f16c(src, dst, n);
+#endif
+    if (dtype == DTYPE_BF16) {
+        for (size_t i = 0; i < n; i++) dst[i] = float_to_bf16(src[i]);
+        return;
+    }
+    for (size_t i = 0; i < n; i++) dst[i] = float_to_half(src[i]);
+}
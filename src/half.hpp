@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Element types of a stored dataset. float16 and bfloat16 rows hold the raw
+// 16-bit patterns; distances over them are still accumulated in float32.
+enum DType : uint32_t {
+    DTYPE_F32 = 0,
+    DTYPE_F16 = 1,
+    DTYPE_BF16 = 2,
+};
+
+// Portable IEEE-754 binary16 <-> binary32 conversions (round-to-nearest-even).
+
+inline float half_to_float(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t bits;
+
+    if (exp == 0) {
+        if (mant == 0) {
+            bits = sign;
+        } else {
+            // Subnormal: renormalise
+            exp = 127 - 15 + 1;
+            while ((mant & 0x400) == 0) { mant <<= 1; exp--; }
+            bits = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+        }
+    } else if (exp == 0x1f) {
+        bits = sign | 0x7f800000 | (mant << 13);
+    } else {
+        bits = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+    }
+
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+inline uint16_t float_to_half(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t absx = x & 0x7fffffff;
+
+    if (absx >= 0x7f800000) { // Inf / NaN
+        return (uint16_t)(sign | 0x7c00 | (absx > 0x7f800000 ? 0x200 : 0));
+    }
+    if (absx >= 0x477ff000) { // Rounds to >= 65520: overflow to Inf
+        return (uint16_t)(sign | 0x7c00);
+    }
+    if (absx < 0x38800000) { // Result is subnormal or zero
+        if (absx < 0x33000000) return (uint16_t)sign;
+        uint32_t mant = (absx & 0x7fffff) | 0x800000;
+        int shift = 126 - (int)(absx >> 23);
+        uint32_t half = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1);
+        uint32_t mid = 1u << (shift - 1);
+        if (rem > mid || (rem == mid && (half & 1))) half++;
+        return (uint16_t)(sign | half);
+    }
+    uint32_t bits = absx - ((127 - 15) << 23);
+    uint32_t half = bits >> 13;
+    uint32_t rem = bits & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) half++;
+    return (uint16_t)(sign | half);
+}
+
+// bfloat16 is the top half of a binary32: widening is a shift, narrowing
+// rounds to nearest-even (NaNs stay quiet NaNs).
+inline float bf16_to_float(uint16_t h) {
+    uint32_t bits = (uint32_t)h << 16;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+inline uint16_t float_to_bf16(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    if ((x & 0x7fffffff) > 0x7f800000) return (uint16_t)((x >> 16) | 0x40);
+    x += 0x7fff + ((x >> 16) & 1);
+    return (uint16_t)(x >> 16);
+}
+
+// Bulk conversions for DTYPE_F16 / DTYPE_BF16 buffers, vectorised with F16C,
+// AVX-512F and AVX-512-BF16 when the CPU has them. Results match the scalar
+// functions above, except that AVX-512-BF16 narrowing flushes float32
+// subnormals to zero.
+void widen_to_float(const uint16_t* src, float* dst, size_t n, uint32_t dtype);
+void narrow_from_float(const float* src, uint16_t* dst, size_t n, uint32_t dtype);
@@ -0,0 +1,431 @@
+#include "hnsw_index.hpp"
+#include "cpu_distance.hpp"
+#include "cpu_topk.hpp"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <type_traits>
+#include <omp.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static constexpr char kHnswMagic[8] = {'K', 'N', 'N', 'H', 'N', 'S', 'W', '1'};
+static constexpr uint32_t kMaxM = 64;      // bounds the on-stack link copies
+static constexpr uint32_t kMaxLevel = 31;
+
+namespace {
+
+// Visited marks as a bitmap; only the words that were set are cleared
+struct VisitedSet {
+    std::vector<uint64_t> bits;
+    std::vector<uint32_t> touched;
+
+    void reset(size_t n) {
+        if (bits.size() != (n + 63) / 64) bits.assign((n + 63) / 64, 0);
+        for (uint32_t w : touched) bits[w] = 0;
+        touched.clear();
+    }
+    bool insert(uint32_t id) {
+        uint64_t& w = bits[id >> 6];
+        uint64_t mask = 1ull << (id & 63);
+        if (w & mask) return false;
+        if (w == 0) touched.push_back(id >> 6);
+        w |= mask;
+        return true;
+    }
+};
+
+struct NearestFirst {
+    bool operator()(const KeyIdx& a, const KeyIdx& b) const { return key_less(b, a); }
+};
+using CandidateQueue = std::priority_queue<KeyIdx, std::vector<KeyIdx>, NearestFirst>;
+
+// Distance from the policy's query to dataset row `id`
+template <class Metric>
+struct RowDist {
+    const Metric& metric;
+    const PointSet& pts;
+    const float* norms;   // may be null; only read when the metric needs norms
+    size_t* evals;
+
+    float operator()(uint32_t id) const {
+        ++*evals;
+        const float* row = pts.row(id);
+        float xn = 0.0f;
+        if constexpr (Metric::kNeedsNorms) xn = norms ? norms[id] : row_norm(row, pts.D);
+        return metric(row, xn);
+    }
+};
+
+// Graph under construction: flat level-0 blocks, per-node upper blocks and a
+// lock per node. Readers copy a node's block under its lock.
+struct BuildGraph {
+    uint32_t M, M0;
+    std::vector<uint32_t> layer0;
+    std::vector<std::vector<uint32_t>> upper;
+    std::vector<uint8_t> levels;
+    std::vector<omp_lock_t> locks;
+
+    uint32_t capacity(uint32_t level) const { return level == 0 ? M0 : M; }
+    uint32_t* links(uint32_t n, uint32_t level) {
+        return level == 0 ? &layer0[(size_t)n * (M0 + 1)] : &upper[n][(size_t)(level - 1) * (M + 1)];
+    }
+
+    template <class F>
+    void for_neighbours(uint32_t n, uint32_t level, F&& f) {
+        uint32_t copy[2 * kMaxM + 1];
+        omp_set_lock(&locks[n]);
+        const uint32_t* blk = links(n, level);
+        std::memcpy(copy, blk, sizeof(uint32_t) * (blk[0] + 1));
+        omp_unset_lock(&locks[n]);
+        for (uint32_t j = 1; j <= copy[0]; j++) f(copy[j]);
+    }
+};
+
+// Read-only view over a mapped index file
+struct MappedGraph {
+    uint32_t M, M0;
+    const uint64_t* upper_offsets;
+    const uint32_t* layer0;
+    const uint32_t* upper;
+
+    template <class F>
+    void for_neighbours(uint32_t n, uint32_t level, F&& f) const {
+        const uint32_t* blk = level == 0 ? layer0 + (size_t)n * (M0 + 1)
+                                         : upper + upper_offsets[n] + (size_t)(level - 1) * (M + 1);
+        for (uint32_t j = 1; j <= blk[0]; j++) f(blk[j]);
+    }
+};
+
+// Greedy walk on one upper level: move to the nearest neighbour until no improvement
+template <class Dist, class Graph>
+KeyIdx greedy_step(Graph& g, const Dist& dist, KeyIdx cur, uint32_t level) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        KeyIdx best = cur;
+        g.for_neighbours(cur.idx, level, [&](uint32_t n) {
+            KeyIdx cand{dist(n), n};
+            if (key_less(cand, best)) best = cand;
+        });
+        if (best.idx != cur.idx) {
+            cur = best;
+            changed = true;
+        }
+    }
+    return cur;
+}
+
+// Best-first search of one level keeping the ef nearest; returns them ascending
+template <class Dist, class Graph>
+std::vector<KeyIdx> search_layer(Graph& g, const Dist& dist, const std::vector<KeyIdx>& entry,
+                                 uint32_t ef, uint32_t level, VisitedSet& visited) {
+    TopK found(ef);
+    CandidateQueue frontier;
+    for (const KeyIdx& e : entry) {
+        if (!visited.insert(e.idx)) continue;
+        found.push(e);
+        frontier.push(e);
+    }
+    while (!frontier.empty()) {
+        KeyIdx c = frontier.top();
+        if (c.dist > found.worst()) break;
+        frontier.pop();
+        g.for_neighbours(c.idx, level, [&](uint32_t n) {
+            if (!visited.insert(n)) return;
+            float d = dist(n);
+            if (d < found.worst()) {
+                found.push({d, n});
+                frontier.push({d, n});
+            }
+        });
+    }
+    return found.sorted();
+}
+
+// Neighbour-diversity heuristic (HNSW paper, algorithm 4): keep a candidate
+// only if it is nearer to the base than to every neighbour kept so far.
+// `cands` must be ascending.
+template <class Metric>
+std::vector<KeyIdx> select_neighbours(const PointSet& pts, const float* norms,
+                                      const std::vector<KeyIdx>& cands, uint32_t max_links, size_t* evals) {
+    std::vector<KeyIdx> kept;
+    kept.reserve(max_links);
+    for (const KeyIdx& c : cands) {
+        if (kept.size() == max_links) break;
+        Metric from_c(pts.row(c.idx), pts.D);
+        RowDist<Metric> dist{from_c, pts, norms, evals};
+        bool diverse = true;
+        for (const KeyIdx& r : kept) {
+            if (dist(r.idx) < c.dist) {
+                diverse = false;
+                break;
+            }
+        }
+        if (diverse) kept.push_back(c);
+    }
+    return kept;
+}
+
+struct EntryPoint {
+    omp_lock_t lock;
+    uint32_t node = 0;
+    uint32_t level = 0;
+};
+
+template <class Metric>
+void insert_node(BuildGraph& g, const PointSet& pts, const float* norms, uint32_t i, uint32_t ef_construction,
+                 EntryPoint& entry, VisitedSet& visited, size_t* evals) {
+    const uint32_t level = g.levels[i];
+    Metric metric(pts.row(i), pts.D);
+    RowDist<Metric> dist{metric, pts, norms, evals};
+
+    // A node that raises the top level keeps the entry lock until it is linked
+    omp_set_lock(&entry.lock);
+    const uint32_t ep = entry.node;
+    const uint32_t top = entry.level;
+    const bool raises = level > top;
+    if (!raises) omp_unset_lock(&entry.lock);
+
+    KeyIdx cur{dist(ep), ep};
+    for (uint32_t l = top; l > level; l--) cur = greedy_step(g, dist, cur, l);
+
+    std::vector<KeyIdx> eps{cur};
+    for (int l = (int)std::min(level, top); l >= 0; l--) {
+        visited.reset(pts.size());
+        visited.insert(i);
+        std::vector<KeyIdx> found = search_layer(g, dist, eps, ef_construction, l, visited);
+        std::vector<KeyIdx> chosen = select_neighbours<Metric>(pts, norms, found, g.M, evals);
+
+        omp_set_lock(&g.locks[i]);
+        uint32_t* own = g.links(i, l);
+        own[0] = (uint32_t)chosen.size();
+        for (size_t j = 0; j < chosen.size(); j++) own[1 + j] = chosen[j].idx;
+        omp_unset_lock(&g.locks[i]);
+
+        // Back-links; a full block is re-pruned with the same heuristic
+        const uint32_t cap = g.capacity(l);
+        for (const KeyIdx& nb : chosen) {
+            omp_set_lock(&g.locks[nb.idx]);
+            uint32_t* blk = g.links(nb.idx, l);
+            if (blk[0] < cap) {
+                blk[1 + blk[0]++] = i;
+            } else {
+                Metric from_nb(pts.row(nb.idx), pts.D);
+                RowDist<Metric> nb_dist{from_nb, pts, norms, evals};
+                std::vector<KeyIdx> cands{{nb.dist, i}};
+                for (uint32_t j = 1; j <= blk[0]; j++) cands.push_back({nb_dist(blk[j]), blk[j]});
+                std::sort(cands.begin(), cands.end(), key_less);
+                std::vector<KeyIdx> keep = select_neighbours<Metric>(pts, norms, cands, cap, evals);
+                blk[0] = (uint32_t)keep.size();
+                for (size_t j = 0; j < keep.size(); j++) blk[1 + j] = keep[j].idx;
+            }
+            omp_unset_lock(&g.locks[nb.idx]);
+        }
+        eps = std::move(found);
+    }
+
+    if (raises) {
+        entry.node = i;
+        entry.level = level;
+        omp_unset_lock(&entry.lock);
+    }
+}
+
+bool write_all(int fd, const void* data, size_t bytes) {
+    const char* p = static_cast<const char*>(data);
+    while (bytes > 0) {
+        ssize_t w = write(fd, p, bytes);
+        if (w <= 0) return false;
+        p += w;
+        bytes -= (size_t)w;
+    }
+    return true;
+}
+
+} // namespace
+
+bool HnswIndex::build(const PointSet& pts, uint32_t M, uint32_t ef_construction, MetricKind metric,
+                      uint64_t seed, const std::string& filename, HnswBuildStats& stats) {
+    const size_t N = pts.size();
+    if (N == 0 || N > UINT32_MAX) return false;
+    if (M < 2 || M > kMaxM) {
+        std::cerr << "HNSW M must be between 2 and " << kMaxM << "\n";
+        return false;
+    }
+    double t0 = omp_get_wtime();
+
+    BuildGraph g;
+    g.M = M;
+    g.M0 = 2 * M;
+    g.layer0.assign(N * (g.M0 + 1), 0);
+    g.upper.resize(N);
+    g.levels.resize(N);
+    g.locks.resize(N);
+
+    // 1. Levels: geometric with ratio 1/M, drawn up front so they depend only on the seed
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    const double level_mult = 1.0 / std::log((double)M);
+    for (size_t i = 0; i < N; i++) {
+        double u = std::max(uniform(rng), 1e-12);
+        g.levels[i] = (uint8_t)std::min<double>(kMaxLevel, std::floor(-std::log(u) * level_mult));
+    }
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < N; i++) {
+        if (g.levels[i] > 0) g.upper[i].assign((size_t)g.levels[i] * (M + 1), 0);
+        omp_init_lock(&g.locks[i]);
+    }
+
+    // Cosine needs row norms; compute them once if the caller has not
+    std::vector<float> local_norms;
+    const float* norms = pts.norms.empty() ? nullptr : pts.norms.data();
+    if (metric == MetricKind::Cosine && !norms) {
+        local_norms.resize(N);
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < N; i++) local_norms[i] = row_norm(pts.row(i), pts.D);
+        norms = local_norms.data();
+    }
+
+    // 2. Node 0 seeds the graph; the rest are inserted concurrently
+    EntryPoint entry;
+    omp_init_lock(&entry.lock);
+    entry.node = 0;
+    entry.level = g.levels[0];
+
+    dispatch_metric(metric, pts.row(0), pts.D, [&](const auto& proto) {
+        using Metric = std::decay_t<decltype(proto)>;
+        #pragma omp parallel
+        {
+            VisitedSet visited;
+            size_t evals = 0;
+            #pragma omp for schedule(dynamic, 64)
+            for (size_t i = 1; i < N; i++) {
+                insert_node<Metric>(g, pts, norms, (uint32_t)i, ef_construction, entry, visited, &evals);
+            }
+        }
+    });
+
+    omp_destroy_lock(&entry.lock);
+    for (omp_lock_t& l : g.locks) omp_destroy_lock(&l);
+    stats.build_time = omp_get_wtime() - t0;
+    stats.max_level = entry.level;
+
+    // 3. Flatten the upper blocks and write the file
+    std::vector<uint64_t> upper_offsets(N + 1, 0);
+    for (size_t i = 0; i < N; i++) upper_offsets[i + 1] = upper_offsets[i] + g.upper[i].size();
+    uint64_t degree_sum = 0;
+    for (size_t i = 0; i < N; i++) degree_sum += g.layer0[i * (g.M0 + 1)];
+    stats.mean_degree = (double)degree_sum / N;
+
+    HnswHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, kHnswMagic, sizeof(h.magic));
+    h.N = N;
+    h.D = pts.D;
+    h.M = M;
+    h.M0 = g.M0;
+    h.metric = (uint32_t)metric;
+    h.entry = entry.node;
+    h.max_level = entry.level;
+    h.upper_words = upper_offsets[N];
+
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        std::cerr << "System Error: " << std::strerror(errno) << " (" << filename << ")" << std::endl;
+        return false;
+    }
+    bool ok = write_all(fd, &h, sizeof(h)) &&
+              write_all(fd, upper_offsets.data(), sizeof(uint64_t) * upper_offsets.size()) &&
+              write_all(fd, g.layer0.data(), sizeof(uint32_t) * g.layer0.size());
+    for (size_t i = 0; ok && i < N; i++) {
+        if (!g.upper[i].empty()) ok = write_all(fd, g.upper[i].data(), sizeof(uint32_t) * g.upper[i].size());
+    }
+    ok = ok && write_all(fd, g.levels.data(), g.levels.size());
+    if (close(fd) != 0) ok = false;
+    if (!ok) std::cerr << "Error: File write failed (Disk full or quota exceeded?)" << std::endl;
+    return ok;
+}
+
+bool HnswIndex::open(const std::string& filename) {
+    if (!file_.map(filename, sizeof(HnswHeader))) return false;
+    file_.header(header_);
+    const uint64_t N = header_.N;
+
+    // 1. Sections must fit the file
+    uint64_t at = sizeof(HnswHeader);
+    const uint64_t upper_offsets_at = at;
+    bool valid = std::memcmp(header_.magic, kHnswMagic, sizeof(kHnswMagic)) == 0 && N > 0 &&
+                 N <= UINT32_MAX && header_.D > 0 && header_.M >= 2 && header_.M <= kMaxM &&
+                 header_.M0 <= 2 * kMaxM && header_.metric <= (uint32_t)MetricKind::L1 &&
+                 header_.entry < N && header_.max_level <= kMaxLevel &&
+                 file_.extent(at, N + 1, sizeof(uint64_t));
+    const uint64_t layer0_at = at;
+    valid = valid && file_.extent(at, N, sizeof(uint32_t) * (header_.M0 + 1));
+    const uint64_t upper_at = at;
+    valid = valid && file_.extent(at, header_.upper_words, sizeof(uint32_t));
+    const uint64_t levels_at = at;
+    valid = valid && file_.extent(at, N, sizeof(uint8_t));
+    if (valid) {
+        upper_offsets_ = file_.at<uint64_t>(upper_offsets_at);
+        layer0_ = file_.at<uint32_t>(layer0_at);
+        upper_ = file_.at<uint32_t>(upper_at);
+        levels_ = file_.at<uint8_t>(levels_at);
+    }
+
+    // 2. Every node owns levels(n) upper blocks, and the entry point sits on the top level
+    valid = valid && upper_offsets_[0] == 0 && upper_offsets_[N] == header_.upper_words &&
+            levels_[header_.entry] == header_.max_level;
+    for (uint64_t n = 0; valid && n < N; n++) {
+        valid = levels_[n] <= header_.max_level && upper_offsets_[n] <= upper_offsets_[n + 1] &&
+                upper_offsets_[n + 1] - upper_offsets_[n] == (uint64_t)levels_[n] * (header_.M + 1);
+    }
+
+    // 3. Links stay within their block and point at nodes present on that level
+    auto links_valid = [&](const uint32_t* blk, uint32_t cap, uint32_t level) {
+        if (blk[0] > cap) return false;
+        for (uint32_t j = 1; j <= blk[0]; j++) {
+            if (blk[j] >= N || levels_[blk[j]] < level) return false;
+        }
+        return true;
+    };
+    for (uint64_t n = 0; valid && n < N; n++) {
+        valid = links_valid(layer0_ + n * (header_.M0 + 1), header_.M0, 0);
+        for (uint32_t l = 1; valid && l <= levels_[n]; l++) {
+            valid = links_valid(upper_ + upper_offsets_[n] + (uint64_t)(l - 1) * (header_.M + 1), header_.M, l);
+        }
+    }
+    if (!valid) {
+        std::cerr << "Not a valid HNSW index: " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
+std::vector<KeyIdx> HnswIndex::search(const PointSet& pts, const float* q, size_t k, uint32_t ef,
+                                      size_t* visited_count) const {
+    static thread_local VisitedSet visited;
+    const MappedGraph g{header_.M, header_.M0, upper_offsets_, layer0_, upper_};
+    const float* norms = pts.norms.empty() ? nullptr : pts.norms.data();
+    size_t evals = 0;
+
+    std::vector<KeyIdx> found = dispatch_metric(metric(), q, pts.D, [&](const auto& m) {
+        using Metric = std::decay_t<decltype(m)>;
+        RowDist<Metric> dist{m, pts, norms, &evals};
+
+        KeyIdx cur{dist(header_.entry), header_.entry};
+        for (uint32_t l = header_.max_level; l > 0; l--) cur = greedy_step(g, dist, cur, l);
+
+        visited.reset(header_.N);
+        return search_layer(g, dist, {cur}, (uint32_t)std::max<size_t>(ef, k), 0, visited);
+    });
+
+    if (found.size() > k) found.resize(k);
+    if (visited_count) *visited_count = evals;
+    return found;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "PointSet.hpp"
+#include "mapped_file.hpp"
+#include "metrics.hpp"
+
+// Hierarchical navigable small-world (HNSW) graph index for low-latency
+// single-query k-NN. Every row is a graph node; level 0 links each node to
+// up to M0 = 2M neighbours and the sparse upper levels (M links) route a
+// query greedily towards its neighbourhood before the ef-wide level-0 search.
+// Distances go through the metric policies, so the runtime-dispatched
+// kernels are used for both construction and search.
+//
+// File layout (.hnsw), mmapped on open:
+//   [ HnswHeader ][ N + 1 uint64 upper offsets ][ N x (M0 + 1) uint32 level-0 links ]
+//   [ upper_words uint32 upper links ][ N uint8 levels ]
+// A link block is [count, id, id, ...]; node n owns levels(n) upper blocks of
+// M + 1 words starting at its upper offset. Coordinates stay in the dataset.
+
+struct HnswHeader {
+    char magic[8];      // "KNNHNSW1"
+    uint64_t N;
+    uint32_t D;
+    uint32_t M;
+    uint32_t M0;
+    uint32_t metric;    // MetricKind the graph was built with
+    uint32_t entry;
+    uint32_t max_level;
+    uint64_t upper_words;
+    uint64_t reserved[2];
+};
+static_assert(sizeof(HnswHeader) == 64, "HnswHeader must stay 64 bytes");
+
+struct HnswBuildStats {
+    double build_time = 0.0;
+    uint32_t max_level = 0;
+    double mean_degree = 0.0;   // level-0 links per node
+};
+
+class HnswIndex {
+public:
+    HnswIndex() = default;
+    HnswIndex(const HnswIndex&) = delete;
+    HnswIndex& operator=(const HnswIndex&) = delete;
+
+    // Inserts all rows in parallel (per-node locks) and writes the index file.
+    // Node levels come from `seed`; link order can vary with thread timing.
+    static bool build(const PointSet& pts, uint32_t M, uint32_t ef_construction, MetricKind metric,
+                      uint64_t seed, const std::string& filename, HnswBuildStats& stats);
+
+    // Maps an index file for querying. Rejects files whose sections overrun
+    // the file, or whose entry point, levels or links are out of range.
+    bool open(const std::string& filename);
+
+    size_t size() const { return header_.N; }
+    int dims() const { return (int)header_.D; }
+    uint32_t M() const { return header_.M; }
+    MetricKind metric() const { return (MetricKind)header_.metric; }
+
+    // Top-k for one query with a candidate list of max(ef, k). Single-threaded:
+    // latency, not throughput, is the target. `visited` receives the number of
+    // distance evaluations.
+    std::vector<KeyIdx> search(const PointSet& pts, const float* q, size_t k, uint32_t ef,
+                               size_t* visited = nullptr) const;
+
+private:
+    MappedFile file_;
+    HnswHeader header_{};
+    const uint64_t* upper_offsets_ = nullptr;
+    const uint32_t* layer0_ = nullptr;
+    const uint32_t* upper_ = nullptr;
+    const uint8_t* levels_ = nullptr;
+};
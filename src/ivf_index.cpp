@@ -0,0 +1,188 @@
+#include "ivf_index.hpp"
+#include "kmeans.hpp"
+#include "cpu_topk.hpp"
+#include "distance_kernels.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <unordered_set>
+#include <omp.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static constexpr char kIvfMagic[8] = {'K', 'N', 'N', 'I', 'V', 'F', '1', '\0'};
+static constexpr size_t kTrainPerList = 256;  // k-means sample size per centroid
+
+bool IvfIndex::build(const PointSet& pts, uint32_t nlist, int iterations, uint64_t seed,
+                     const std::string& filename, IvfBuildStats& stats) {
+    const size_t N = pts.size();
+    const int D = pts.D;
+    if (N == 0 || nlist == 0) return false;
+    nlist = (uint32_t)std::min<size_t>(nlist, N);
+
+    double t0 = omp_get_wtime();
+    std::mt19937_64 rng(seed);
+
+    // 1. Train the coarse centroids on a sample
+    PointSet train = sample_rows(pts, (size_t)nlist * kTrainPerList, rng);
+    PointSet centroids;
+    kmeans_train(train, nlist, iterations, rng, centroids);
+    stats.train_rows = train.size();
+    stats.iterations = iterations;
+    stats.train_time = omp_get_wtime() - t0;
+
+    // 2. Assign every row and build the posting lists
+    double t1 = omp_get_wtime();
+    std::vector<uint32_t> assign;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> members;
+    kmeans_assign(pts, centroids, assign);
+    bucket_by_cluster(assign, nlist, offsets, members);
+    stats.assign_time = omp_get_wtime() - t1;
+
+    stats.largest_list = 0;
+    stats.empty_lists = 0;
+    for (uint32_t c = 0; c < nlist; c++) {
+        uint64_t size = offsets[c + 1] - offsets[c];
+        stats.largest_list = std::max<size_t>(stats.largest_list, size);
+        if (size == 0) stats.empty_lists++;
+    }
+
+    // 3. Write the file
+    IvfHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, kIvfMagic, sizeof(h.magic));
+    h.N = N;
+    h.D = D;
+    h.nlist = nlist;
+
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        std::cerr << "System Error: " << std::strerror(errno) << " (" << filename << ")" << std::endl;
+        return false;
+    }
+    bool ok = write(fd, &h, sizeof(h)) == (ssize_t)sizeof(h);
+    size_t cbytes = sizeof(float) * nlist * (size_t)D;
+    ok = ok && write(fd, centroids.coords, cbytes) == (ssize_t)cbytes;
+    ok = ok && write(fd, offsets.data(), sizeof(uint64_t) * offsets.size()) == (ssize_t)(sizeof(uint64_t) * offsets.size());
+    ok = ok && write(fd, members.data(), sizeof(uint32_t) * members.size()) == (ssize_t)(sizeof(uint32_t) * members.size());
+    if (close(fd) != 0) ok = false;
+    if (!ok) std::cerr << "Error: File write failed (Disk full or quota exceeded?)" << std::endl;
+    return ok;
+}
+
+bool IvfIndex::open(const std::string& filename) {
+    if (!file_.map(filename, sizeof(IvfHeader))) return false;
+    file_.header(header_);
+
+    // 1. Sections must fit the file
+    uint64_t at = sizeof(IvfHeader);
+    const uint64_t centroids_at = at;
+    bool valid = std::memcmp(header_.magic, kIvfMagic, sizeof(kIvfMagic)) == 0 && header_.D > 0 &&
+                 header_.nlist > 0 && header_.N <= UINT32_MAX &&
+                 file_.extent(at, (uint64_t)header_.nlist * header_.D, sizeof(float));
+    const uint64_t offsets_at = at;
+    valid = valid && file_.extent(at, (uint64_t)header_.nlist + 1, sizeof(uint64_t));
+    const uint64_t ids_at = at;
+    valid = valid && file_.extent(at, header_.N, sizeof(uint32_t));
+    if (valid) {
+        centroids_ = file_.at<float>(centroids_at);
+        offsets_ = file_.at<uint64_t>(offsets_at);
+        ids_ = file_.at<uint32_t>(ids_at);
+    }
+
+    // 2. Posting lists partition [0, N) and hold only row ids below N
+    valid = valid && offsets_[0] == 0 && offsets_[header_.nlist] == header_.N;
+    for (uint32_t c = 0; valid && c < header_.nlist; c++) valid = offsets_[c] <= offsets_[c + 1];
+    for (uint64_t i = 0; valid && i < header_.N; i++) valid = ids_[i] < header_.N;
+    if (!valid) {
+        std::cerr << "Not a valid IVF index: " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
+std::vector<uint32_t> IvfIndex::probe(const float* q, uint32_t nprobe) const {
+    const int D = dims();
+    const L2Kernel dist = select_l2_kernel(D);
+    std::vector<KeyIdx> cells(header_.nlist);
+    for (uint32_t c = 0; c < header_.nlist; c++) cells[c] = {dist(centroids_ + (size_t)c * D, q, D), c};
+
+    nprobe = std::min(nprobe, header_.nlist);
+    std::partial_sort(cells.begin(), cells.begin() + nprobe, cells.end(), key_less);
+    std::vector<uint32_t> out(nprobe);
+    for (uint32_t i = 0; i < nprobe; i++) out[i] = cells[i].idx;
+    return out;
+}
+
+template <class Metric>
+static inline void score_row(const PointSet& pts, uint32_t id, const Metric& metric, TopK& heap) {
+    const float* row = pts.row(id);
+    float xn = 0.0f;
+    if constexpr (Metric::kNeedsNorms) xn = pts.norms.empty() ? row_norm(row, pts.D) : pts.norms[id];
+    float d = metric(row, xn);
+    if (d <= heap.worst()) heap.push({d, id});
+}
+
+std::vector<KeyIdx> IvfIndex::search(const PointSet& pts, const float* q, size_t k, uint32_t nprobe,
+                                     MetricKind metric, size_t* scanned) const {
+    std::vector<uint32_t> cells = probe(q, nprobe);
+
+    // Flatten the probed posting lists so the scan splits evenly across threads
+    std::vector<uint32_t> cand;
+    for (uint32_t c : cells) cand.insert(cand.end(), ids_ + offsets_[c], ids_ + offsets_[c + 1]);
+    if (scanned) *scanned = cand.size();
+
+    std::vector<TopK> partial(omp_get_max_threads(), TopK(k));
+    dispatch_metric(metric, q, pts.D, [&](const auto& m) {
+        #pragma omp parallel
+        {
+            TopK& local = partial[omp_get_thread_num()];
+            #pragma omp for schedule(static)
+            for (size_t i = 0; i < cand.size(); i++) score_row(pts, cand[i], m, local);
+        }
+    });
+
+    TopK result(k);
+    for (const TopK& t : partial) result.merge(t);
+    return result.sorted();
+}
+
+std::vector<std::vector<KeyIdx>> IvfIndex::search_batch(const PointSet& pts, const PointSet& queries, size_t k,
+                                                        uint32_t nprobe, MetricKind metric, size_t* scanned) const {
+    std::vector<std::vector<KeyIdx>> results(queries.size());
+    size_t total = 0;
+
+    #pragma omp parallel for schedule(dynamic, 1) reduction(+:total)
+    for (size_t qi = 0; qi < queries.size(); qi++) {
+        const float* q = queries.row(qi);
+        TopK heap(k);
+        for (uint32_t c : probe(q, nprobe)) {
+            total += offsets_[c + 1] - offsets_[c];
+            dispatch_metric(metric, q, pts.D, [&](const auto& m) {
+                for (uint64_t i = offsets_[c]; i < offsets_[c + 1]; i++) score_row(pts, ids_[i], m, heap);
+            });
+        }
+        results[qi] = heap.sorted();
+    }
+    if (scanned) *scanned = total;
+    return results;
+}
+
+double recall_at_k(const std::vector<std::vector<KeyIdx>>& approx,
+                   const std::vector<std::vector<KeyIdx>>& exact) {
+    if (exact.empty()) return 1.0;
+    double sum = 0.0;
+    for (size_t q = 0; q < exact.size(); q++) {
+        if (exact[q].empty()) { sum += 1.0; continue; }
+        std::unordered_set<uint32_t> truth;
+        for (const KeyIdx& e : exact[q]) truth.insert(e.idx);
+        size_t hit = 0;
+        for (const KeyIdx& a : approx[q]) hit += truth.count(a.idx);
+        sum += (double)hit / exact[q].size();
+    }
+    return sum / exact.size();
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "PointSet.hpp"
+#include "mapped_file.hpp"
+#include "metrics.hpp"
+
+// Inverted-file (IVF) approximate nearest-neighbour index.
+// k-means centroids partition the dataset into `nlist` cells; every row id is
+// stored in the posting list of its nearest centroid. A query scans only the
+// `nprobe` cells whose centroids are nearest, instead of all N rows.
+//
+// File layout (.ivf), mmapped on open:
+//   [ IvfHeader ][ nlist x D centroids ][ nlist + 1 uint64 offsets ][ N uint32 ids ]
+// Coordinates are not duplicated: candidates are read from the dataset by id.
+
+struct IvfHeader {
+    char magic[8];      // "KNNIVF1\0"
+    uint64_t N;
+    uint32_t D;
+    uint32_t nlist;
+    uint64_t reserved[5];
+};
+static_assert(sizeof(IvfHeader) == 64, "IvfHeader must stay 64 bytes");
+
+struct IvfBuildStats {
+    size_t train_rows = 0;
+    int iterations = 0;
+    double train_time = 0.0;
+    double assign_time = 0.0;
+    size_t largest_list = 0;
+    size_t empty_lists = 0;
+};
+
+class IvfIndex {
+public:
+    IvfIndex() = default;
+    IvfIndex(const IvfIndex&) = delete;
+    IvfIndex& operator=(const IvfIndex&) = delete;
+
+    // Trains `nlist` centroids on a sample with parallel Lloyd iterations,
+    // assigns every row, and writes the index file.
+    static bool build(const PointSet& pts, uint32_t nlist, int iterations, uint64_t seed,
+                      const std::string& filename, IvfBuildStats& stats);
+
+    // Maps an index file for querying. Rejects files whose sections overrun
+    // the file or whose posting lists do not partition the N row ids.
+    bool open(const std::string& filename);
+
+    size_t size() const { return header_.N; }
+    int dims() const { return (int)header_.D; }
+    uint32_t nlist() const { return header_.nlist; }
+
+    // Top-k for one query over the `nprobe` nearest cells; the candidate
+    // scan is parallel. `scanned` receives the number of rows scored.
+    std::vector<KeyIdx> search(const PointSet& pts, const float* q, size_t k, uint32_t nprobe,
+                               MetricKind metric, size_t* scanned = nullptr) const;
+
+    // Top-k for every query row; parallel over queries.
+    std::vector<std::vector<KeyIdx>> search_batch(const PointSet& pts, const PointSet& queries, size_t k,
+                                                  uint32_t nprobe, MetricKind metric,
+                                                  size_t* scanned = nullptr) const;
+
+private:
+    // The `nprobe` cells nearest to q, nearest first
+    std::vector<uint32_t> probe(const float* q, uint32_t nprobe) const;
+
+    MappedFile file_;
+    IvfHeader header_{};
+    const float* centroids_ = nullptr;
+    const uint64_t* offsets_ = nullptr;
+    const uint32_t* ids_ = nullptr;
+};
+
+// Mean fraction of the exact top-k that the approximate results recovered.
+double recall_at_k(const std::vector<std::vector<KeyIdx>>& approx,
+                   const std::vector<std::vector<KeyIdx>>& exact);
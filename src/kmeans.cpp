@@ -0,0 +1,125 @@
+#include "kmeans.hpp"
+#include "cpu_batch.hpp"
+#include <algorithm>
+#include <cstring>
+#include <omp.h>
+
+static constexpr size_t kAssignChunk = 1 << 16;
+
+// Non-owning PointSet over rows [begin, begin + n) of `pts`
+static PointSet row_view(const PointSet& pts, size_t begin, size_t n) {
+    PointSet view;
+    view.N = n;
+    view.D = pts.D;
+    view.coords = const_cast<float*>(pts.row(begin));
+    view.storage = pts.storage;
+    return view;
+}
+
+PointSet sample_rows(const PointSet& pts, size_t n, std::mt19937_64& rng) {
+    n = std::min(n, pts.size());
+    PointSet out;
+    out.allocate(n, pts.D);
+    if (n == 0) return out;
+    size_t stride = pts.size() / n;
+    std::vector<size_t> pick(n);
+    for (size_t i = 0; i < n; i++) pick[i] = i * stride + (stride > 1 ? rng() % stride : 0);
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++) std::memcpy(out.row(i), pts.row(pick[i]), sizeof(float) * pts.D);
+    return out;
+}
+
+void kmeans_assign(const PointSet& pts, const PointSet& centroids, std::vector<uint32_t>& assign) {
+    assign.resize(pts.size());
+    std::vector<float> cn = compute_sq_norms(centroids);
+    for (size_t start = 0; start < pts.size(); start += kAssignChunk) {
+        size_t n = std::min(kAssignChunk, pts.size() - start);
+        std::vector<std::vector<KeyIdx>> nn = batch_topk_cpu(centroids, row_view(pts, start, n), 1, cn);
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < n; i++) assign[start + i] = nn[i][0].idx;
+    }
+}
+
+// Per-thread histograms, prefix sum, stable scatter
+void bucket_by_cluster(const std::vector<uint32_t>& assign, uint32_t k,
+                       std::vector<uint64_t>& offsets, std::vector<uint32_t>& ids) {
+    const size_t n = assign.size();
+    const int T = omp_get_max_threads();
+    std::vector<uint64_t> hist((size_t)T * k, 0);
+    offsets.assign(k + 1, 0);
+    ids.resize(n);
+
+    #pragma omp parallel num_threads(T)
+    {
+        const int t = omp_get_thread_num();
+        const int nt = omp_get_num_threads();
+        const size_t begin = n * t / nt, end = n * (t + 1) / nt;
+        uint64_t* h = &hist[(size_t)t * k];
+        for (size_t i = begin; i < end; i++) h[assign[i]]++;
+
+        #pragma omp barrier
+        #pragma omp single
+        {
+            uint64_t sum = 0;
+            for (uint32_t c = 0; c < k; c++) {
+                offsets[c] = sum;
+                for (int tt = 0; tt < nt; tt++) {
+                    uint64_t cnt = hist[(size_t)tt * k + c];
+                    hist[(size_t)tt * k + c] = sum;
+                    sum += cnt;
+                }
+            }
+            offsets[k] = sum;
+        }
+
+        for (size_t i = begin; i < end; i++) ids[h[assign[i]]++] = (uint32_t)i;
+    }
+}
+
+void kmeans_train(const PointSet& train, uint32_t k, int iterations, std::mt19937_64& rng, PointSet& centroids) {
+    const size_t n = train.size();
+    const int D = train.D;
+    centroids.allocate(k, D);
+
+    // 1. Initial centroids: distinct random training rows
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++) order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+    for (uint32_t c = 0; c < k; c++) std::memcpy(centroids.row(c), train.row(order[c]), sizeof(float) * D);
+
+    // 2. Lloyd iterations. Means are computed per cluster after bucketing the
+    //    assignment, so no per-thread k x D accumulators are needed.
+    std::vector<uint32_t> assign;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> members;
+    for (int it = 0; it < iterations; it++) {
+        kmeans_assign(train, centroids, assign);
+        bucket_by_cluster(assign, k, offsets, members);
+
+        #pragma omp parallel for schedule(dynamic, 16)
+        for (uint32_t c = 0; c < k; c++) {
+            uint64_t b = offsets[c], e = offsets[c + 1];
+            if (b == e) continue;
+            std::vector<double> sum(D, 0.0);
+            for (uint64_t m = b; m < e; m++) {
+                const float* row = train.row(members[m]);
+                for (int j = 0; j < D; j++) sum[j] += row[j];
+            }
+            float* cen = centroids.row(c);
+            for (int j = 0; j < D; j++) cen[j] = (float)(sum[j] / (double)(e - b));
+        }
+
+        // Re-seed empty clusters from a perturbed member of the largest one
+        uint32_t largest = 0;
+        for (uint32_t c = 1; c < k; c++) {
+            if (offsets[c + 1] - offsets[c] > offsets[largest + 1] - offsets[largest]) largest = c;
+        }
+        for (uint32_t c = 0; c < k; c++) {
+            if (offsets[c + 1] != offsets[c]) continue;
+            uint64_t size = offsets[largest + 1] - offsets[largest];
+            const float* src = train.row(members[offsets[largest] + rng() % size]);
+            float* cen = centroids.row(c);
+            for (int j = 0; j < D; j++) cen[j] = src[j] * (1.0f + 1e-4f * (float)((int)(rng() % 3) - 1));
+        }
+    }
+}
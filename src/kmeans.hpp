@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "PointSet.hpp"
+
+// Parallel Lloyd k-means (L2), shared by the IVF coarse quantizer and the
+// product-quantizer codebooks.
+
+// `n` rows of `pts` drawn one per stride at a random offset
+PointSet sample_rows(const PointSet& pts, size_t n, std::mt19937_64& rng);
+
+// Nearest centroid of every row, via the blocked batch kernel (k = 1)
+void kmeans_assign(const PointSet& pts, const PointSet& centroids, std::vector<uint32_t>& assign);
+
+// Stable counting sort of row ids by cluster: rows of cluster c are
+// ids[offsets[c] .. offsets[c + 1])
+void bucket_by_cluster(const std::vector<uint32_t>& assign, uint32_t k,
+                       std::vector<uint64_t>& offsets, std::vector<uint32_t>& ids);
+
+// Trains k centroids on `train` (k <= train.size()), initialised from
+// distinct random rows. Empty clusters are re-seeded from the largest.
+void kmeans_train(const PointSet& train, uint32_t k, int iterations, std::mt19937_64& rng, PointSet& centroids);
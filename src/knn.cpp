@@ -0,0 +1,154 @@
+#include "knn.hpp"
+#include "load_points.hpp"
+#include "cpu_distance.hpp"
+#include "cpu_topk.hpp"
+#include "cpu_batch.hpp"
+#include "cpu_mergesort.hpp"
+#include "cpu_prune.hpp"
+#include "gpu_hip.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+const char* backend_name(Backend b) {
+    return b == Backend::GPU ? "gpu" : "cpu";
+}
+
+bool parse_backend(const std::string& name, Backend& b) {
+    if (name == "cpu") b = Backend::CPU;
+    else if (name == "gpu") b = Backend::GPU;
+    else return false;
+    return true;
+}
+
+bool KnnDataset::load(const std::string& path, bool keep_dtype) {
+    sq_norms_.clear();
+    dim_order_.clear();
+    pts_ = PointSet();
+    return load_points(path, pts_, keep_dtype);
+}
+
+void KnnDataset::assign(const float* rows, size_t N, int D) {
+    sq_norms_.clear();
+    dim_order_.clear();
+    pts_ = PointSet();
+    pts_.allocate(N, D);
+    std::memcpy(pts_.coords, rows, sizeof(float) * N * (size_t)D);
+}
+
+void KnnDataset::prepare(MetricKind metric) {
+    if (metric == MetricKind::Cosine && pts_.norms.size() != pts_.size()) compute_norms(pts_);
+    if ((metric == MetricKind::L2 || metric == MetricKind::InnerProduct) && sq_norms_.size() != pts_.size()) {
+        pts_.widen();  // only batched search uses these
+        sq_norms_ = compute_sq_norms(pts_);
+    }
+}
+
+bool KnnDataset::search(const float* queries, size_t nq, size_t k, MetricKind metric, Backend backend,
+                        SearchResult& out) {
+    const int D = pts_.D;
+    k = std::min(k, pts_.size());
+    out.nq = nq;
+    out.k = k;
+    out.keys.resize(nq * k);
+    if (nq == 0 || k == 0) return true;
+    queries = arrange(queries, nq);
+
+    // Only the single-query CPU scan reads fp16/bf16 rows directly
+    if (backend == Backend::GPU || nq > 1) pts_.widen();
+
+    if (backend == Backend::GPU) {
+        // The GPU path ranks the whole dataset per query; keep the first k
+        for (size_t q = 0; q < nq; q++) {
+            ref_.assign(queries + q * D, queries + (q + 1) * D);
+            run_gpu_sort(pts_, ref_, metric);
+            for (size_t j = 0; j < k; j++) out.keys[q * k + j] = {pts_.dist[j], pts_.id[j]};
+        }
+        return true;
+    }
+
+    if (metric == MetricKind::Cosine && pts_.norms.size() != pts_.size()) compute_norms(pts_);
+
+    if (nq == 1) {
+        topk_cpu(pts_, queries, k, metric, scratch_, out.keys.data());
+        return true;
+    }
+
+    // Every dot-product form reads the squared row norms; cosine squares its norm cache
+    prepare(metric);
+    if (metric == MetricKind::Cosine && sq_norms_.size() != pts_.size()) {
+        sq_norms_.resize(pts_.size());
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < pts_.size(); i++) sq_norms_[i] = pts_.norms[i] * pts_.norms[i];
+    }
+    if (staging_capacity_ < nq || staging_.D != D) {
+        staging_.allocate(nq, D);
+        staging_capacity_ = nq;
+    }
+    staging_.N = nq;
+    std::memcpy(staging_.coords, queries, sizeof(float) * nq * (size_t)D);
+
+    batch_topk_cpu(pts_, staging_, k, sq_norms_, metric, scratch_, out.keys.data());
+    return true;
+}
+
+const float* KnnDataset::arrange(const float* queries, size_t nq) {
+    if (dim_order_.empty()) return queries;
+    const int D = pts_.D;
+    permuted_.resize(nq * (size_t)D);
+    for (size_t q = 0; q < nq; q++) permute_query(queries + q * D, dim_order_, &permuted_[q * D]);
+    return permuted_.data();
+}
+
+const std::vector<uint32_t>& KnnDataset::reorder_dims() {
+    std::vector<uint32_t> order = dims_by_variance(pts_);
+    pts_.permute_dims(order);
+    // Composed with an earlier reordering, so queries stay in file order
+    if (!dim_order_.empty()) {
+        for (uint32_t& c : order) c = dim_order_[c];
+    }
+    dim_order_ = std::move(order);
+    sq_norms_.clear();
+    return dim_order_;
+}
+
+bool KnnDataset::search_abandon(const float* query, size_t k, MetricKind metric, SearchResult& out,
+                                PruneStats* stats) {
+    if (metric == MetricKind::Cosine && pts_.norms.size() != pts_.size()) compute_norms(pts_);
+    const float* q = arrange(query, 1);
+    ref_.assign(q, q + pts_.D);
+    out.nq = 1;
+    out.keys = topk_abandon_cpu(pts_, ref_, k, metric, stats);
+    out.k = out.keys.size();
+    return true;
+}
+
+std::vector<KeyIdx> KnnDataset::radius(const float* query, float radius, MetricKind metric, PruneStats* stats) {
+    if (metric == MetricKind::Cosine && pts_.norms.size() != pts_.size()) compute_norms(pts_);
+    const float* q = arrange(query, 1);
+    ref_.assign(q, q + pts_.D);
+    return radius_cpu(pts_, ref_, radius, metric, stats);
+}
+
+void KnnDataset::rank(const float* query, MetricKind metric, Backend backend, SortAlgo algo, size_t grain_size,
+                      RankStats* stats) {
+    using Clock = std::chrono::high_resolution_clock;
+    const float* q = arrange(query, 1);
+    ref_.assign(q, q + pts_.D);
+    if (backend == Backend::GPU) {
+        pts_.widen();
+        run_gpu_sort(pts_, ref_, metric);
+        return;
+    }
+
+    auto t0 = Clock::now();
+    compute_distances_cpu(pts_, ref_, metric);
+    auto t1 = Clock::now();
+    // Sorts 8-byte (dist, id) keys; the internal wrapper handles scratchpad and tasks
+    sort_points_cpu(pts_, algo, grain_size);
+    auto t2 = Clock::now();
+    if (stats) {
+        stats->distance_time = std::chrono::duration<double>(t1 - t0).count();
+        stats->sort_time = std::chrono::duration<double>(t2 - t1).count();
+    }
+}
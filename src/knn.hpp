@@ -0,0 +1,103 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "PointSet.hpp"
+#include "cpu_mergesort.hpp"
+#include "cpu_prune.hpp"
+#include "cpu_topk.hpp"
+#include "metrics.hpp"
+
+// libknn: library interface to the k-NN pipeline. The `sort` CLI is a client
+// of this API; applications link libknn.a / libknn.so instead of shelling
+// out and parsing text output.
+//
+//   KnnDataset ds;
+//   ds.load("points.kbin");
+//   SearchResult res;
+//   ds.search(queries, nq, 10, MetricKind::L2, Backend::CPU, res);
+//   const KeyIdx* nn = res.row(0);     // nn[j].idx, nn[j].dist
+//
+// A dataset handle keeps its derived state (row norms, query staging, top-k
+// heaps) and a SearchResult keeps its storage, so repeated CPU searches of
+// the same shape do not reallocate either. The GPU path and the abandon and
+// radius scans still allocate per call.
+
+enum class Backend { CPU, GPU };
+
+const char* backend_name(Backend b);
+bool parse_backend(const std::string& name, Backend& b);
+
+// Row-major nq x k neighbours, each row ascending by distance.
+struct SearchResult {
+    size_t nq = 0;
+    size_t k = 0;
+    std::vector<KeyIdx> keys;
+
+    const KeyIdx* row(size_t q) const { return keys.data() + q * k; }
+};
+
+// Time split of a full ranking
+struct RankStats {
+    double distance_time = 0.0;
+    double sort_time = 0.0;
+};
+
+class KnnDataset {
+public:
+    // Text or binary (.kbin) dataset; binary float32 files are mmapped. With
+    // keep_dtype, fp16/bf16 files are mmapped too and single-query CPU search
+    // reads them in their stored precision; other searches widen them first.
+    bool load(const std::string& path, bool keep_dtype = false);
+    // Copies N x D row-major floats from memory.
+    void assign(const float* rows, size_t N, int D);
+
+    size_t size() const { return pts_.size(); }
+    int dims() const { return pts_.D; }
+    const PointSet& points() const { return pts_; }
+    PointSet& points() { return pts_; }
+
+    // Precomputes what `metric` needs (cosine row norms, squared norms for
+    // batched l2/ip search) so the first search does not pay for it.
+    void prepare(MetricKind metric);
+
+    // Top-k (k <= N) of every query row; `queries` holds nq rows of dims()
+    // floats. CPU runs one fused pass for a single query and the cache-blocked
+    // batch kernel for several; GPU computes and sorts all distances per
+    // query. Always returns true.
+    bool search(const float* queries, size_t nq, size_t k, MetricKind metric, Backend backend, SearchResult& out);
+
+    // Single-query CPU top-k that drops l2/l1 rows once their partial
+    // distance passes the current k-th best; other metrics scan in full.
+    bool search_abandon(const float* query, size_t k, MetricKind metric, SearchResult& out,
+                        PruneStats* stats = nullptr);
+
+    // Every row within `radius` of the query (CPU), ascending.
+    std::vector<KeyIdx> radius(const float* query, float radius, MetricKind metric, PruneStats* stats = nullptr);
+
+    // Distance to the query for every row, then the whole dataset sorted by
+    // it; the ranking is left in points().dist / points().id. The CPU sorts
+    // with `algo` (grain_size 0 = default leaf size), the GPU on the device.
+    void rank(const float* query, MetricKind metric, Backend backend, SortAlgo algo, size_t grain_size = 0,
+              RankStats* stats = nullptr);
+
+    // Rewrites the columns by decreasing variance, so pruned scans cross
+    // their bound sooner. Queries passed to the calls above are permuted to
+    // match from then on; distances are unchanged. Returns the column order.
+    const std::vector<uint32_t>& reorder_dims();
+    const std::vector<uint32_t>& dim_order() const { return dim_order_; }
+
+private:
+    // The query rows in the dataset's column order
+    const float* arrange(const float* queries, size_t nq);
+
+    PointSet pts_;
+    std::vector<float> sq_norms_;   // squared row norms, filled on first batched search
+    PointSet staging_;              // query rows in aligned storage, grown on demand
+    size_t staging_capacity_ = 0;
+    TopKScratch scratch_;           // per-thread or per-slice heaps and query norms
+    std::vector<float> ref_;
+    std::vector<uint32_t> dim_order_;   // empty = stored order
+    std::vector<float> permuted_;
+};
@@ -0,0 +1,75 @@
+#include "knn_client.hpp"
+#include "knn_protocol.hpp"
+#include <iostream>
+
+static bool read_response(int fd, uint64_t id, ResponseHeader& h) {
+    if (!recv_all(fd, &h, sizeof(h)) || h.magic != kResponseMagic) {
+        std::cerr << "Connection to server lost\n";
+        return false;
+    }
+    if (h.id != id) {
+        std::cerr << "Response id " << h.id << " does not match request " << id << "\n";
+        return false;
+    }
+    if (h.status != STATUS_OK) {
+        std::cerr << "Server rejected request " << id << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool client_send_search(int fd, uint64_t id, const float* queries, uint32_t nq, int D, uint32_t k, MetricKind metric) {
+    RequestHeader req{kRequestMagic, OP_SEARCH, id, k, (uint32_t)metric, nq, (uint32_t)D};
+    if (!send_all(fd, &req, sizeof(req)) || !send_all(fd, queries, sizeof(float) * nq * (size_t)D)) {
+        std::cerr << "Connection to server lost\n";
+        return false;
+    }
+    return true;
+}
+
+bool client_recv_search(int fd, uint64_t id, std::vector<std::vector<KeyIdx>>& results) {
+    ResponseHeader h;
+    if (!read_response(fd, id, h)) return false;
+
+    std::vector<KeyIdx> flat((size_t)h.nq * h.k);
+    if (h.payload_bytes != sizeof(KeyIdx) * flat.size() || !recv_all(fd, flat.data(), h.payload_bytes)) {
+        std::cerr << "Malformed response\n";
+        return false;
+    }
+    results.resize(h.nq);
+    for (uint32_t q = 0; q < h.nq; q++) results[q].assign(flat.begin() + (size_t)q * h.k, flat.begin() + (size_t)(q + 1) * h.k);
+    return true;
+}
+
+bool client_search(int fd, uint64_t id, const float* queries, uint32_t nq, int D, uint32_t k, MetricKind metric,
+                   std::vector<std::vector<KeyIdx>>& results) {
+    return client_send_search(fd, id, queries, nq, D, k, metric) && client_recv_search(fd, id, results);
+}
+
+bool client_info(int fd, uint64_t& N, int& D) {
+    RequestHeader req{kRequestMagic, OP_INFO, 0, 0, 0, 0, 0};
+    ResponseHeader h;
+    DatasetInfo info;
+    if (!send_all(fd, &req, sizeof(req)) || !read_response(fd, 0, h)) return false;
+    if (h.payload_bytes != sizeof(info) || !recv_all(fd, &info, sizeof(info))) {
+        std::cerr << "Malformed response\n";
+        return false;
+    }
+    N = info.N;
+    D = (int)info.D;
+    return true;
+}
+
+bool client_stats(int fd, std::string& text) {
+    RequestHeader req{kRequestMagic, OP_STATS, 0, 0, 0, 0, 0};
+    ResponseHeader h;
+    if (!send_all(fd, &req, sizeof(req)) || !read_response(fd, 0, h)) return false;
+    text.resize(h.payload_bytes);
+    return recv_all(fd, &text[0], text.size());
+}
+
+bool client_shutdown(int fd) {
+    RequestHeader req{kRequestMagic, OP_SHUTDOWN, 0, 0, 0, 0, 0};
+    ResponseHeader h;
+    return send_all(fd, &req, sizeof(req)) && read_response(fd, 0, h);
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "PointSet.hpp"
+#include "metrics.hpp"
+
+// Client side of the k-NN daemon protocol (knn_protocol.hpp). Each call is
+// one request/response round trip on a connected socket.
+
+// Top-k for `nq` rows of dimension D starting at `queries`. False on a
+// transport error or if the server rejected the request.
+bool client_search(int fd, uint64_t id, const float* queries, uint32_t nq, int D, uint32_t k, MetricKind metric,
+                   std::vector<std::vector<KeyIdx>>& results);
+
+// The two halves of client_search, for callers that keep several requests
+// in flight (one per server) and collect the responses as they arrive.
+bool client_send_search(int fd, uint64_t id, const float* queries, uint32_t nq, int D, uint32_t k, MetricKind metric);
+bool client_recv_search(int fd, uint64_t id, std::vector<std::vector<KeyIdx>>& results);
+
+// Size and dimension of the served dataset.
+bool client_info(int fd, uint64_t& N, int& D);
+
+// Server-side batching and latency statistics as text.
+bool client_stats(int fd, std::string& text);
+
+// Asks the server to drain its queue and exit.
+bool client_shutdown(int fd);
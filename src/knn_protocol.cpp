@@ -0,0 +1,75 @@
+#include "knn_protocol.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+bool send_all(int fd, const void* data, size_t bytes) {
+    const char* p = static_cast<const char*>(data);
+    while (bytes > 0) {
+        ssize_t n = send(fd, p, bytes, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        bytes -= (size_t)n;
+    }
+    return true;
+}
+
+bool recv_all(int fd, void* data, size_t bytes) {
+    char* p = static_cast<char*>(data);
+    while (bytes > 0) {
+        ssize_t n = recv(fd, p, bytes, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        bytes -= (size_t)n;
+    }
+    return true;
+}
+
+static bool make_address(const std::string& path, sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path too long: " << path << "\n";
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+int listen_unix(const std::string& path) {
+    sockaddr_un addr;
+    if (!make_address(path, addr)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        std::cerr << "System Error: " << std::strerror(errno) << " (socket)" << std::endl;
+        return -1;
+    }
+    unlink(path.c_str());
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        std::cerr << "System Error: " << std::strerror(errno) << " (" << path << ")" << std::endl;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int connect_unix(const std::string& path) {
+    sockaddr_un addr;
+    if (!make_address(path, addr)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        std::cerr << "System Error: " << std::strerror(errno) << " (socket)" << std::endl;
+        return -1;
+    }
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        std::cerr << "System Error: " << std::strerror(errno) << " (" << path << ")" << std::endl;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Binary request protocol of the k-NN daemon over a Unix domain socket.
+// All fields are host byte order (client and server share the machine).
+//
+// Request:  [ RequestHeader ][ nq x D float32 queries ]
+// Response: [ ResponseHeader ][ nq x k { float32 dist; uint32 id } ]   (OP_SEARCH)
+//           [ ResponseHeader ][ payload_bytes of text ]                (OP_STATS)
+//           [ ResponseHeader ][ DatasetInfo ]                          (OP_INFO)
+// Keep one request in flight per connection: the server's workers may answer
+// pipelined requests out of order, and the client treats a response whose id
+// differs from the pending request as an error.
+
+static constexpr uint32_t kRequestMagic = 0x514e4e4b;   // "KNNQ"
+static constexpr uint32_t kResponseMagic = 0x524e4e4b;  // "KNNR"
+
+enum RequestOp : uint32_t {
+    OP_SEARCH = 0,
+    OP_STATS = 1,
+    OP_SHUTDOWN = 2,
+    OP_INFO = 3,
+};
+
+enum ResponseStatus : uint32_t {
+    STATUS_OK = 0,
+    STATUS_BAD_REQUEST = 1,
+};
+
+struct RequestHeader {
+    uint32_t magic;
+    uint32_t op;
+    uint64_t id;        // echoed in the response
+    uint32_t k;
+    uint32_t metric;    // MetricKind
+    uint32_t nq;
+    uint32_t D;
+};
+static_assert(sizeof(RequestHeader) == 32, "RequestHeader must stay 32 bytes");
+
+struct ResponseHeader {
+    uint32_t magic;
+    uint32_t status;
+    uint64_t id;
+    uint32_t nq;
+    uint32_t k;             // results per query (min(k, N))
+    uint64_t payload_bytes;
+};
+static_assert(sizeof(ResponseHeader) == 32, "ResponseHeader must stay 32 bytes");
+
+// Shape of the served dataset
+struct DatasetInfo {
+    uint64_t N;
+    uint32_t D;
+    uint32_t reserved;
+};
+static_assert(sizeof(DatasetInfo) == 16, "DatasetInfo must stay 16 bytes");
+
+// Full-length socket I/O; false on EOF or error.
+bool send_all(int fd, const void* data, size_t bytes);
+bool recv_all(int fd, void* data, size_t bytes);
+
+// Listening / connected AF_UNIX stream sockets; -1 on error (errno is printed).
+int listen_unix(const std::string& path);
+int connect_unix(const std::string& path);
@@ -0,0 +1,281 @@
+#include "knn_server.hpp"
+#include "knn_protocol.hpp"
+#include "latency_histogram.hpp"
+#include "cpu_batch.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <omp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr uint32_t kMaxQueriesPerRequest = 1u << 20;
+static volatile sig_atomic_t g_signalled = 0;
+
+static void on_signal(int) {
+    g_signalled = 1;
+}
+
+namespace {
+
+struct Connection {
+    int fd;
+    std::mutex write_lock;  // responses from different workers must not interleave
+
+    explicit Connection(int fd_) : fd(fd_) {}
+    ~Connection() { close(fd); }
+};
+
+struct Request {
+    std::shared_ptr<Connection> conn;
+    RequestHeader header;
+    std::vector<float> queries;
+    Clock::time_point arrived;
+};
+
+struct ServerState {
+    const PointSet& pts;
+    const ServerOptions& opts;
+    std::vector<float> sq_norms;    // computed once, shared by every batch
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Request> queue;
+    size_t queued_queries = 0;
+    std::atomic<bool> stopping{false};
+
+    std::mutex conn_mutex;
+    std::vector<std::weak_ptr<Connection>> connections;
+
+    LatencyHistogram latency;
+    std::atomic<uint64_t> batches{0};
+    std::atomic<uint64_t> batched_queries{0};
+
+    ServerState(const PointSet& p, const ServerOptions& o) : pts(p), opts(o) {}
+};
+
+std::string stats_text(const ServerState& st) {
+    std::ostringstream out;
+    uint64_t b = st.batches.load();
+    out << "Batches: " << b << ", mean batch: " << (b ? (double)st.batched_queries.load() / b : 0.0) << " queries\n";
+    st.latency.print(out, "Request Latency");
+    return out.str();
+}
+
+void respond(Connection& conn, const ResponseHeader& h, const void* payload) {
+    std::lock_guard<std::mutex> lock(conn.write_lock);
+    if (send_all(conn.fd, &h, sizeof(h)) && h.payload_bytes > 0) send_all(conn.fd, payload, h.payload_bytes);
+}
+
+void stop_server(ServerState& st) {
+    st.stopping = true;
+    st.ready.notify_all();
+}
+
+// One dataset pass for every query in the batch, then per-request replies
+void run_batch(ServerState& st, std::vector<Request>& batch) {
+    const int D = st.pts.D;
+    const MetricKind metric = (MetricKind)batch.front().header.metric;
+    size_t total = 0;
+    uint32_t kmax = 0;
+    for (const Request& r : batch) {
+        total += r.header.nq;
+        kmax = std::max(kmax, r.header.k);
+    }
+
+    PointSet queries;
+    queries.allocate(total, D);
+    size_t row = 0;
+    for (const Request& r : batch) {
+        std::memcpy(queries.row(row), r.queries.data(), sizeof(float) * r.queries.size());
+        row += r.header.nq;
+    }
+
+    std::vector<std::vector<KeyIdx>> results = batch_topk_cpu(st.pts, queries, kmax, st.sq_norms, metric);
+
+    row = 0;
+    std::vector<KeyIdx> payload;
+    for (const Request& r : batch) {
+        const uint32_t k = (uint32_t)std::min<size_t>(r.header.k, st.pts.size());
+        payload.resize((size_t)r.header.nq * k);
+        for (uint32_t q = 0; q < r.header.nq; q++) {
+            std::copy_n(results[row + q].begin(), k, payload.begin() + (size_t)q * k);
+        }
+        row += r.header.nq;
+
+        ResponseHeader h{kResponseMagic, STATUS_OK, r.header.id, r.header.nq, k, sizeof(KeyIdx) * payload.size()};
+        respond(*r.conn, h, payload.data());
+        st.latency.record(std::chrono::duration<double>(Clock::now() - r.arrived).count());
+    }
+    st.batches++;
+    st.batched_queries += total;
+}
+
+void worker_loop(ServerState& st, int omp_threads) {
+    omp_set_num_threads(omp_threads);
+    const auto linger = std::chrono::microseconds(st.opts.batch_wait_us);
+    std::vector<Request> batch;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(st.mutex);
+            st.ready.wait(lock, [&] { return st.stopping || !st.queue.empty(); });
+            if (st.queue.empty()) break;  // stopping and drained
+
+            // Give concurrent clients a moment to join this pass
+            if (st.queued_queries < st.opts.batch_max && linger.count() > 0 && !st.stopping) {
+                st.ready.wait_for(lock, linger, [&] { return st.stopping || st.queued_queries >= st.opts.batch_max; });
+            }
+            if (st.queue.empty()) continue;
+
+            const uint32_t metric = st.queue.front().header.metric;
+            size_t taken = 0;
+            for (auto it = st.queue.begin(); it != st.queue.end() && taken < st.opts.batch_max;) {
+                if (it->header.metric == metric) {
+                    taken += it->header.nq;
+                    batch.push_back(std::move(*it));
+                    it = st.queue.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            st.queued_queries -= taken;
+        }
+        run_batch(st, batch);
+        batch.clear();
+    }
+}
+
+// Reads requests off one connection until EOF or a malformed request
+void connection_loop(ServerState& st, const std::shared_ptr<Connection>& conn) {
+    RequestHeader h;
+    while (recv_all(conn->fd, &h, sizeof(h))) {
+        ResponseHeader bad{kResponseMagic, STATUS_BAD_REQUEST, h.id, 0, 0, 0};
+        if (h.magic != kRequestMagic) {
+            respond(*conn, bad, nullptr);
+            break;
+        }
+        if (h.op == OP_STATS) {
+            std::string text = stats_text(st);
+            ResponseHeader ok{kResponseMagic, STATUS_OK, h.id, 0, 0, text.size()};
+            respond(*conn, ok, text.data());
+            continue;
+        }
+        if (h.op == OP_INFO) {
+            DatasetInfo info{st.pts.size(), (uint32_t)st.pts.D, 0};
+            ResponseHeader ok{kResponseMagic, STATUS_OK, h.id, 0, 0, sizeof(info)};
+            respond(*conn, ok, &info);
+            continue;
+        }
+        if (h.op == OP_SHUTDOWN) {
+            ResponseHeader ok{kResponseMagic, STATUS_OK, h.id, 0, 0, 0};
+            respond(*conn, ok, nullptr);
+            stop_server(st);
+            break;
+        }
+        if (h.op != OP_SEARCH || h.D != (uint32_t)st.pts.D || h.nq == 0 || h.nq > kMaxQueriesPerRequest ||
+            h.k == 0 || h.metric > (uint32_t)MetricKind::L1) {
+            respond(*conn, bad, nullptr);
+            break;
+        }
+
+        Request r;
+        r.conn = conn;
+        r.header = h;
+        r.queries.resize((size_t)h.nq * h.D);
+        if (!recv_all(conn->fd, r.queries.data(), sizeof(float) * r.queries.size())) break;
+        r.arrived = Clock::now();
+        {
+            std::lock_guard<std::mutex> lock(st.mutex);
+            st.queued_queries += h.nq;
+            st.queue.push_back(std::move(r));
+        }
+        st.ready.notify_all();
+    }
+}
+
+} // namespace
+
+bool serve_knn(const PointSet& pts, const std::string& socket_path, const ServerOptions& opts) {
+    int listen_fd = listen_unix(socket_path);
+    if (listen_fd == -1) return false;
+
+    ServerState st(pts, opts);
+    st.sq_norms = compute_sq_norms(pts);
+
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    const int workers = std::max(1, opts.workers);
+    const int omp_threads = std::max(1, omp_get_max_threads() / workers);
+    std::vector<std::thread> pool;
+    for (int w = 0; w < workers; w++) pool.emplace_back(worker_loop, std::ref(st), omp_threads);
+
+    std::cout << "Listening on " << socket_path << ": N=" << pts.size() << ", D=" << pts.D << ", " << workers
+              << " workers x " << omp_threads << " threads, batch up to " << opts.batch_max << " queries\n"
+              << std::flush;
+
+    // Accept loop; polls so a signal or OP_SHUTDOWN is noticed promptly
+    struct Reader {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+    std::vector<Reader> readers;
+    while (!st.stopping && !g_signalled) {
+        pollfd pfd{listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) continue;
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd == -1) continue;
+        auto conn = std::make_shared<Connection>(fd);
+
+        // Join readers whose clients have gone, so their stacks are released
+        std::lock_guard<std::mutex> lock(st.conn_mutex);
+        readers.erase(std::remove_if(readers.begin(), readers.end(), [](Reader& r) {
+            if (!*r.done) return false;
+            r.thread.join();
+            return true;
+        }), readers.end());
+        st.connections.erase(std::remove_if(st.connections.begin(), st.connections.end(),
+                                            [](const std::weak_ptr<Connection>& w) { return w.expired(); }),
+                             st.connections.end());
+
+        st.connections.push_back(conn);
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        readers.push_back({std::thread([&st, conn, done] {
+            connection_loop(st, conn);
+            *done = true;
+        }), done});
+    }
+
+    // Drain: finish queued work, then unblock and join the readers
+    stop_server(st);
+    for (std::thread& t : pool) t.join();
+    {
+        std::lock_guard<std::mutex> lock(st.conn_mutex);
+        for (auto& weak : st.connections) {
+            if (auto conn = weak.lock()) shutdown(conn->fd, SHUT_RDWR);
+        }
+    }
+    for (Reader& r : readers) r.thread.join();
+    close(listen_fd);
+    unlink(socket_path.c_str());
+
+    std::cout << stats_text(st);
+    return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include "PointSet.hpp"
+
+// Long-running k-NN daemon: the dataset is loaded (or mmapped) once and
+// queries arrive over a Unix domain socket (see knn_protocol.hpp).
+// Requests are queued; a pool of workers drains the queue in batches of
+// compatible requests (same metric), so concurrent queries share one blocked
+// pass over the dataset through batch_topk_cpu. Each worker runs its batch
+// with an equal share of the OpenMP threads.
+struct ServerOptions {
+    int workers = 2;
+    size_t batch_max = 256;     // queries per dataset pass
+    int batch_wait_us = 500;    // how long a worker lingers for more requests
+};
+
+// Serves until a client sends OP_SHUTDOWN or the process gets SIGINT/SIGTERM,
+// then prints the request latency histogram. False if the socket cannot be
+// opened.
+bool serve_knn(const PointSet& pts, const std::string& socket_path, const ServerOptions& opts);
@@ -0,0 +1,92 @@
+#include "latency_histogram.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+void LatencyHistogram::reset() {
+    for (auto& b : buckets_) b.store(0, std::memory_order_relaxed);
+    count_.store(0, std::memory_order_relaxed);
+    sum_ns_.store(0, std::memory_order_relaxed);
+    max_ns_.store(0, std::memory_order_relaxed);
+}
+
+// Values below 2^kSubBits get exact buckets; above that, the leading bit
+// selects the range and the next kSubBits bits the sub-bucket.
+int LatencyHistogram::bucket_of(uint64_t ns) {
+    if (ns < (1u << kSubBits)) return (int)ns;
+    int e = 63 - __builtin_clzll(ns);
+    int sub = (int)((ns >> (e - kSubBits)) & ((1u << kSubBits) - 1));
+    return ((e - kSubBits + 1) << kSubBits) + sub;
+}
+
+uint64_t LatencyHistogram::bucket_upper(int b) {
+    if (b < (1 << kSubBits)) return (uint64_t)b;
+    int e = (b >> kSubBits) + kSubBits - 1;
+    uint64_t sub = b & ((1 << kSubBits) - 1);
+    uint64_t lower = ((1ull << kSubBits) + sub) << (e - kSubBits);
+    return lower + (1ull << (e - kSubBits)) - 1;
+}
+
+void LatencyHistogram::record(double seconds) {
+    uint64_t ns = (uint64_t)std::max(0.0, seconds * 1e9);
+    buckets_[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t prev = max_ns_.load(std::memory_order_relaxed);
+    while (ns > prev && !max_ns_.compare_exchange_weak(prev, ns, std::memory_order_relaxed)) {}
+}
+
+double LatencyHistogram::mean() const {
+    uint64_t n = count();
+    return n ? sum_ns_.load(std::memory_order_relaxed) * 1e-9 / n : 0.0;
+}
+
+double LatencyHistogram::max() const {
+    return max_ns_.load(std::memory_order_relaxed) * 1e-9;
+}
+
+double LatencyHistogram::percentile(double p) const {
+    uint64_t n = count();
+    if (n == 0) return 0.0;
+    uint64_t rank = (uint64_t)std::ceil(std::min(100.0, std::max(0.0, p)) / 100.0 * n);
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (int b = 0; b < kBuckets; b++) {
+        seen += buckets_[b].load(std::memory_order_relaxed);
+        if (seen >= rank) return std::min(bucket_upper(b), max_ns_.load(std::memory_order_relaxed)) * 1e-9;
+    }
+    return max();
+}
+
+void LatencyHistogram::print(std::ostream& out, const std::string& title) const {
+    out << "\n--- " << title << " (" << count() << " samples) ---\n";
+    if (count() == 0) return;
+    out << std::fixed << std::setprecision(3);
+    out << "mean " << mean() * 1e3 << " ms, p50 " << percentile(50) * 1e3 << " ms, p90 " << percentile(90) * 1e3
+        << " ms, p99 " << percentile(99) * 1e3 << " ms, p99.9 " << percentile(99.9) * 1e3 << " ms, max "
+        << max() * 1e3 << " ms\n";
+
+    // Collapse the sub-buckets to one row per power of two
+    uint64_t rows[64] = {0};
+    uint64_t peak = 0;
+    for (int b = 0; b < kBuckets; b++) {
+        uint64_t c = buckets_[b].load(std::memory_order_relaxed);
+        if (c == 0) continue;
+        uint64_t ub = bucket_upper(b);
+        int e = ub ? 63 - __builtin_clzll(ub) : 0;
+        rows[e] += c;
+        peak = std::max(peak, rows[e]);
+    }
+    for (int e = 0; e < 64; e++) {
+        if (rows[e] == 0) continue;
+        double lo = e ? (double)(1ull << e) * 1e-6 : 0.0;
+        double hi = (double)(2ull << e) * 1e-6;
+        int bar = (int)std::ceil(40.0 * rows[e] / peak);
+        out << "  [" << std::setw(10) << lo << ", " << std::setw(10) << hi << ") ms "
+            << std::setw(8) << rows[e] << " " << std::string(bar, '#') << "\n";
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Lock-free latency histogram with log-linear buckets: each power of two is
+// split into 8 sub-buckets, so any recorded value is resolved to within 12.5%.
+// Safe to record from many threads at once.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(double seconds);
+    void reset();
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    double mean() const;
+    double max() const;
+    // Upper bound of the bucket holding the p-th percentile (p in [0, 100]), in seconds
+    double percentile(double p) const;
+
+    // Summary line plus one row per populated power-of-two range
+    void print(std::ostream& out, const std::string& title) const;
+
+private:
+    static constexpr int kSubBits = 3;
+    static constexpr int kBuckets = (64 - kSubBits + 1) << kSubBits;
+
+    static int bucket_of(uint64_t ns);
+    static uint64_t bucket_upper(int b);
+
+    std::atomic<uint64_t> buckets_[kBuckets];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_ns_;
+    std::atomic<uint64_t> max_ns_;
+};
@@ -1,4 +1,9 @@
 #include "load_points.hpp"
+#include "binary_format.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <iostream>
 #include <vector>
 #include <omp.h>
@@ -7,81 +12,151 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <charconv> // For fast string-to-float conversion
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
-bool load_points(const std::string& filename, std::vector<Point>& points, int& D) {
-    int fd = open(filename.c_str(), O_RDONLY);
-    if (fd == -1) return false;
+static inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == ','; }
 
-    struct stat sb;
-    fstat(fd, &sb);
-    size_t length = sb.st_size;
+size_t count_newlines(const char* p, size_t n) {
+    size_t count = 0;
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i nl = _mm256_set1_epi8('\n');
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        count += __builtin_popcount((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl)));
+    }
+#elif defined(__SSE2__)
+    const __m128i nl = _mm_set1_epi8('\n');
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        count += __builtin_popcount((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)));
+    }
+#endif
+    for (; i < n; i++) count += (p[i] == '\n');
+    return count;
+}
 
-    char* addr = static_cast<char*>(mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0));
-    if (addr == MAP_FAILED) { close(fd); return false; }
+const char* parse_row(const char* curr, const char* end, float* row, int D) {
+    for (int j = 0; j < D; j++) {
+        while (curr < end && is_blank(*curr)) curr++;
+        if (curr < end && *curr == '+') curr++; // from_chars rejects a leading '+'
+        auto [next, ec] = std::from_chars(curr, end, row[j]);
+        if (ec != std::errc()) return nullptr;
+        curr = next;
+    }
+    // The row must end here: trailing blanks, then a newline or end of input
+    while (curr < end && is_blank(*curr)) curr++;
+    if (curr < end) {
+        if (*curr != '\n') return nullptr;
+        curr++;
+    }
+    return curr;
+}
+
+// Text path: one parallel pass to count rows per chunk, a prefix sum to place
+// each chunk, and one parallel pass to parse. Every row must have D columns.
+static bool load_points_text(const char* addr, size_t length, PointSet& points) {
+    TRACE_SCOPE("load.text");
+    // Ignore trailing whitespace so a final blank line is not taken as a row
+    while (length > 0 && (addr[length - 1] == '\n' || is_blank(addr[length - 1]))) length--;
+    if (length == 0) return false;
 
     // 1. Determine D from the first line
-    char* first_line_ptr = addr;
-    D = 0;
+    const char* first_end = static_cast<const char*>(memchr(addr, '\n', length));
+    if (!first_end) first_end = addr + length;
+    int D = 0;
     bool in_val = false;
-    while (*first_line_ptr != '\n' && first_line_ptr < addr + length) {
-        if (!isspace(*first_line_ptr)) {
+    for (const char* p = addr; p < first_end; p++) {
+        if (!is_blank(*p)) {
             if (!in_val) { D++; in_val = true; }
         } else {
             in_val = false;
         }
-        first_line_ptr++;
     }
+    if (D == 0) return false;
 
-    // 2. Determine exact N (Number of lines)
-    // Since lines = points, we count '\n' to be 100% accurate
-    size_t N = 0;
-    #pragma omp parallel for reduction(+:N)
-    for (size_t i = 0; i < length; i++) {
-        if (addr[i] == '\n') N++;
+    // 2. Split into line-aligned chunks (several per thread for balance)
+    int n_chunks = std::max(1, omp_get_max_threads() * 4);
+    std::vector<const char*> bounds(n_chunks + 1);
+    bounds[0] = addr;
+    bounds[n_chunks] = addr + length;
+    for (int c = 1; c < n_chunks; c++) {
+        const char* p = std::max(bounds[c - 1], addr + (length / n_chunks) * c);
+        const char* nl = static_cast<const char*>(memchr(p, '\n', addr + length - p));
+        bounds[c] = nl ? nl + 1 : addr + length;
     }
-    // Handle files that don't end in a newline
-    if (length > 0 && addr[length-1] != '\n') N++;
 
-    // 3. Resize and PRE-ALLOCATE (The fix for the Segfault)
-    points.resize(N, Point(D)); 
+    // 3. Count rows per chunk (SIMD newline scan), then exclusive prefix sum
+    std::vector<size_t> first_row(n_chunks + 1, 0);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < n_chunks; c++) {
+        first_row[c + 1] = count_newlines(bounds[c], bounds[c + 1] - bounds[c]);
+    }
+    // The last row has no newline (trailing ones were trimmed): credit it to the
+    // chunk that holds the final byte, since later chunks may be empty
+    for (int c = 0; c < n_chunks; c++) {
+        if (bounds[c + 1] == addr + length) { first_row[c + 1]++; break; }
+    }
+    for (int c = 0; c < n_chunks; c++) first_row[c + 1] += first_row[c];
+    const size_t N = first_row[n_chunks];
 
-    // 4. Parallel Parsing
-    #pragma omp parallel
+    // 4. Allocate one contiguous coordinate buffer; its pages are already placed
+    //    by the NUMA policy (partitioned first touch by default)
     {
-        int tid = omp_get_thread_num();
-        int n_threads = omp_get_num_threads();
-        size_t chunk_size = length / n_threads;
-        char* my_start = addr + (tid * chunk_size);
-        char* my_end = (tid == n_threads - 1) ? addr + length : addr + ((tid + 1) * chunk_size);
+        TRACE_SCOPE("load.allocate");
+        points.allocate(N, D);
+    }
 
-        // Align start to beginning of line
-        if (tid != 0) {
-            while (my_start < my_end && *(my_start - 1) != '\n') my_start++;
+    // 5. Parallel parse with validation
+    TRACE_SCOPE("load.parse");
+    std::atomic<size_t> bad_row{SIZE_MAX};
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < n_chunks; c++) {
+        const char* curr = bounds[c];
+        const char* end = bounds[c + 1];
+        for (size_t r = first_row[c]; r < first_row[c + 1]; r++) {
+            curr = parse_row(curr, end, points.row(r), D);
+            if (!curr) {
+                size_t prev = bad_row.load();
+                while (r < prev && !bad_row.compare_exchange_weak(prev, r)) {}
+                break;
+            }
         }
+    }
 
-        // Calculate which index in the GLOBAL vector this thread starts at
-        size_t global_idx = 0;
-        for (char* p = addr; p < my_start; p++) {
-            if (*p == '\n') global_idx++;
-        }
+    if (bad_row.load() != SIZE_MAX) {
+        std::cerr << "Parse error: row " << bad_row.load() + 1 << " does not have " << D << " numeric columns\n";
+        return false;
+    }
+    return true;
+}
 
-        char* curr = my_start;
-        size_t local_count = 0;
-        while (curr < my_end) {
-            if (global_idx + local_count >= N) break;
+bool load_points(const std::string& filename, PointSet& points, bool keep_dtype) {
+    TRACE_SCOPE("load_points");
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) return false;
 
-            char* next;
-            // Directly fill the pre-allocated vector
-            for (int i = 0; i < D; ++i) {
-                points[global_idx + local_count].coords[i] = std::strtof(curr, &next);
-                curr = next;
-            }
-            local_count++;
-            while (curr < my_end && (*curr == '\n' || *curr == '\r' || *curr == ' ')) curr++;
-        }
+    struct stat sb;
+    fstat(fd, &sb);
+    size_t length = sb.st_size;
+
+    // Writable but private: a zero-copy float32 PointSet points into this
+    // mapping, and any in-place write to its rows copies the page instead of
+    // faulting (the file itself is never modified)
+    char* addr = static_cast<char*>(mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0));
+    if (addr == MAP_FAILED) { close(fd); return false; }
+    close(fd); // The mapping stays valid after the descriptor is closed
+
+    // 0. Binary datasets need no parsing: float32 payloads are used in place
+    if (is_binary_dataset(addr, length)) {
+        TRACE_SCOPE("load.binary");
+        return load_points_binary(addr, length, points, keep_dtype) && !points.empty();
     }
 
+    madvise(addr, length, MADV_SEQUENTIAL);
+    bool ok = load_points_text(addr, length, points);
     munmap(addr, length);
-    close(fd);
-    return !points.empty();
+    return ok && !points.empty();
 }
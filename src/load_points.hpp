@@ -1,6 +1,17 @@
 #pragma once
 #include <vector>
 #include <string>
-#include "Point.hpp"
+#include "PointSet.hpp"
 
-bool load_points(const std::string& filename, std::vector<Point>& points, int& D);
+// Loads a text (one whitespace-separated row per line) or binary dataset.
+// Text rows are validated: every row must have the same number of columns.
+// Binary fp16/bf16 datasets are widened to float32 unless keep_dtype is set,
+// in which case they stay mapped in their stored precision (see PointSet).
+bool load_points(const std::string& filename, PointSet& points, bool keep_dtype = false);
+
+// SIMD count of '\n' bytes in [p, p + n).
+size_t count_newlines(const char* p, size_t n);
+
+// Parses one text row of exactly D values into `row`. Returns the start of the
+// next line, or nullptr if the row is malformed or has the wrong column count.
+const char* parse_row(const char* curr, const char* end, float* row, int D);
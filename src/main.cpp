@@ -5,89 +5,1486 @@
 #include <cstring>
 #include <chrono>
 #include <iomanip>
+#include <fstream>
+#include <cmath>
+#include <algorithm>
 #include <omp.h> 
+#include <sys/resource.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
 
-#include "Point.hpp"
+#include "PointSet.hpp"
 #include "load_points.hpp"
-#include "cpu_distance.hpp"
+#include "binary_format.hpp"
+#include "autotune.hpp"
+#include "distance_kernels.hpp"
+#include "metrics.hpp"
 #include "cpu_mergesort.hpp"
-#include <hip/hip_runtime.h>
-#include "gpu_hip.hpp"
+#include "stream_knn.hpp"
+#include "ivf_index.hpp"
+#include "hnsw_index.hpp"
+#include "quantizer.hpp"
+#include "projection.hpp"
+#include "knn_server.hpp"
+#include "knn_client.hpp"
+#include "shard_coordinator.hpp"
+#include "knn_protocol.hpp"
+#include "latency_histogram.hpp"
+#include "knn.hpp"
+#include "numa_placement.hpp"
+#include "trace.hpp"
 
-void print_timing(const std::string& operation, double seconds) {
-    std::cout << std::fixed << std::setprecision(6);
-    std::cout << operation << " Time: " << seconds * 1000.0 << " ms (" << seconds << " s)\n";
+void print_peak_rss() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    std::cout << "Peak RSS: " << ru.ru_maxrss / 1024.0 << " MB\n";
+}
+
+// One timed read of the point store, split per NUMA node of the reading threads
+void print_node_bandwidth(const PointSet& pts, ThreadBind bind) {
+    std::vector<NodeBandwidth> nodes = measure_node_bandwidth(pts.data(), pts.data_bytes());
+    std::streamsize precision = std::cout.precision();
+    std::cout << "\n--- Per-Node Read Bandwidth (" << numa_policy_name(current_numa_policy())
+              << ", threads " << thread_bind_name(bind) << ") ---\n";
+    for (const NodeBandwidth& n : nodes) {
+        if (n.threads == 0 && n.resident <= 0.0) continue;
+        std::cout << "Node " << n.node << ": " << std::setw(4) << n.threads << " threads, "
+                  << std::setprecision(2) << std::setw(10) << n.bytes / 1048576.0 << " MB, "
+                  << std::setw(8) << n.gbps() << " GB/s";
+        if (n.resident >= 0.0) std::cout << ", " << std::setprecision(1) << n.resident * 100.0 << "% of pages";
+        std::cout << "\n";
+    }
+    std::cout << std::setprecision(precision);
+}
+
+void print_prune_stats(const PruneStats& s) {
+    std::streamsize precision = std::cout.precision();
+    std::cout << "\n--- Pruning (early abandon) ---\n" << std::setprecision(1);
+    std::cout << "Rows abandoned: " << s.abandoned << " / " << s.rows << " (" << s.abandoned_fraction() * 100.0
+              << "%), rejected after a full read: " << s.rejected << "\n";
+    std::cout << "Coordinates read: " << s.coords << " / " << s.coords_total << " ("
+              << (1.0 - s.skipped_fraction()) * 100.0 << "%, " << (s.rows ? (double)s.coords / s.rows : 0.0)
+              << " per row)\n";
+    std::cout << std::setprecision(precision);
+}
+
+// Radius hits can be most of the dataset: list the nearest few
+void print_radius_hits(const std::vector<KeyIdx>& hits, float radius) {
+    const size_t kListed = 20;
+    std::cout << "\n--- Within Radius " << radius << ": " << hits.size() << " rows ---\n";
+    for (size_t i = 0; i < std::min(kListed, hits.size()); i++) {
+        std::cout << std::setw(6) << i + 1 << ": id=" << hits[i].idx << " dist=" << hits[i].dist << "\n";
+    }
+    if (hits.size() > kListed) std::cout << "   ... " << hits.size() - kListed << " more\n";
+}
+
+std::vector<float> parse_ref(const char* ref_arg, int D) {
+    std::vector<float> ref(D, 0.0f);
+    if (ref_arg) {
+        std::stringstream ss(ref_arg);
+        std::string tok;
+        int idx = 0;
+        while (std::getline(ss, tok, ',') && idx < D) {
+            ref[idx++] = std::stof(tok);
+        }
+    }
+    return ref;
+}
+
+void print_neighbours(const KeyIdx* nn, size_t k) {
+    std::cout << "\n--- Nearest Neighbours (k=" << k << ") ---\n";
+    for (size_t i = 0; i < k; i++) {
+        std::cout << std::setw(6) << i + 1 << ": id=" << nn[i].idx << " dist=" << nn[i].dist << "\n";
+    }
+}
+
+void print_neighbours(const std::vector<KeyIdx>& nn) {
+    print_neighbours(nn.data(), nn.size());
+}
+
+// Query rows for the index subcommands: the --queries file, or the single ref point
+bool load_query_set(const char* query_path, const char* ref_arg, int D, PointSet& queries) {
+    if (!query_path) {
+        queries.allocate(1, D);
+        std::vector<float> ref = parse_ref(ref_arg, D);
+        std::copy(ref.begin(), ref.end(), queries.row(0));
+        return true;
+    }
+    if (!load_points(query_path, queries)) {
+        std::cerr << "Could not load query file\n";
+        return false;
+    }
+    if (queries.D != D) {
+        std::cerr << "Query dimension " << queries.D << " does not match dataset dimension " << D << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Ground truth for recall reporting: the dataset's exact CPU search
+std::vector<std::vector<KeyIdx>> exact_topk(KnnDataset& ds, const PointSet& queries, size_t k, MetricKind metric) {
+    SearchResult res;
+    ds.search(queries.coords, queries.size(), k, metric, Backend::CPU, res);
+    std::vector<std::vector<KeyIdx>> out(res.nq);
+    for (size_t q = 0; q < res.nq; q++) out[q].assign(res.row(q), res.row(q) + res.k);
+    return out;
+}
+
+// Per-query results as "q: id:dist ...", to `out_path` or stdout
+bool write_results(const std::vector<std::vector<KeyIdx>>& results, const char* out_path) {
+    std::ofstream file;
+    if (out_path) {
+        file.open(out_path);
+        if (!file) {
+            std::cerr << "Could not open output file " << out_path << "\n";
+            return false;
+        }
+    }
+    std::ostream& out = out_path ? file : std::cout;
+    if (!out_path) std::cout << "\n--- Nearest Neighbours (id:dist per query) ---\n";
+    out << std::setprecision(6);
+    for (size_t q = 0; q < results.size(); q++) {
+        out << q << ":";
+        for (const KeyIdx& nn : results[q]) out << " " << nn.idx << ":" << nn.dist;
+        out << "\n";
+    }
+    return true;
+}
+
+// Query-file mode: top-k for every row of `query_path`, written to `out_path` (or stdout)
+int run_batch_mode(KnnDataset& ds, const char* query_path, size_t k, MetricKind metric,
+                   const char* out_path, double load_time) {
+    const PointSet& pts = ds.points();
+    PointSet queries;
+    auto t_q_start = std::chrono::high_resolution_clock::now();
+    if (!load_points(query_path, queries)) {
+        std::cerr << "Could not load query file\n";
+        return 1;
+    }
+    auto t_q_end = std::chrono::high_resolution_clock::now();
+    double query_load_time = std::chrono::duration<double>(t_q_end - t_q_start).count();
+
+    if (queries.D != pts.D) {
+        std::cerr << "Query dimension " << queries.D << " does not match dataset dimension " << pts.D << "\n";
+        return 1;
+    }
+
+    std::cout << "\n--- Running CPU Batched k-NN (" << omp_get_max_threads() << " threads) ---\n";
+    std::cout << "N=" << pts.size() << ", D=" << pts.D << ", Q=" << queries.size() << ", k=" << k
+              << ", metric=" << metric_name(metric) << "\n";
+
+    auto t1_start = std::chrono::high_resolution_clock::now();
+    SearchResult res;
+    ds.search(queries.coords, queries.size(), k, metric, Backend::CPU, res);
+    auto t1_end = std::chrono::high_resolution_clock::now();
+    double batch_time = std::chrono::duration<double>(t1_end - t1_start).count();
+
+    std::cout << "\n--- Detailed Operation Times ---\n";
+    print_timing("Data Loading (mmap)", load_time);
+    print_timing("Query Loading", query_load_time);
+    print_timing("Batched Distance + Top-k", batch_time);
+    std::cout << "------------------------------------\n";
+    print_timing("Total Pipeline Time", load_time + query_load_time + batch_time);
+    print_peak_rss();
+    double flops = 2.0 * pts.size() * pts.D * queries.size();
+    std::cout << "Throughput: " << queries.size() / batch_time << " queries/s, "
+              << flops / batch_time * 1e-9 << " GFLOP/s\n";
+
+    std::vector<std::vector<KeyIdx>> results(res.nq);
+    for (size_t q = 0; q < res.nq; q++) results[q].assign(res.row(q), res.row(q) + res.k);
+    return write_results(results, out_path) ? 0 : 1;
+}
+
+// Streaming mode: the dataset is never fully resident
+int run_stream_mode(const char* path, const char* ref_arg, size_t k, MetricKind metric, size_t mem_budget) {
+    StreamingDataset ds;
+    if (!ds.open(path)) {
+        std::cerr << "Could not open dataset\n";
+        return 1;
+    }
+    std::vector<float> ref = parse_ref(ref_arg, ds.dims());
+
+    std::cout << "\n--- Running CPU Streaming k-NN (" << omp_get_max_threads() << " threads) ---\n";
+    std::cout << "D=" << ds.dims() << ", k=" << k << ", metric=" << metric_name(metric) << ", budget=" << mem_budget / (1024 * 1024) << " MB\n";
+
+    StreamStats stats;
+    std::vector<KeyIdx> nn;
+    auto t_start = std::chrono::high_resolution_clock::now();
+    if (!ds.topk(ref, k, mem_budget, nn, stats, metric)) {
+        std::cerr << "Streaming search failed\n";
+        return 1;
+    }
+    auto t_end = std::chrono::high_resolution_clock::now();
+    double total_time = std::chrono::duration<double>(t_end - t_start).count();
+
+    std::cout << "N=" << stats.rows << " in " << stats.chunks << " chunks of up to " << stats.chunk_rows << " rows\n";
+    std::cout << "\n--- Detailed Operation Times ---\n";
+    print_timing("Chunk Loading (overlapped)", stats.load_time);
+    print_timing("Distance + Top-k Selection", stats.compute_time);
+    std::cout << "------------------------------------\n";
+    print_timing("Total Pipeline Time", total_time);
+    print_peak_rss();
+
+    print_neighbours(nn);
+    std::cout << "\n--- Result Check ---\n";
+    if (!nn.empty()) {
+        std::cout << "Closest Distance: " << nn.front().dist << "\n";
+        std::cout << "k-th Distance: " << nn.back().dist << "\n";
+    }
+    return 0;
+}
+
+// build-index: train IVF centroids over the dataset and write the index file
+int run_build_index(int argc, char** argv) {
+    if (argc < 4) {
+        std::cout << "Usage: " << argv[0] << " build-index datafile index_file [--nlist N] [--iters I] [--seed S]\n";
+        return 1;
+    }
+    const char* path = argv[2];
+    const char* index_path = argv[3];
+    uint32_t nlist = 0; // 0 = sqrt(N)
+    int iters = 10;
+    uint64_t seed = 42;
+    for (int a = 4; a < argc; a++) {
+        if (strcmp(argv[a], "--nlist") == 0 && a + 1 < argc) {
+            nlist = std::stoul(argv[++a]);
+        } else if (strcmp(argv[a], "--iters") == 0 && a + 1 < argc) {
+            iters = std::stoi(argv[++a]);
+        } else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc) {
+            seed = std::stoull(argv[++a]);
+        } else {
+            std::cerr << "Unknown option: " << argv[a] << "\n";
+            return 1;
+        }
+    }
+
+    KnnDataset ds;
+    auto t_load_start = std::chrono::high_resolution_clock::now();
+    if (!ds.load(path)) {
+        std::cerr << "Could not load dataset\n";
+        return 1;
+    }
+    PointSet& pts = ds.points();
+    auto t_load_end = std::chrono::high_resolution_clock::now();
+    double load_time = std::chrono::duration<double>(t_load_end - t_load_start).count();
+    if (nlist == 0) nlist = std::max<uint32_t>(1, (uint32_t)std::sqrt((double)pts.size()));
+
+    std::cout << "\n--- Building IVF Index (" << omp_get_max_threads() << " threads) ---\n";
+    std::cout << "N=" << pts.size() << ", D=" << pts.D << ", nlist=" << nlist << ", iters=" << iters << "\n";
+
+    IvfBuildStats stats;
+    auto t_build_start = std::chrono::high_resolution_clock::now();
+    if (!IvfIndex::build(pts, nlist, iters, seed, index_path, stats)) {
+        std::cerr << "Index build failed\n";
+        return 1;
+    }
+    auto t_build_end = std::chrono::high_resolution_clock::now();
+    double build_time = std::chrono::duration<double>(t_build_end - t_build_start).count();
+
+    std::cout << "Trained on " << stats.train_rows << " rows, " << stats.iterations << " iterations\n";
+    std::cout << "Largest list: " << stats.largest_list << " rows, empty lists: " << stats.empty_lists << "\n";
+    std::cout << "\n--- Detailed Operation Times ---\n";
+    print_timing("Data Loading (mmap)", load_time);
+    print_timing("k-means Training", stats.train_time);
+    print_timing("Assignment + Posting Lists", stats.assign_time);
+    std::cout << "------------------------------------\n";
+    print_timing("Total Build", load_time + build_time);
+    print_peak_rss();
+    return 0;
+}
+
+// query: approximate top-k through an IVF index, checked against the exact scan
+int run_query(int argc, char** argv) {
+    if (argc < 4) {
+        std::cout << "Usage: " << argv[0] << " query datafile index_file [ref_point] [--nprobe P] [--k N]"
+                  << " [--metric l2|ip|cosine|l1] [--queries file]\n";
+        return 1;
+    }
+    const char* path = argv[2];
+    const char* index_path = argv[3];
+    const char* ref_arg = nullptr;
+    const char* query_path = nullptr;
+    uint32_t nprobe = 8;
+    size_t k = 10;
+    MetricKind metric = MetricKind::L2;
+    for (int a = 4; a < argc; a++) {
+        if (strcmp(argv[a], "--nprobe") == 0 && a + 1 < argc) {
+            nprobe = std::stoul(argv[++a]);
+        } else if (strcmp(argv[a], "--k") == 0 && a + 1 < argc) {
+            k = std::stoul(argv[++a]);
+        } else if (strcmp(argv[a], "--queries") == 0 && a + 1 < argc) {
+            query_path = argv[++a];
+        } else if (strcmp(argv[a], "--metric") == 0 && a + 1 < argc) {
+            if (!parse_metric(argv[++a], metric)) {
+                std::cerr << "Unknown metric: " << argv[a] << "\n";
+                return 1;
+            }
+        } else if (argv[a][0] != '-' || isdigit(argv[a][1]) || argv[a][1] == '.') {
+            ref_arg = argv[a];
+        } else {
+            std::cerr << "Unknown option: " << argv[a] << "\n";
+            return 1;
+        }
+    }
+
+    KnnDataset ds;
+    auto t_load_start = std::chrono::high_resolution_clock::now();
+    if (!ds.load(path)) {
+        std::cerr << "Could not load dataset\n";
+        return 1;
+    }
+    PointSet& pts = ds.points();
+    if (metric == MetricKind::Cosine) ds.prepare(metric);
+    IvfIndex index;
+    if (!index.open(index_path)) {
+        std::cerr << "Could not open index " << index_path << "\n";
+        return 1;
+    }
+    auto t_load_end = std::chrono::high_resolution_clock::now();
+    double load_time = std::chrono::duration<double>(t_load_end - t_load_start).count();
+
+    if (index.size() != pts.size() || index.dims() != pts.D) {
+        std::cerr << "Index (N=" << index.size() << ", D=" << index.dims() << ") was not built from this dataset\n";
+        return 1;
+    }
+
+    PointSet queries;
+    if (!load_query_set(query_path, ref_arg, pts.D, queries)) return 1;
+
+    std::cout << "\n--- Running IVF Query (" << omp_get_max_threads() << " threads) ---\n";
+    std::cout << "N=" << pts.size() << ", D=" << pts.D << ", Q=" << queries.size() << ", k=" << k
+              << ", metric=" << metric_name(metric) << ", nlist=" << index.nlist() << ", nprobe=" << nprobe << "\n";
+
+    // --- 1. Approximate search ---
+    size_t scanned = 0;
+    std::vector<std::vector<KeyIdx>> approx;
+    auto t1_start = std::chrono::high_resolution_clock::now();
+    if (queries.size() == 1) {
+        approx.push_back(index.search(pts, queries.row(0), k, nprobe, metric, &scanned));
+    } else {
+        approx = index.search_batch(pts, queries, k, nprobe, metric, &scanned);
+    }
+    auto t1_end = std::chrono::high_resolution_clock::now();
+    double ivf_time = std::chrono::duration<double>(t1_end - t1_start).count();
+
+    // --- 2. Exact oracle ---
+    std::vector<std::vector<KeyIdx>> exact;
+    auto t2_start = std::chrono::high_resolution_clock::now();
+    exact = exact_topk(ds, queries, k, metric);
+    auto t2_end = std::chrono::high_resolution_clock::now();
+    double exact_time = std::chrono::duration<double>(t2_end - t2_start).count();
+
+    std::cout << "\n--- Detailed Operation Times ---\n";
+    print_timing("Data + Index Loading (mmap)", load_time);
+    print_timing("IVF Search", ivf_time);
+    print_timing("Exact Search", exact_time);
+    std::cout << "------------------------------------\n";
+    print_peak_rss();
+    std::cout << "Rows scanned: " << std::setprecision(2)
+              << 100.0 * scanned / ((double)pts.size() * queries.size()) << "% of exact\n";
+    std::cout << "Speedup: " << exact_time / ivf_time << "x\n";
+    std::cout << std::setprecision(4) << "Recall@" << k << ": " << recall_at_k(approx, exact) << "\n";
+
+    if (queries.size() == 1) print_neighbours(approx[0]);
+    return 0;
+}
+
+// build-hnsw: parallel HNSW graph construction, written to an index file
+int run_build_hnsw(int argc, char** argv) {
+    if (argc < 4) {
+        std::cout << "Usage: " << argv[0] << " build-hnsw datafile index_file [--M M] [--ef-construction EF]"
+                  << " [--metric l2|ip|cosine|l1] [--seed S]\n";
+        return 1;
+    }
+    const char* path = argv[2];
+    const char* index_path = argv[3];
+    uint32_t M = 16;
+    uint32_t ef_construction = 200;
+    uint64_t seed = 42;
+    MetricKind metric = MetricKind::L2;
+    for (int a = 4; a < argc; a++) {
+        if (strcmp(argv[a], "--M") == 0 && a + 1 < argc) {
+            M = std::stoul(argv[++a]);
+        } else if (strcmp(argv[a], "--ef-construction") == 0 && a + 1 < argc) {
+            ef_construction = std::stoul(argv[++a]);
+        } else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc) {
+            seed = std::stoull(argv[++a]);
+        } else if (strcmp(argv[a], "--metric") == 0 && a + 1 < argc) {
+            if (!parse_metric(argv[++a], metric)) {
+                std::cerr << "Unknown metric: " << argv[a] << "\n";
+                return 1;
+            }
+        } else {
+            std::cerr << "Unknown option: " << argv[a] << "\n";
+            return 1;
+        }
+    }
+
+    KnnDataset ds;
+    auto t_load_start = std::chrono::high_resolution_clock::now();
+    if (!ds.load(path)) {
+        std::cerr << "Could not load dataset\n";
+        return 1;
+    }
+    PointSet& pts = ds.points();
+    auto t_load_end = std::chrono::high_resolution_clock::now();
+    double load_time = std::chrono::duration<double>(t_load_end - t_load_start).count();
+
+    std::cout << "\n--- Building HNSW Index (" << omp_get_max_threads() << " threads) ---\n";
+    std::cout << "N=" << pts.size() << ", D=" << pts.D << ", M=" << M << ", ef_construction=" << ef_construction
+              << ", metric=" << metric_name(metric) << "\n";
+
+    HnswBuildStats stats;
+    if (!HnswIndex::build(pts, M, ef_construction, metric, seed, index_path, stats)) {
+        std::cerr << "Index build failed\n";
+        return 1;
+    }
+
+    std::cout << "Levels: " << stats.max_level + 1 << ", mean level-0 degree: " << std::setprecision(2)
+              << stats.mean_degree << "\n";
+    std::cout << "\n--- Detailed Operation Times ---\n";
+    print_timing("Data Loading (mmap)", load_time);
+    print_timing("Graph Construction", stats.build_time);
+    std::cout << "------------------------------------\n";
+    print_timing("Total Build", load_time + stats.build_time);
+    print_peak_rss();
+    return 0;
+}
+
+// query-hnsw: single-query latency through the graph, checked against the exact scan
+int run_query_hnsw(int argc, char** argv) {
+    if (argc < 4) {
+        std::cout << "Usage: " << argv[0] << " query-hnsw datafile index_file [ref_point] [--ef EF] [--k N] [--queries file]\n";
+        return 1;
+    }
+    const char* path = argv[2];
+    const char* index_path = argv[3];
+    const char* ref_arg = nullptr;
+    const char* query_path = nullptr;
+    uint32_t ef = 64;
+    size_t k = 10;
+    for (int a = 4; a < argc; a++) {
+        if (strcmp(argv[a], "--ef") == 0 && a + 1 < argc) {
+            ef = std::stoul(argv[++a]);
+        } else if (strcmp(argv[a], "--k") == 0 && a + 1 < argc) {
+            k = std::stoul(argv[++a]);
+        } else if (strcmp(argv[a], "--queries") == 0 && a + 1 < argc) {
+            query_path = argv[++a];
+        } else if (argv[a][0] != '-' || isdigit(argv[a][1]) || argv[a][1] == '.') {
+            ref_arg = argv[a];
+        } else {
+            std::cerr << "Unknown option: " << argv[a] << "\n";
+            return 1;
+        }
+    }
+
+    KnnDataset ds;
+    HnswIndex index;
+    auto t_load_start = std::chrono::high_resolution_clock::now();
+    if (!ds.load(path)) {
+        std::cerr << "Could not load dataset\n";
+        return 1;
+    }
+    PointSet& pts = ds.points();
+    if (!index.open(index_path)) {
+        std::cerr << "Could not open index " << index_path << "\n";
+        return 1;
+    }
+    if (index.metric() == MetricKind::Cosine) ds.prepare(MetricKind::Cosine);
+    auto t_load_end = std::chrono::high_resolution_clock::now();
+    double load_time = std::chrono::duration<double>(t_load_end - t_load_start).count();
+
+    if (index.size() != pts.size() || index.dims() != pts.D) {
+        std::cerr << "Index (N=" << index.size() << ", D=" << index.dims() << ") was not built from this dataset\n";
+        return 1;
+    }
+
+    PointSet queries;
+    if (!load_query_set(query_path, ref_arg, pts.D, queries)) return 1;
+    const MetricKind metric = index.metric();
+
+    std::cout << "\n--- Running HNSW Query ---\n";
+    std::cout << "N=" << pts.size() << ", D=" << pts.D << ", Q=" << queries.size() << ", k=" << k
+              << ", metric=" << metric_name(metric) << ", M=" << index.M() << ", ef=" << ef << "\n";
+
+    // --- 1. Graph search, one query at a time ---
+    std::vector<std::vector<KeyIdx>> approx(queries.size());
+    std::vector<double> latency(queries.size());
+    size_t evals = 0;
+    for (size_t q = 0; q < queries.size(); q++) {
+        size_t n = 0;
+        auto t_start = std::chrono::high_resolution_clock::now();
+        approx[q] = index.search(pts, queries.row(q), k, ef, &n);
+        auto t_end = std::chrono::high_resolution_clock::now();
+        latency[q] = std::chrono::duration<double>(t_end - t_start).count();
+        evals += n;
+    }
+
+    // --- 2. Exact oracle ---
+    auto t2_start = std::chrono::high_resolution_clock::now();
+    std::vector<std::vector<KeyIdx>> exact = exact_topk(ds, queries, k, metric);
+    auto t2_end = std::chrono::high_resolution_clock::now();
+    double exact_time = std::chrono::duration<double>(t2_end - t2_start).count();
+
+    std::vector<double> sorted_latency = latency;
+    std::sort(sorted_latency.begin(), sorted_latency.end());
+    double total = 0.0;
+    for (double l : latency) total += l;
+
+    std::cout << "\n--- Detailed Operation Times ---\n";
+    print_timing("Data + Index Loading (mmap)", load_time);
+    print_timing("HNSW Query p50", sorted_latency[sorted_latency.size() / 2]);
+    print_timing("HNSW Query p99", sorted_latency[(sorted_latency.size() * 99) / 100]);
+    print_timing("Exact Search (all queries)", exact_time);
+    std::cout << "------------------------------------\n";
+    print_peak_rss();
+    std::cout << "Distance evaluations per query: " << evals / queries.size() << " of " << pts.size() << "\n";
+    std::cout << "Speedup: " << std::setprecision(2) << exact_time / total << "x\n";
+    std::cout << std::setprecision(4) << "Recall@" << k << ": " << recall_at_k(approx, exact) << "\n";
+
+    if (queries.size() == 1) print_neighbours(approx[0]);
+    return 0;
+}
+
+// build-quant: train sq8 / pq codes for the dataset and write the codes file
+int run_build_quant(int argc, char** argv) {
+    if (argc < 4) {
+        std::cout << "Usage: " << argv[0] << " build-quant datafile codes_file [--type sq8|pq] [--pq-m M] [--iters I] [--seed S]\n";
+        return 1;
+    }
+    const char* path = argv[2];
+    const char* codes_path = argv[3];
+    QuantType type = QuantType::SQ8;
+    uint32_t pq_m = 0; // 0 = D / 8
+    int iters = 10;
+    uint64_t seed = 42;
+    for (int a = 4; a < argc; a++) {
+        if (strcmp(argv[a], "--type") == 0 && a + 1 < argc) {
+            if (!parse_quant_type(argv[++a], type)) {
+                std::cerr << "Unknown quantizer: " << argv[a] << "\n";
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--pq-m") == 0 && a + 1 < argc) {
+            pq_m = std::stoul(argv[++a]);
+        } else if (strcmp(argv[a], "--iters") == 0 && a + 1 < argc) {
+            iters = std::stoi(argv[++a]);
+        } else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc) {
+            seed = std::stoull(argv[++a]);
+        } else {
+            std::cerr << "Unknown option: " << argv[a] << "\n";
+            return 1;
+        }
+    }
+
+    KnnDataset ds;
+    auto t_load_start = std::chrono::high_resolution_clock::now();
+    if (!ds.load(path)) {
+        std::cerr << "Could not load dataset\n";
+        return 1;
+    }
+    PointSet& pts = ds.points();
+    auto t_load_end = std::chrono::high_resolution_clock::now();
+    double load_time = std::chrono::duration<double>(t_load_end - t_load_start).count();
+    if (pq_m == 0) pq_m = std::max(1, pts.D / 8);
+
+    std::cout << "\n--- Building " << quant_type_name(type) << " Codes (" << omp_get_max_threads() << " threads) ---\n";
+    std::cout << "N=" << pts.size() << ", D=" << pts.D;
+    if (type == QuantType::PQ) std::cout << ", m=" << pq_m << ", iters=" << iters;
+    std::cout << "\n";
+
+    QuantBuildStats stats;
+    if (!QuantizedCodes::build(pts, type, pq_m, iters, seed, codes_path, stats)) {
+        std::cerr << "Quantizer build failed\n";
+        return 1;
+    }
+    size_t code_size = type == QuantType::PQ ? pq_m : (size_t)pts.D;
+    std::cout << "Code size: " << code_size << " bytes/row (" << std::fixed << std::setprecision(1)
+              << 4.0 * pts.D / code_size << "x smaller than float32)\n";
+
+    std::cout << "\n--- Detailed Operation Times ---\n";
+    print_timing("Data Loading (mmap)", load_time);
+    print_timing("Quantizer Training", stats.train_time);
+    if (type == QuantType::PQ) print_timing("Encoding", stats.encode_time);
+    std::cout << "------------------------------------\n";
+    print_timing("Total Build", load_time + stats.train_time + stats.encode_time);
+    print_peak_rss();
+    return 0;
+}
+
+// query-quant: code-space scan + exact re-rank, checked against the exact scan
+int run_query_quant(int argc, char** argv) {
+    if (argc < 4) {
+        std::cout << "Usage: " << argv[0] << " query-quant datafile codes_file [ref_point] [--k N] [--rerank R]"
+                  << " [--metric l2|ip|cosine|l1] [--queries file]\n";
+        return 1;
+    }
+    const char* path = argv[2];
+    const char* codes_path = argv[3];
+    const char* ref_arg = nullptr;
+    const char* query_path = nullptr;
+    size_t k = 10;
+    size_t rerank = 0; // 0 = 10 * k
+    MetricKind metric = MetricKind::L2;
+    for (int a = 4; a < argc; a++) {
+        if (strcmp(argv[a], "--k") == 0 && a + 1 < argc) {
+            k = std::stoul(argv[++a]);
+        } else if (strcmp(argv[a], "--rerank") == 0 && a + 1 < argc) {
+            rerank = std::stoul(argv[++a]);
+        } else if (strcmp(argv[a], "--queries") == 0 && a + 1 < argc) {
+            query_path = argv[++a];
+        } else if (strcmp(argv[a], "--metric") == 0 && a + 1 < argc) {
+            if (!parse_metric(argv[++a], metric)) {
+                std::cerr << "Unknown metric: " << argv[a] << "\n";
+                return 1;
+            }
+        } else if (argv[a][0] != '-' || isdigit(argv[a][1]) || argv[a][1] == '.') {
+            ref_arg = argv[a];
+        } else {
+            std::cerr << "Unknown option: " << argv[a] << "\n";
+            return 1;
+        }
+    }
+    if (rerank == 0) rerank = 10 * k;
+
+    KnnDataset ds;
+    QuantizedCodes codes;
+    auto t_load_start = std::chrono::high_resolution_clock::now();
+    if (!ds.load(path)) {
+        std::cerr << "Could not load dataset\n";
+        return 1;
+    }
+    PointSet& pts = ds.points();
+    if (!codes.open(codes_path)) {
+        std::cerr << "Could not open codes " << codes_path << "\n";
+        return 1;
+    }
+    if (metric == MetricKind::Cosine) ds.prepare(metric);
+    auto t_load_end = std::chrono::high_resolution_clock::now();
+    double load_time = std::chrono::duration<double>(t_load_end - t_load_start).count();
+
+    if (codes.size() != pts.size() || codes.dims() != pts.D) {
+        std::cerr << "Codes (N=" << codes.size() << ", D=" << codes.dims() << ") were not built from this dataset\n";
+        return 1;
+    }
+
+    PointSet queries;
+    if (!load_query_set(query_path, ref_arg, pts.D, queries)) return 1;
+
+    std::cout << "\n--- Running Quantized Query (" << omp_get_max_threads() << " threads) ---\n";
+    std::cout << "N=" << pts.size() << ", D=" << pts.D << ", Q=" << queries.size() << ", k=" << k
+              << ", metric=" << metric_name(metric) << ", codes=" << quant_type_name(codes.type())
+              << ", rerank=" << rerank << "\n";
+
+    // --- 1. Code-space scan + exact re-rank ---
+    std::vector<std::vector<KeyIdx>> approx;
+    auto t1_start = std::chrono::high_resolution_clock::now();
+    if (queries.size() == 1) {
+        approx.push_back(codes.search(pts, queries.row(0), k, rerank, metric));
+    } else {
+        approx = codes.search_batch(pts, queries, k, rerank, metric);
+    }
+    auto t1_end = std::chrono::high_resolution_clock::now();
+    double quant_time = std::chrono::duration<double>(t1_end - t1_start).count();
+
+    // --- 2. Exact oracle ---
+    auto t2_start = std::chrono::high_resolution_clock::now();
+    std::vector<std::vector<KeyIdx>> exact = exact_topk(ds, queries, k, metric);
+    auto t2_end = std::chrono::high_resolution_clock::now();
+    double exact_time = std::chrono::duration<double>(t2_end - t2_start).count();
+
+    double code_bytes = (double)pts.size() * codes.code_size() + (double)rerank * pts.D * sizeof(float);
+    double float_bytes = (double)pts.size() * pts.D * sizeof(float);
+
+    std::cout << "\n--- Detailed Operation Times ---\n";
+    print_timing("Data + Codes Loading (mmap)", load_time);
+    print_timing("Quantized Scan + Re-rank", quant_time);
+    print_timing("Exact Search", exact_time);
+    std::cout << "------------------------------------\n";
+    print_peak_rss();
+    std::cout << "Bytes read per query: " << std::fixed << std::setprecision(1) << code_bytes / (1 << 20) << " MB vs "
+              << float_bytes / (1 << 20) << " MB exact (" << float_bytes / code_bytes << "x less)\n";
+    std::cout << "Speedup: " << std::setprecision(2) << exact_time / quant_time << "x\n";
+    std::cout << std::setprecision(4) << "Recall@" << k << ": " << recall_at_k(approx, exact) << "\n";
+
+    if (queries.size() == 1) print_neighbours(approx[0]);
+    return 0;
+}
+
+// build-proj: fit a pca / random projection, project every row and cache them
+int run_build_proj(int argc, char** argv) {
+    if (argc < 4) {
+        std::cout << "Usage: " << argv[0] << " build-proj datafile proj_file [--type pca|rp] [--dim d] [--sample S]"
+                  << " [--iters I] [--seed S]\n";
+        return 1;
+    }
+    const char* path = argv[2];
+    const char* proj_path = argv[3];
+    ProjType type = ProjType::PCA;
+    uint32_t dim = 0; // 0 = D / 8
+    size_t sample = 16384;
+    int iters = 20;
+    uint64_t seed = 42;
+    for (int a = 4; a < argc; a++) {
+        if (strcmp(argv[a], "--type") == 0 && a + 1 < argc) {
+            if (!parse_proj_type(argv[++a], type)) {
+                std::cerr << "Unknown projection: " << argv[a] << "\n";
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--dim") == 0 && a + 1 < argc) {
+            dim = std::stoul(argv[++a]);
+        } else if (strcmp(argv[a], "--sample") == 0 && a + 1 < argc) {
+            sample = std::stoul(argv[++a]);
+        } else if (strcmp(argv[a], "--iters") == 0 && a + 1 < argc) {
+            iters = std::stoi(argv[++a]);
+        } else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc) {
+            seed = std::stoull(argv[++a]);
+        } else {
+            std::cerr << "Unknown option: " << argv[a] << "\n";
+            return 1;
+        }
+    }
+
+    KnnDataset ds;
+    auto t_load_start = std::chrono::high_resolution_clock::now();
+    if (!ds.load(path)) {
+        std::cerr << "Could not load dataset\n";
+        return 1;
+    }
+    PointSet& pts = ds.points();
+    auto t_load_end = std::chrono::high_resolution_clock::now();
+    double load_time = std::chrono::duration<double>(t_load_end - t_load_start).count();
+    if (dim == 0) dim = std::max(1, pts.D / 8);
+
+    std::cout << "\n--- Building " << proj_type_name(type) << " Projection (" << omp_get_max_threads() << " threads) ---\n";
+    std::cout << "N=" << pts.size() << ", D=" << pts.D << ", dim=" << dim;
+    if (type == ProjType::PCA) std::cout << ", sample=" << std::min(sample, pts.size()) << ", iters=" << iters;
+    std::cout << "\n";
+
+    ProjBuildStats stats;
+    if (!Projection::build(pts, type, dim, sample, iters, seed, proj_path, stats)) {
+        std::cerr << "Projection build failed\n";
+        return 1;
+    }
+    std::cout << "Row size: " << dim * sizeof(float) << " bytes (" << std::fixed << std::setprecision(1)
+              << (double)pts.D / dim << "x smaller than float32)\n";
+    if (type == ProjType::PCA) {
+        Projection proj;
+        if (proj.open(proj_path)) {
+            std::cout << "Explained variance: " << std::setprecision(2) << 100.0 * proj.explained_variance() << "%\n";
+        }
+    }
+
+    std::cout << "\n--- Detailed Operation Times ---\n";
+    print_timing("Data Loading (mmap)", load_time);
+    print_timing(type == ProjType::PCA ? "PCA Fit" : "Random Basis", stats.fit_time);
+    print_timing("Projecting Rows", stats.project_time);
+    std::cout << "------------------------------------\n";
+    print_timing("Total Build", load_time + stats.fit_time + stats.project_time);
+    print_peak_rss();
+    return 0;
+}
+
+// query-proj: reduced-space scan + exact re-rank, checked against the exact scan
+int run_query_proj(int argc, char** argv) {
+    if (argc < 4) {
+        std::cout << "Usage: " << argv[0] << " query-proj datafile proj_file [ref_point] [--k N] [--rerank R]"
+                  << " [--metric l2|ip|cosine|l1] [--queries file]\n";
+        return 1;
+    }
+    const char* path = argv[2];
+    const char* proj_path = argv[3];
+    const char* ref_arg = nullptr;
+    const char* query_path = nullptr;
+    size_t k = 10;
+    size_t rerank = 0; // 0 = 10 * k
+    MetricKind metric = MetricKind::L2;
+    for (int a = 4; a < argc; a++) {
+        if (strcmp(argv[a], "--k") == 0 && a + 1 < argc) {
+            k = std::stoul(argv[++a]);
+        } else if (strcmp(argv[a], "--rerank") == 0 && a + 1 < argc) {
+            rerank = std::stoul(argv[++a]);
+        } else if (strcmp(argv[a], "--queries") == 0 && a + 1 < argc) {
+            query_path = argv[++a];
+        } else if (strcmp(argv[a], "--metric") == 0 && a + 1 < argc) {
+            if (!parse_metric(argv[++a], metric)) {
+                std::cerr << "Unknown metric: " << argv[a] << "\n";
+                return 1;
+            }
+        } else if (argv[a][0] != '-' || isdigit(argv[a][1]) || argv[a][1] == '.') {
+            ref_arg = argv[a];
+        } else {
+            std::cerr << "Unknown option: " << argv[a] << "\n";
+            return 1;
+        }
+    }
+    if (rerank == 0) rerank = 10 * k;
+
+    KnnDataset ds;
+    Projection proj;
+    auto t_load_start = std::chrono::high_resolution_clock::now();
+    if (!ds.load(path)) {
+        std::cerr << "Could not load dataset\n";
+        return 1;
+    }
+    PointSet& pts = ds.points();
+    if (!proj.open(proj_path)) {
+        std::cerr << "Could not open projection " << proj_path << "\n";
+        return 1;
+    }
+    if (metric == MetricKind::Cosine) ds.prepare(metric);
+    auto t_load_end = std::chrono::high_resolution_clock::now();
+    double load_time = std::chrono::duration<double>(t_load_end - t_load_start).count();
+
+    if (proj.size() != pts.size() || proj.dims() != pts.D) {
+        std::cerr << "Projection (N=" << proj.size() << ", D=" << proj.dims() << ") was not built from this dataset\n";
+        return 1;
+    }
+
+    PointSet queries;
+    if (!load_query_set(query_path, ref_arg, pts.D, queries)) return 1;
+
+    std::cout << "\n--- Running Projected Query (" << omp_get_max_threads() << " threads) ---\n";
+    std::cout << "N=" << pts.size() << ", D=" << pts.D << ", Q=" << queries.size() << ", k=" << k
+              << ", metric=" << metric_name(metric) << ", projection=" << proj_type_name(proj.type()) << " to "
+              << proj.reduced_dims() << ", rerank=" << rerank << "\n";
+
+    // --- 1. Query projection alone, the per-query overhead of the prefilter ---
+    std::vector<float> qp(proj.reduced_dims());
+    auto t0_start = std::chrono::high_resolution_clock::now();
+    for (size_t q = 0; q < queries.size(); q++) proj.project(queries.row(q), qp.data());
+    auto t0_end = std::chrono::high_resolution_clock::now();
+    double project_time = std::chrono::duration<double>(t0_end - t0_start).count();
+
+    // --- 2. Reduced-space scan + exact re-rank ---
+    std::vector<std::vector<KeyIdx>> approx;
+    auto t1_start = std::chrono::high_resolution_clock::now();
+    if (queries.size() == 1) {
+        approx.push_back(proj.search(pts, queries.row(0), k, rerank, metric));
+    } else {
+        approx = proj.search_batch(pts, queries, k, rerank, metric);
+    }
+    auto t1_end = std::chrono::high_resolution_clock::now();
+    double proj_time = std::chrono::duration<double>(t1_end - t1_start).count();
+
+    // --- 3. Exact oracle ---
+    auto t2_start = std::chrono::high_resolution_clock::now();
+    std::vector<std::vector<KeyIdx>> exact = exact_topk(ds, queries, k, metric);
+    auto t2_end = std::chrono::high_resolution_clock::now();
+    double exact_time = std::chrono::duration<double>(t2_end - t2_start).count();
+
+    double proj_bytes = (double)pts.size() * proj.reduced_dims() * sizeof(float) +
+                        (double)rerank * pts.D * sizeof(float);
+    double float_bytes = (double)pts.size() * pts.D * sizeof(float);
+
+    std::cout << "\n--- Detailed Operation Times ---\n";
+    print_timing("Data + Projection Loading (mmap)", load_time);
+    print_timing("Query Projection", project_time);
+    print_timing("Reduced Scan + Re-rank", proj_time);
+    print_timing("Exact Search", exact_time);
+    std::cout << "------------------------------------\n";
+    print_peak_rss();
+    if (proj.type() == ProjType::PCA) {
+        std::cout << "Explained variance: " << std::fixed << std::setprecision(2)
+                  << 100.0 * proj.explained_variance() << "%\n";
+    }
+    std::cout << "Bytes read per query: " << std::fixed << std::setprecision(1) << proj_bytes / (1 << 20) << " MB vs "
+              << float_bytes / (1 << 20) << " MB exact (" << float_bytes / proj_bytes << "x less)\n";
+    std::cout << "Speedup: " << std::setprecision(2) << exact_time / proj_time << "x\n";
+    std::cout << std::setprecision(4) << "Recall@" << k << ": " << recall_at_k(approx, exact) << "\n";
+
+    if (queries.size() == 1) print_neighbours(approx[0]);
+    return 0;
+}
+
+// serve: load the dataset once and answer k-NN requests over a Unix socket
+int run_serve(int argc, char** argv) {
+    if (argc < 4) {
+        std::cout << "Usage: " << argv[0] << " serve datafile socket_path [--workers W] [--batch-max Q] [--batch-wait-us U]\n";
+        return 1;
+    }
+    const char* path = argv[2];
+    const char* socket_path = argv[3];
+    ServerOptions opts;
+    for (int a = 4; a < argc; a++) {
+        if (strcmp(argv[a], "--workers") == 0 && a + 1 < argc) {
+            opts.workers = std::stoi(argv[++a]);
+        } else if (strcmp(argv[a], "--batch-max") == 0 && a + 1 < argc) {
+            opts.batch_max = std::stoul(argv[++a]);
+        } else if (strcmp(argv[a], "--batch-wait-us") == 0 && a + 1 < argc) {
+            opts.batch_wait_us = std::stoi(argv[++a]);
+        } else {
+            std::cerr << "Unknown option: " << argv[a] << "\n";
+            return 1;
+        }
+    }
+
+    KnnDataset ds;
+    auto t_load_start = std::chrono::high_resolution_clock::now();
+    if (!ds.load(path)) {
+        std::cerr << "Could not load dataset\n";
+        return 1;
+    }
+    PointSet& pts = ds.points();
+    auto t_load_end = std::chrono::high_resolution_clock::now();
+    print_timing("Data Loading (mmap)", std::chrono::duration<double>(t_load_end - t_load_start).count());
+
+    return serve_knn(pts, socket_path, opts) ? 0 : 1;
+}
+
+// client: send queries to a running server; with --concurrency, several
+// connections issue one query per request so the server can batch them
+int run_client(int argc, char** argv) {
+    if (argc < 3) {
+        std::cout << "Usage: " << argv[0] << " client socket_path [ref_point] [--k N] [--metric l2|ip|cosine|l1]"
+                  << " [--queries file [--concurrency C] [--out file]] [--stats] [--shutdown]\n";
+        return 1;
+    }
+    const char* socket_path = argv[2];
+    const char* ref_arg = nullptr;
+    const char* query_path = nullptr;
+    const char* out_path = nullptr;
+    size_t k = 10;
+    int concurrency = 1;
+    bool want_stats = false;
+    bool want_shutdown = false;
+    MetricKind metric = MetricKind::L2;
+    for (int a = 3; a < argc; a++) {
+        if (strcmp(argv[a], "--k") == 0 && a + 1 < argc) {
+            k = std::stoul(argv[++a]);
+        } else if (strcmp(argv[a], "--queries") == 0 && a + 1 < argc) {
+            query_path = argv[++a];
+        } else if (strcmp(argv[a], "--out") == 0 && a + 1 < argc) {
+            out_path = argv[++a];
+        } else if (strcmp(argv[a], "--concurrency") == 0 && a + 1 < argc) {
+            concurrency = std::max(1, std::stoi(argv[++a]));
+        } else if (strcmp(argv[a], "--metric") == 0 && a + 1 < argc) {
+            if (!parse_metric(argv[++a], metric)) {
+                std::cerr << "Unknown metric: " << argv[a] << "\n";
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--stats") == 0) {
+            want_stats = true;
+        } else if (strcmp(argv[a], "--shutdown") == 0) {
+            want_shutdown = true;
+        } else if (argv[a][0] != '-' || isdigit(argv[a][1]) || argv[a][1] == '.') {
+            ref_arg = argv[a];
+        } else {
+            std::cerr << "Unknown option: " << argv[a] << "\n";
+            return 1;
+        }
+    }
+
+    PointSet queries;
+    if (query_path) {
+        if (!load_points(query_path, queries)) {
+            std::cerr << "Could not load query file\n";
+            return 1;
+        }
+    } else if (ref_arg) {
+        // The dataset's D is the server's business: send every coordinate given
+        size_t D = 1;
+        for (const char* c = ref_arg; *c; c++) D += (*c == ',');
+        queries.allocate(1, (int)D);
+        std::vector<float> ref = parse_ref(ref_arg, (int)D);
+        std::copy(ref.begin(), ref.end(), queries.row(0));
+    }
+
+    if (!queries.empty()) {
+        std::vector<std::vector<KeyIdx>> results(queries.size());
+        LatencyHistogram latency;
+        std::atomic<bool> failed{false};
+        concurrency = (int)std::min<size_t>(concurrency, queries.size());
+
+        auto t_start = std::chrono::high_resolution_clock::now();
+        std::vector<std::thread> clients;
+        for (int c = 0; c < concurrency; c++) {
+            clients.emplace_back([&, c] {
+                int fd = connect_unix(socket_path);
+                if (fd == -1) {
+                    failed = true;
+                    return;
+                }
+                std::vector<std::vector<KeyIdx>> one;
+                for (size_t q = c; q < queries.size() && !failed; q += concurrency) {
+                    auto t0 = std::chrono::high_resolution_clock::now();
+                    if (!client_search(fd, q, queries.row(q), 1, queries.D, (uint32_t)k, metric, one)) {
+                        failed = true;
+                        break;
+                    }
+                    latency.record(std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t0).count());
+                    results[q] = std::move(one[0]);
+                }
+                close(fd);
+            });
+        }
+        for (std::thread& t : clients) t.join();
+        auto t_end = std::chrono::high_resolution_clock::now();
+        if (failed) return 1;
+        double total_time = std::chrono::duration<double>(t_end - t_start).count();
+
+        std::cout << "\n--- Client (" << concurrency << " connections, Q=" << queries.size() << ", k=" << k
+                  << ", metric=" << metric_name(metric) << ") ---\n";
+        print_timing("Total Round Trips", total_time);
+        std::cout << "Throughput: " << std::setprecision(1) << queries.size() / total_time << " queries/s\n";
+        latency.print(std::cout, "Client-side Latency");
+
+        if (queries.size() == 1) print_neighbours(results[0]);
+        else if (!write_results(results, out_path)) return 1;
+    }
+
+    if (want_stats || want_shutdown) {
+        int fd = connect_unix(socket_path);
+        if (fd == -1) return 1;
+        std::string text;
+        if (want_stats) {
+            if (!client_stats(fd, text)) return 1;
+            std::cout << "\n--- Server Statistics ---\n" << text;
+        }
+        if (want_shutdown && !client_shutdown(fd)) return 1;
+        close(fd);
+    }
+    return 0;
+}
+
+// shard-search: one `serve` worker process per shard file, queries fanned out
+// to all of them and the per-shard top-k lists merged
+int run_shard_search(int argc, char** argv) {
+    if (argc < 3) {
+        std::cout << "Usage: " << argv[0] << " shard-search shard_file... [ref_point] [--k N] [--metric l2|ip|cosine|l1]"
+                  << " [--queries file [--batch B] [--out file]] [--threads-per-shard T] [--socket-dir dir]\n";
+        return 1;
+    }
+    std::vector<std::string> shard_paths;
+    const char* ref_arg = nullptr;
+    const char* query_path = nullptr;
+    const char* out_path = nullptr;
+    size_t k = 10;
+    size_t batch = 1;
+    MetricKind metric = MetricKind::L2;
+    ShardOptions opts;
+    for (int a = 2; a < argc; a++) {
+        if (strcmp(argv[a], "--k") == 0 && a + 1 < argc) {
+            k = std::stoul(argv[++a]);
+        } else if (strcmp(argv[a], "--queries") == 0 && a + 1 < argc) {
+            query_path = argv[++a];
+        } else if (strcmp(argv[a], "--out") == 0 && a + 1 < argc) {
+            out_path = argv[++a];
+        } else if (strcmp(argv[a], "--batch") == 0 && a + 1 < argc) {
+            batch = std::max<size_t>(1, std::stoul(argv[++a]));
+        } else if (strcmp(argv[a], "--threads-per-shard") == 0 && a + 1 < argc) {
+            opts.threads_per_shard = std::stoi(argv[++a]);
+        } else if (strcmp(argv[a], "--socket-dir") == 0 && a + 1 < argc) {
+            opts.socket_dir = argv[++a];
+        } else if (strcmp(argv[a], "--metric") == 0 && a + 1 < argc) {
+            if (!parse_metric(argv[++a], metric)) {
+                std::cerr << "Unknown metric: " << argv[a] << "\n";
+                return 1;
+            }
+        } else if (argv[a][0] != '-' && access(argv[a], R_OK) == 0) {
+            // Positional arguments naming a readable file are shards
+            shard_paths.push_back(argv[a]);
+        } else if (isdigit(argv[a][0]) || argv[a][0] == '.' || isdigit(argv[a][1]) || argv[a][1] == '.') {
+            ref_arg = argv[a];
+        } else if (argv[a][0] != '-') {
+            std::cerr << "Cannot read shard file: " << argv[a] << "\n";
+            return 1;
+        } else {
+            std::cerr << "Unknown option: " << argv[a] << "\n";
+            return 1;
+        }
+    }
+    if (shard_paths.empty()) {
+        std::cerr << "No shard files given\n";
+        return 1;
+    }
+
+    // --- 1. Start the Workers (shards load in parallel) ---
+    ShardCoordinator coord;
+    auto t_start = std::chrono::high_resolution_clock::now();
+    if (!coord.start("/proc/self/exe", shard_paths, opts)) return 1;
+    auto t_started = std::chrono::high_resolution_clock::now();
+    double startup_time = std::chrono::duration<double>(t_started - t_start).count();
+
+    PointSet queries;
+    if (!load_query_set(query_path, ref_arg, coord.dims(), queries)) return 1;
+
+    std::cout << "\n--- Sharded k-NN (" << coord.shard_count() << " shards x " << coord.threads_per_shard()
+              << " threads) ---\n";
+    std::cout << "N=" << coord.size() << ", D=" << coord.dims() << ", Q=" << queries.size() << ", k=" << k
+              << ", metric=" << metric_name(metric) << ", batch=" << batch << "\n";
+
+    // --- 2. Scatter / Gather, one batch of queries at a time ---
+    std::vector<std::vector<KeyIdx>> results(queries.size());
+    SearchResult res;
+    auto t1_start = std::chrono::high_resolution_clock::now();
+    for (size_t q0 = 0; q0 < queries.size(); q0 += batch) {
+        size_t nq = std::min(batch, queries.size() - q0);
+        if (!coord.search(queries.row(q0), nq, k, metric, res)) return 1;
+        for (size_t q = 0; q < nq; q++) results[q0 + q].assign(res.row(q), res.row(q) + res.k);
+    }
+    auto t1_end = std::chrono::high_resolution_clock::now();
+    double search_time = std::chrono::duration<double>(t1_end - t1_start).count();
+
+    std::cout << "\n--- Detailed Operation Times ---\n";
+    print_timing("Worker Startup (parallel load)", startup_time);
+    print_timing("Sharded Search", search_time);
+    std::cout << "------------------------------------\n";
+    print_timing("Total Pipeline Time", startup_time + search_time);
+    std::cout << "Throughput: " << queries.size() / search_time << " queries/s\n";
+    coord.print_stats(std::cout);
+    coord.stop();
+
+    if (queries.size() == 1) {
+        print_neighbours(results[0]);
+        return 0;
+    }
+    return write_results(results, out_path) ? 0 : 1;
+}
+
+// Recalibrates the `auto` backend's profile for this host and prints it
+int run_tune(int argc, char** argv) {
+    std::string profile_path = default_profile_path();
+    for (int a = 2; a < argc; a++) {
+        if (strcmp(argv[a], "--profile") == 0 && a + 1 < argc) {
+            profile_path = argv[++a];
+        } else {
+            std::cout << "Usage: " << argv[0] << " tune [--profile file]\n";
+            return 1;
+        }
+    }
+
+    TuneProfile profile;
+    if (!load_or_calibrate(profile_path, true, profile)) return 1;
+    std::cout << "\n--- Autotune Profile (" << profile_path << ") ---\n";
+    print_profile(profile);
+    return 0;
 }
 
 int main(int argc, char** argv) {
+    if (argc >= 2 && strcmp(argv[1], "tune") == 0) return run_tune(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "shard-search") == 0) return run_shard_search(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "build-index") == 0) return run_build_index(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "query") == 0) return run_query(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "build-hnsw") == 0) return run_build_hnsw(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "query-hnsw") == 0) return run_query_hnsw(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "build-quant") == 0) return run_build_quant(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "query-quant") == 0) return run_query_quant(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "build-proj") == 0) return run_build_proj(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "query-proj") == 0) return run_query_proj(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "serve") == 0) return run_serve(argc, argv);
+    if (argc >= 2 && strcmp(argv[1], "client") == 0) return run_client(argc, argv);
+
     if (argc < 3) {
-        std::cout << "Usage: " << argv[0] << " datafile backend [ref_point]\n";
+        std::cout << "Usage: " << argv[0] << " datafile cpu|gpu|auto [ref_point] [--k N] [--metric l2|ip|cosine|l1] [--sort merge|radix]"
+                  << " [--queries file [--out file]]"
+                  << " [--stream [--mem-budget MB]]"
+                  << " [--numa first-touch|interleave|bind[:node]] [--bind close|spread|none]"
+                  << " [--trace file.json [--counters]] [--keep-dtype] [--profile file [--retune]]"
+                  << " [--radius R] [--early-abandon] [--reorder-dims]\n"
+                  << "       " << argv[0] << " tune [--profile file]\n"
+                  << "       " << argv[0] << " build-index datafile index_file [--nlist N] [--iters I] [--seed S]\n"
+                  << "       " << argv[0] << " query datafile index_file [ref_point] [--nprobe P] [--k N] [--queries file]\n"
+                  << "       " << argv[0] << " build-hnsw datafile index_file [--M M] [--ef-construction EF] [--metric m]\n"
+                  << "       " << argv[0] << " query-hnsw datafile index_file [ref_point] [--ef EF] [--k N] [--queries file]\n"
+                  << "       " << argv[0] << " build-quant datafile codes_file [--type sq8|pq] [--pq-m M]\n"
+                  << "       " << argv[0] << " query-quant datafile codes_file [ref_point] [--k N] [--rerank R] [--metric m] [--queries file]\n"
+                  << "       " << argv[0] << " build-proj datafile proj_file [--type pca|rp] [--dim d]\n"
+                  << "       " << argv[0] << " query-proj datafile proj_file [ref_point] [--k N] [--rerank R] [--metric m] [--queries file]\n"
+                  << "       " << argv[0] << " serve datafile socket_path [--workers W] [--batch-max Q] [--batch-wait-us U]\n"
+                  << "       " << argv[0] << " client socket_path [ref_point] [--k N] [--metric m] [--queries file [--concurrency C]] [--stats] [--shutdown]\n"
+                  << "       " << argv[0] << " shard-search shard_file... [ref_point] [--k N] [--metric m] [--queries file [--batch B]] [--threads-per-shard T]\n";
         return 1;
     }
 
     const char* path = argv[1];
     const char* backend = argv[2];
+    const char* ref_arg = nullptr;
+    size_t k = 0; // 0 = full sort
+    const char* query_path = nullptr;
+    const char* out_path = nullptr;
+    bool stream = false;
+    size_t mem_budget = 1024ull << 20;
+    MetricKind metric = MetricKind::L2;
+    SortAlgo sort_algo = SortAlgo::Merge;
+    NumaPolicy numa = NumaPolicy::FirstTouch;
+    int numa_node = 0;
+    ThreadBind bind = ThreadBind::None;
+    bool numa_requested = false;
+    const char* trace_path = nullptr;
+    bool counters = false;
+    bool keep_dtype = false;
+    bool sort_given = false;
+    size_t grain_size = 0;  // mergesort leaf size; 0 = default
+    std::string profile_path = default_profile_path();
+    bool retune = false;
+    bool radius_given = false;
+    float radius = 0.0f;
+    bool early_abandon = false;
+    bool reorder = false;
+
+    for (int a = 3; a < argc; a++) {
+        if (strcmp(argv[a], "--k") == 0 && a + 1 < argc) {
+            k = std::stoul(argv[++a]);
+        } else if (strcmp(argv[a], "--queries") == 0 && a + 1 < argc) {
+            query_path = argv[++a];
+        } else if (strcmp(argv[a], "--out") == 0 && a + 1 < argc) {
+            out_path = argv[++a];
+        } else if (strcmp(argv[a], "--metric") == 0 && a + 1 < argc) {
+            if (!parse_metric(argv[++a], metric)) {
+                std::cerr << "Unknown metric: " << argv[a] << "\n";
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--sort") == 0 && a + 1 < argc) {
+            if (!parse_sort_algo(argv[++a], sort_algo)) {
+                std::cerr << "Unknown sort algorithm: " << argv[a] << "\n";
+                return 1;
+            }
+            sort_given = true;
+        } else if (strcmp(argv[a], "--stream") == 0) {
+            stream = true;
+        } else if (strcmp(argv[a], "--mem-budget") == 0 && a + 1 < argc) {
+            mem_budget = std::stoull(argv[++a]) << 20;
+        } else if (strcmp(argv[a], "--numa") == 0 && a + 1 < argc) {
+            if (!parse_numa_policy(argv[++a], numa, numa_node)) {
+                std::cerr << "Unknown NUMA policy: " << argv[a] << "\n";
+                return 1;
+            }
+            numa_requested = true;
+        } else if (strcmp(argv[a], "--bind") == 0 && a + 1 < argc) {
+            if (!parse_thread_bind(argv[++a], bind)) {
+                std::cerr << "Unknown thread binding: " << argv[a] << "\n";
+                return 1;
+            }
+            numa_requested = true;
+        } else if (strcmp(argv[a], "--trace") == 0 && a + 1 < argc) {
+            trace_path = argv[++a];
+        } else if (strcmp(argv[a], "--counters") == 0) {
+            counters = true;
+        } else if (strcmp(argv[a], "--keep-dtype") == 0) {
+            keep_dtype = true;
+        } else if (strcmp(argv[a], "--profile") == 0 && a + 1 < argc) {
+            profile_path = argv[++a];
+        } else if (strcmp(argv[a], "--retune") == 0) {
+            retune = true;
+        } else if (strcmp(argv[a], "--radius") == 0 && a + 1 < argc) {
+            radius = std::stof(argv[++a]);
+            radius_given = true;
+        } else if (strcmp(argv[a], "--early-abandon") == 0) {
+            early_abandon = true;
+        } else if (strcmp(argv[a], "--reorder-dims") == 0) {
+            reorder = true;
+        } else if (argv[a][0] != '-' || isdigit(argv[a][1]) || argv[a][1] == '.') {
+            ref_arg = argv[a];
+        } else {
+            std::cerr << "Unknown option: " << argv[a] << "\n";
+            return 1;
+        }
+    }
+
+    // Placement and pinning are set before loading, so the point store's pages
+    // are touched by the threads that will later scan them
+    if (!set_numa_policy(numa, numa_node)) return 1;
+    if (!pin_threads(bind)) {
+        std::cerr << "Warning: could not pin threads (" << thread_bind_name(bind) << ")\n";
+    }
+    bool report_numa = numa_requested || host_numa_nodes() > 1;
+
+    // After pinning, so the counter groups are opened by the pinned team
+    if (trace_path && !trace_start(trace_path, counters)) return 1;
+    if (counters && !trace_path) {
+        std::cerr << "--counters needs --trace\n";
+        return 1;
+    }
+
+    // auto: the backend, thread count and sort are picked per run from the
+    // host's calibration profile (streaming and batched runs stay on the CPU)
+    Backend backend_kind = Backend::CPU;
+    const bool auto_backend = strcmp(backend, "auto") == 0;
+    if (!auto_backend && !parse_backend(backend, backend_kind)) {
+        std::cerr << "Unknown backend: " << backend << "\n";
+        return 1;
+    }
 
-    std::vector<Point> pts;
-    int D = 0;
+    // Radius search and early abandon are single-query CPU scans
+    if ((radius_given || early_abandon) && (backend_kind != Backend::CPU || stream || query_path)) {
+        std::cerr << "--radius and --early-abandon are single-query modes of the cpu backend\n";
+        return 1;
+    }
+    if (radius_given && k > 0) {
+        std::cerr << "--radius and --k are exclusive\n";
+        return 1;
+    }
+    if (early_abandon && k == 0) {
+        std::cerr << "--early-abandon needs --k (or use --radius)\n";
+        return 1;
+    }
+    if (reorder && (stream || query_path)) {
+        std::cerr << "--reorder-dims is only supported for single-query runs\n";
+        return 1;
+    }
+
+    if (stream) {
+        if (backend_kind != Backend::CPU) {
+            std::cerr << "--stream is only supported by the cpu backend\n";
+            return 1;
+        }
+        return run_stream_mode(path, ref_arg, k > 0 ? k : 10, metric, mem_budget);
+    }
+
+    TuneProfile profile;
+    if (auto_backend && !query_path && !load_or_calibrate(profile_path, retune, profile)) return 1;
+
+    KnnDataset ds;
 
     // --- 1. Measure Data Loading (Parallel) ---
     auto t_load_start = std::chrono::high_resolution_clock::now();
-    if (!load_points(path, pts, D)) {
+    // fp16/bf16 rows are scanned in place only by the single-query CPU paths;
+    // batched and GPU search widen them at load like before
+    if (!ds.load(path, keep_dtype && backend_kind == Backend::CPU && !query_path)) {
         std::cerr << "Could not load dataset\n";
         return 1;
     }
+    if (auto_backend && !query_path) {
+        // A pruned scan is costed as a (full) top-k pass, on the CPU only
+        const bool pruned = radius_given || early_abandon;
+        TuneChoice choice = choose_config(profile, ds.size(), ds.dims(), radius_given ? 1 : k, pruned);
+        backend_kind = choice.backend;
+        if (choice.backend == Backend::CPU) {
+            omp_set_num_threads(choice.threads);
+            if (!sort_given) {
+                sort_algo = choice.algo;
+                grain_size = choice.grain_size;
+            }
+        } else {
+            ds.points().widen();
+        }
+        std::cout << "Autotune: " << backend_name(choice.backend) << ", " << choice.threads << " threads";
+        if (choice.backend == Backend::CPU && k == 0 && !pruned) std::cout << ", " << sort_algo_name(sort_algo);
+        std::cout << " (predicted " << std::fixed << std::setprecision(3) << choice.predicted_s * 1e3 << " ms)\n";
+    }
+    // Cosine norms are computed once here, not per query
+    if (metric == MetricKind::Cosine && backend_kind == Backend::CPU) ds.prepare(metric);
+    // Columns by decreasing variance, so pruned scans cross their bound sooner
+    if (reorder) ds.reorder_dims();
     auto t_load_end = std::chrono::high_resolution_clock::now();
     double load_time = std::chrono::duration<double>(t_load_end - t_load_start).count();
 
-    // Prepare reference point
-    std::vector<float> ref(D, 0.0f);
-    if (argc >= 4) {
-        std::stringstream ss(argv[3]);
-        std::string tok;
-        int idx = 0;
-        while (std::getline(ss, tok, ',') && idx < D) {
-            ref[idx++] = std::stof(tok);
+    PointSet& pts = ds.points();
+    const int D = pts.D;
+
+    if (query_path) {
+        if (backend_kind != Backend::CPU) {
+            std::cerr << "--queries is only supported by the cpu backend\n";
+            return 1;
         }
+        return run_batch_mode(ds, query_path, k > 0 ? k : 10, metric, out_path, load_time);
     }
 
-    if (strcmp(backend, "cpu") == 0) {
+    // Prepare reference point (in file column order; the dataset permutes it)
+    std::vector<float> ref = parse_ref(ref_arg, D);
+
+    if (backend_kind == Backend::CPU) {
         // Display hardware info
         int max_threads = omp_get_max_threads();
         std::cout << "\n--- Running CPU Backend (" << max_threads << " threads) ---\n";
         std::cout << "N=" << pts.size() << ", D=" << D << "\n";
+        std::cout << "Metric: " << metric_name(metric) << ", distance kernel: " << isa_name(detect_isa())
+                  << (is_specialised_dim(D) && pts.is_f32() ? " (specialised D)" : "") << "\n";
+        if (!pts.is_f32()) std::cout << "Storage: " << dtype_name(pts.dtype) << " rows, float32 accumulation\n";
+        if (reorder) std::cout << "Columns reordered by variance (widest first: dim " << ds.dim_order()[0] << ")\n";
+
+        if (radius_given) {
+            // --- 2. Radius Scan (rows abandoned once past the radius) ---
+            auto t1_start = std::chrono::high_resolution_clock::now();
+            PruneStats prune;
+            std::vector<KeyIdx> hits = ds.radius(ref.data(), radius, metric, &prune);
+            auto t1_end = std::chrono::high_resolution_clock::now();
+            double scan_time = std::chrono::duration<double>(t1_end - t1_start).count();
+
+            std::cout << "\n--- Detailed Operation Times ---\n";
+            print_timing("Data Loading (mmap)", load_time);
+            print_timing("Radius Scan", scan_time);
+            std::cout << "------------------------------------\n";
+            print_timing("Total Pipeline Time", load_time + scan_time);
+            print_peak_rss();
+            if (report_numa) print_node_bandwidth(pts, bind);
+            print_prune_stats(prune);
+
+            print_radius_hits(hits, radius);
+            std::cout << "\n--- Result Check ---\n";
+            if (!hits.empty()) {
+                std::cout << "Closest Distance: " << hits.front().dist << "\n";
+                std::cout << "Farthest Distance: " << hits.back().dist << "\n";
+            }
+            return 0;
+        }
 
-        // --- 2. Measure CPU Distance Calculation ---
-        auto t1_start = std::chrono::high_resolution_clock::now();
-        compute_distances_cpu(pts, ref);
-        auto t1_end = std::chrono::high_resolution_clock::now();
-        double dist_time = std::chrono::duration<double>(t1_end - t1_start).count();
+        if (k > 0) {
+            // --- 2. Fused Distance + Top-k Selection (single pass, no sort) ---
+            auto t1_start = std::chrono::high_resolution_clock::now();
+            SearchResult res;
+            PruneStats prune;
+            if (early_abandon) {
+                ds.search_abandon(ref.data(), k, metric, res, &prune);
+            } else {
+                ds.search(ref.data(), 1, k, metric, Backend::CPU, res);
+            }
+            auto t1_end = std::chrono::high_resolution_clock::now();
+            double select_time = std::chrono::duration<double>(t1_end - t1_start).count();
+            const KeyIdx* nn = res.row(0);
 
-        // --- 3. Measure CPU Sorting ---
-        auto t2_start = std::chrono::high_resolution_clock::now();
-        // Passing only pts; the internal wrapper now handles scratchpad and tasks
-        mergesort_cpu(pts);
-        auto t2_end = std::chrono::high_resolution_clock::now();
-        double sort_time = std::chrono::duration<double>(t2_end - t2_start).count();
+            std::cout << "\n--- Detailed Operation Times ---\n";
+            print_timing("Data Loading (mmap)", load_time);
+            print_timing("Distance + Top-k Selection", select_time);
+            std::cout << "------------------------------------\n";
+            print_timing("Total Pipeline Time", load_time + select_time);
+            print_peak_rss();
+            if (report_numa) print_node_bandwidth(pts, bind);
+            if (early_abandon) print_prune_stats(prune);
+
+            print_neighbours(nn, res.k);
+            std::cout << "\n--- Result Check ---\n";
+            if (res.k > 0) {
+                std::cout << "Closest Distance: " << nn[0].dist << "\n";
+                std::cout << "k-th Distance: " << nn[res.k - 1].dist << "\n";
+            }
+            return 0;
+        }
+
+        // --- 2. Distance Calculation + Sorting, timed separately ---
+        RankStats rank;
+        ds.rank(ref.data(), metric, Backend::CPU, sort_algo, grain_size, &rank);
+        double dist_time = rank.distance_time;
+        double sort_time = rank.sort_time;
 
         // --- Print Results ---
         std::cout << "\n--- Detailed Operation Times ---\n";
         print_timing("Data Loading (mmap)", load_time);
         print_timing("Distance Calculation", dist_time);
-        print_timing("Sorting (Mergesort)", sort_time);
+        print_timing(std::string("Sorting (") + sort_algo_name(sort_algo) + ")", sort_time);
         std::cout << "------------------------------------\n";
         print_timing("Total Pipeline Time", load_time + dist_time + sort_time);
+        print_peak_rss();
+        if (report_numa) print_node_bandwidth(pts, bind);
 
-    } else if (strcmp(backend, "gpu") == 0) {
+    } else {
         std::cout << "\n--- Detailed Operation Times ---\n";
         print_timing("Data Loading (mmap)", load_time);
-        run_gpu_sort(pts, ref);
+        ds.rank(ref.data(), metric, Backend::GPU, sort_algo);
+        print_peak_rss();
+    }
+
+    if (k > 0) {
+        std::vector<KeyIdx> nn(std::min(k, pts.size()));
+        for (size_t i = 0; i < nn.size(); i++) nn[i] = {pts.dist[i], pts.id[i]};
+        print_neighbours(nn);
     }
 
     std::cout << "\n--- Result Check ---\n";
     if(!pts.empty()) {
-        std::cout << "Closest Distance: " << pts[0].dist << "\n";
-        std::cout << "Farthest Distance: " << pts.back().dist << "\n";
+        std::cout << "Closest Distance: " << pts.dist[0] << "\n";
+        std::cout << "Farthest Distance: " << pts.dist.back() << "\n";
     }
     return 0;
 }
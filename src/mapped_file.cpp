@@ -0,0 +1,35 @@
+#include "mapped_file.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() {
+    if (addr_) munmap(addr_, length_);
+}
+
+bool MappedFile::map(const std::string& filename, size_t min_size) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1) return false;
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || (size_t)sb.st_size < min_size) {
+        close(fd);
+        return false;
+    }
+    void* addr = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) return false;
+    addr_ = static_cast<char*>(addr);
+    length_ = sb.st_size;
+    return true;
+}
+
+bool MappedFile::extent(uint64_t& offset, uint64_t count, uint64_t elem) const {
+    uint64_t bytes, end;
+    if (__builtin_mul_overflow(count, elem, &bytes) || __builtin_add_overflow(offset, bytes, &end) ||
+        end > length_) {
+        return false;
+    }
+    offset = end;
+    return true;
+}
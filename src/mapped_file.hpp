@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Read-only private mapping of an index file (.ivf, .hnsw, .codes, .proj).
+// The readers copy their fixed header out with `header`, then walk the
+// sections with `extent`, which rejects any section that overflows or runs
+// past the end of the file, before pointing into the mapping with `at`.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps `filename`; false if it cannot be opened or is shorter than `min_size`.
+    bool map(const std::string& filename, size_t min_size);
+
+    size_t size() const { return length_; }
+
+    template <class H>
+    void header(H& h) const { std::memcpy(&h, addr_, sizeof(H)); }
+
+    // Advances `offset` past `count` elements of `elem` bytes. False on
+    // overflow or if the section ends past the file.
+    bool extent(uint64_t& offset, uint64_t count, uint64_t elem) const;
+
+    template <class T>
+    const T* at(uint64_t offset) const { return reinterpret_cast<const T*>(addr_ + offset); }
+
+private:
+    char* addr_ = nullptr;
+    size_t length_ = 0;
+};
@@ -0,0 +1,172 @@
+#pragma once
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+#include "distance_kernels.hpp"
+#include "half.hpp"
+
+// Distance metrics as compile-time policies. Every metric is "smaller is
+// nearer", so the same heaps and sorts serve all of them:
+//   l2      squared Euclidean distance
+//   ip      negated inner product (maximum inner product search)
+//   cosine  1 - cos(x, q); uses per-row norms precomputed at load time
+//   l1      Manhattan distance
+//
+// A policy is built once per query and called per row:
+//   Metric m(q, D);  float d = m(row, row_norm);
+// row_norm is the row's L2 norm and is only read when kNeedsNorms is true.
+// The Half* policies are the same metrics over fp16/bf16 rows (uint16_t bit
+// patterns, see PointSet::dtype) with a float32 query and float32 sums.
+
+enum class MetricKind { L2, InnerProduct, Cosine, L1 };
+
+inline const char* metric_name(MetricKind m) {
+    switch (m) {
+        case MetricKind::InnerProduct: return "ip";
+        case MetricKind::Cosine: return "cosine";
+        case MetricKind::L1: return "l1";
+        default: return "l2";
+    }
+}
+
+inline bool parse_metric(const std::string& name, MetricKind& m) {
+    if (name == "l2") m = MetricKind::L2;
+    else if (name == "ip") m = MetricKind::InnerProduct;
+    else if (name == "cosine") m = MetricKind::Cosine;
+    else if (name == "l1") m = MetricKind::L1;
+    else return false;
+    return true;
+}
+
+struct L2Metric {
+    static constexpr bool kNeedsNorms = false;
+    const float* q;
+    int D;
+    L2Kernel kernel;
+
+    L2Metric(const float* q_, int D_) : q(q_), D(D_), kernel(select_l2_kernel(D_)) {}
+    float operator()(const float* x, float) const { return kernel(x, q, D); }
+};
+
+struct InnerProductMetric {
+    static constexpr bool kNeedsNorms = false;
+    const float* q;
+    int D;
+    DotKernel dot;
+
+    InnerProductMetric(const float* q_, int D_) : q(q_), D(D_), dot(select_dot_kernel(D_)) {}
+    float operator()(const float* x, float) const { return -dot(x, q, D); }
+};
+
+struct CosineMetric {
+    static constexpr bool kNeedsNorms = true;
+    const float* q;
+    int D;
+    DotKernel dot;
+    float q_norm;
+
+    CosineMetric(const float* q_, int D_) : q(q_), D(D_), dot(select_dot_kernel(D_)) {
+        q_norm = std::sqrt(dot(q, q, D));
+    }
+    float operator()(const float* x, float x_norm) const {
+        float denom = x_norm * q_norm;
+        return denom > 0.0f ? 1.0f - dot(x, q, D) / denom : 1.0f;
+    }
+};
+
+struct L1Metric {
+    static constexpr bool kNeedsNorms = false;
+    const float* q;
+    int D;
+
+    L1Metric(const float* q_, int D_) : q(q_), D(D_) {}
+    float operator()(const float* __restrict x, float) const {
+        float sum = 0.0f;
+        #pragma omp simd reduction(+:sum)
+        for (int j = 0; j < D; j++) sum += std::fabs(x[j] - q[j]);
+        return sum;
+    }
+};
+
+struct HalfL2Metric {
+    static constexpr bool kNeedsNorms = false;
+    const float* q;
+    int D;
+    HalfKernel kernel;
+
+    HalfL2Metric(const float* q_, int D_, uint32_t dtype) : q(q_), D(D_), kernel(select_half_l2_kernel(dtype)) {}
+    float operator()(const uint16_t* x, float) const { return kernel(x, q, D); }
+};
+
+struct HalfInnerProductMetric {
+    static constexpr bool kNeedsNorms = false;
+    const float* q;
+    int D;
+    HalfKernel dot;
+
+    HalfInnerProductMetric(const float* q_, int D_, uint32_t dtype) : q(q_), D(D_), dot(select_half_dot_kernel(dtype)) {}
+    float operator()(const uint16_t* x, float) const { return -dot(x, q, D); }
+};
+
+struct HalfCosineMetric {
+    static constexpr bool kNeedsNorms = true;
+    const float* q;
+    int D;
+    HalfKernel dot;
+    float q_norm;
+
+    HalfCosineMetric(const float* q_, int D_, uint32_t dtype) : q(q_), D(D_), dot(select_half_dot_kernel(dtype)) {
+        q_norm = std::sqrt(select_dot_kernel(D_)(q, q, D));
+    }
+    float operator()(const uint16_t* x, float x_norm) const {
+        float denom = x_norm * q_norm;
+        return denom > 0.0f ? 1.0f - dot(x, q, D) / denom : 1.0f;
+    }
+};
+
+struct HalfL1Metric {
+    static constexpr bool kNeedsNorms = false;
+    const float* q;
+    int D;
+    HalfKernel kernel;
+
+    HalfL1Metric(const float* q_, int D_, uint32_t dtype) : q(q_), D(D_), kernel(select_half_l1_kernel(dtype)) {}
+    float operator()(const uint16_t* x, float) const { return kernel(x, q, D); }
+};
+
+// L2 norm of a row, for metrics that need one when no precomputed norm exists.
+// The dtype argument lets templated loops call it for either kind of row.
+inline float row_norm(const float* x, int D, uint32_t = DTYPE_F32) {
+    return std::sqrt(select_dot_kernel(D)(x, x, D));
+}
+
+inline float row_norm(const uint16_t* x, int D, uint32_t dtype) {
+    thread_local std::vector<float> wide;
+    wide.resize(D);
+    widen_to_float(x, wide.data(), D, dtype);
+    return row_norm(wide.data(), D);
+}
+
+// Calls f(policy) with the policy type matching `m`, so runtime selection
+// (--metric) instantiates the templated hot loops once per metric.
+template <class F>
+auto dispatch_metric(MetricKind m, const float* q, int D, F&& f) {
+    switch (m) {
+        case MetricKind::InnerProduct: return f(InnerProductMetric(q, D));
+        case MetricKind::Cosine: return f(CosineMetric(q, D));
+        case MetricKind::L1: return f(L1Metric(q, D));
+        default: return f(L2Metric(q, D));
+    }
+}
+
+// Same, with the policy for fp16/bf16 rows of the given dtype.
+template <class F>
+auto dispatch_half_metric(MetricKind m, uint32_t dtype, const float* q, int D, F&& f) {
+    switch (m) {
+        case MetricKind::InnerProduct: return f(HalfInnerProductMetric(q, D, dtype));
+        case MetricKind::Cosine: return f(HalfCosineMetric(q, D, dtype));
+        case MetricKind::L1: return f(HalfL1Metric(q, D, dtype));
+        default: return f(HalfL2Metric(q, D, dtype));
+    }
+}
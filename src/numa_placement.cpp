@@ -0,0 +1,266 @@
+#include "numa_placement.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <dirent.h>
+#include <omp.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef KNN_WITH_LIBNUMA
+#include <numa.h>
+#endif
+
+// Allocations below this go through malloc: they fit in cache anyway, and an
+// mmap per small vector would waste a page and a system call.
+static constexpr size_t kSmallAlloc = 64 * 1024;
+
+static NumaPolicy g_policy = NumaPolicy::FirstTouch;
+static int g_bind_node = 0;
+
+bool parse_numa_policy(const std::string& name, NumaPolicy& policy, int& node) {
+    node = 0;
+    if (name == "first-touch") policy = NumaPolicy::FirstTouch;
+    else if (name == "interleave") policy = NumaPolicy::Interleave;
+    else if (name == "bind") policy = NumaPolicy::Bind;
+    else if (name.compare(0, 5, "bind:") == 0 && name.size() > 5 &&
+             name.find_first_not_of("0123456789", 5) == std::string::npos) {
+        policy = NumaPolicy::Bind;
+        node = std::stoi(name.substr(5));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* numa_policy_name(NumaPolicy policy) {
+    switch (policy) {
+        case NumaPolicy::Interleave: return "interleave";
+        case NumaPolicy::Bind: return "bind";
+        default: return "first-touch";
+    }
+}
+
+bool parse_thread_bind(const std::string& name, ThreadBind& bind) {
+    if (name == "none") bind = ThreadBind::None;
+    else if (name == "close") bind = ThreadBind::Close;
+    else if (name == "spread") bind = ThreadBind::Spread;
+    else return false;
+    return true;
+}
+
+const char* thread_bind_name(ThreadBind bind) {
+    switch (bind) {
+        case ThreadBind::Close: return "close";
+        case ThreadBind::Spread: return "spread";
+        default: return "none";
+    }
+}
+
+bool set_numa_policy(NumaPolicy policy, int node) {
+#ifdef KNN_WITH_LIBNUMA
+    if (policy != NumaPolicy::FirstTouch) {
+        if (numa_available() < 0) {
+            std::cerr << "NUMA: the kernel reports no NUMA support\n";
+            return false;
+        }
+        if (node < 0 || node > numa_max_node()) {
+            std::cerr << "NUMA: no node " << node << "\n";
+            return false;
+        }
+    }
+#else
+    if (policy != NumaPolicy::FirstTouch) {
+        std::cerr << "NUMA: " << numa_policy_name(policy) << " needs a build with NUMA=1 (libnuma)\n";
+        return false;
+    }
+#endif
+    g_policy = policy;
+    g_bind_node = node;
+    return true;
+}
+
+NumaPolicy current_numa_policy() { return g_policy; }
+
+// 1. Topology: cpu -> node, read once from sysfs
+static const std::vector<int>& cpu_nodes() {
+    static const std::vector<int> nodes = [] {
+        std::vector<int> map;
+        DIR* dir = opendir("/sys/devices/system/node");
+        if (!dir) return map;
+        while (dirent* e = readdir(dir)) {
+            if (std::strncmp(e->d_name, "node", 4) != 0 || !isdigit((unsigned char)e->d_name[4])) continue;
+            int node = std::atoi(e->d_name + 4);
+            std::ifstream in(std::string("/sys/devices/system/node/") + e->d_name + "/cpulist");
+            std::string list;
+            std::getline(in, list);
+
+            // "0-31,64-95"
+            size_t pos = 0;
+            while (pos < list.size()) {
+                size_t comma = list.find(',', pos);
+                if (comma == std::string::npos) comma = list.size();
+                std::string range = list.substr(pos, comma - pos);
+                size_t dash = range.find('-');
+                if (!range.empty()) {
+                    int lo = std::atoi(range.c_str());
+                    int hi = dash == std::string::npos ? lo : std::atoi(range.c_str() + dash + 1);
+                    if (hi >= (int)map.size()) map.resize(hi + 1, 0);
+                    for (int c = lo; c <= hi; c++) map[c] = node;
+                }
+                pos = comma + 1;
+            }
+        }
+        closedir(dir);
+        return map;
+    }();
+    return nodes;
+}
+
+int cpu_numa_node(int cpu) {
+    const std::vector<int>& map = cpu_nodes();
+    return cpu >= 0 && cpu < (int)map.size() ? map[cpu] : 0;
+}
+
+int host_numa_nodes() {
+    const std::vector<int>& map = cpu_nodes();
+    return map.empty() ? 1 : *std::max_element(map.begin(), map.end()) + 1;
+}
+
+// 2. Thread pinning
+bool pin_threads(ThreadBind bind) {
+    if (bind == ThreadBind::None) return true;
+
+    // The allowed set is captured before the first pin narrows the master thread
+    static const std::vector<int> allowed = [] {
+        std::vector<int> cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int c = 0; c < CPU_SETSIZE; c++) if (CPU_ISSET(c, &set)) cpus.push_back(c);
+        }
+        return cpus;
+    }();
+    if (allowed.empty()) return false;
+
+    // Close: node-major order. Spread: take one CPU from each node in turn.
+    std::vector<int> order = allowed;
+    std::stable_sort(order.begin(), order.end(),
+                     [](int a, int b) { return cpu_numa_node(a) < cpu_numa_node(b); });
+    if (bind == ThreadBind::Spread) {
+        std::vector<std::vector<int>> per_node(host_numa_nodes());
+        for (int c : order) per_node[cpu_numa_node(c)].push_back(c);
+        order.clear();
+        for (size_t i = 0; order.size() < allowed.size(); i++) {
+            for (auto& cpus : per_node) if (i < cpus.size()) order.push_back(cpus[i]);
+        }
+    }
+
+    bool ok = true;
+    #pragma omp parallel reduction(&&:ok)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(order[omp_get_thread_num() % order.size()], &set);
+        ok = sched_setaffinity(0, sizeof(set), &set) == 0;
+    }
+    return ok;
+}
+
+// 3. Placement
+void* numa_alloc_bytes(size_t bytes) {
+    if (bytes < kSmallAlloc) return std::malloc(std::max<size_t>(bytes, 1));
+
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return nullptr;
+
+#ifdef KNN_WITH_LIBNUMA
+    if (g_policy == NumaPolicy::Interleave) numa_interleave_memory(p, bytes, numa_all_nodes_ptr);
+    else if (g_policy == NumaPolicy::Bind) numa_tonode_memory(p, bytes, g_bind_node);
+#endif
+
+    // Partitioned first touch. Under interleave/bind the kernel already decides
+    // the node; touching here just takes the page faults in parallel.
+    const size_t page = sysconf(_SC_PAGESIZE);
+    const size_t pages = (bytes + page - 1) / page;
+    char* c = static_cast<char*>(p);
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < pages; i++) c[i * page] = 0;
+    return p;
+}
+
+void numa_free_bytes(void* p, size_t bytes) {
+    if (!p) return;
+    if (bytes < kSmallAlloc) std::free(p);
+    else munmap(p, bytes);
+}
+
+void numa_prefault(const void* p, size_t bytes) {
+    const size_t page = sysconf(_SC_PAGESIZE);
+    const volatile char* c = static_cast<const volatile char*>(p);
+    const size_t pages = (bytes + page - 1) / page;
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < pages; i++) (void)c[std::min(i * page, bytes - 1)];
+}
+
+// 4. Per-node bandwidth. The sum is stored so the read loop is not optimised away.
+static volatile uint64_t g_bandwidth_sink;
+
+std::vector<NodeBandwidth> measure_node_bandwidth(const void* p, size_t bytes) {
+    const int nodes = host_numa_nodes();
+    std::vector<NodeBandwidth> out(nodes);
+    for (int n = 0; n < nodes; n++) out[n].node = n;
+
+    const uint64_t* words = static_cast<const uint64_t*>(p);
+    const size_t count = bytes / sizeof(uint64_t);
+    uint64_t sink = 0;
+
+    #pragma omp parallel
+    {
+        const int t = omp_get_thread_num();
+        const int nt = omp_get_num_threads();
+        const size_t begin = count * t / nt;
+        const size_t end = count * (t + 1) / nt;
+
+        #pragma omp barrier
+        double start = omp_get_wtime();
+        uint64_t acc = 0;
+        #pragma omp simd reduction(+:acc)
+        for (size_t i = begin; i < end; i++) acc += words[i];
+        double elapsed = omp_get_wtime() - start;
+
+        int node = std::min(cpu_numa_node(sched_getcpu()), nodes - 1);
+        #pragma omp critical
+        {
+            out[node].threads++;
+            out[node].bytes += (end - begin) * sizeof(uint64_t);
+            out[node].seconds = std::max(out[node].seconds, elapsed);
+            sink += acc;
+        }
+    }
+
+#ifdef KNN_WITH_LIBNUMA
+    // Where the pages actually are: query a sample of at most 4096 pages
+    if (numa_available() >= 0 && bytes > 0) {
+        const size_t page = sysconf(_SC_PAGESIZE);
+        const size_t pages = (bytes + page - 1) / page;
+        const size_t samples = std::min<size_t>(pages, 4096);
+        std::vector<void*> addrs(samples);
+        std::vector<int> status(samples, -1);
+        uintptr_t base = reinterpret_cast<uintptr_t>(p) / page * page;
+        for (size_t i = 0; i < samples; i++) addrs[i] = reinterpret_cast<void*>(base + (pages * i / samples) * page);
+
+        if (numa_move_pages(0, samples, addrs.data(), nullptr, status.data(), 0) == 0) {
+            std::vector<size_t> on_node(nodes, 0);
+            for (int s : status) if (s >= 0 && s < nodes) on_node[s]++;
+            for (int n = 0; n < nodes; n++) out[n].resident = (double)on_node[n] / samples;
+        }
+    }
+#endif
+
+    g_bandwidth_sink = sink;
+    return out;
+}
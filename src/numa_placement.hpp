@@ -0,0 +1,94 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Where large buffers (the point store, sort keys and scratch) get their pages
+// on multi-socket hosts.
+//   FirstTouch: thread t of a static schedule touches the t-th slice, so the
+//               slice lands on t's node (partitioned first touch). Default.
+//   Interleave: pages round-robin over all nodes (needs a NUMA=1 build).
+//   Bind:       every page on one node (needs a NUMA=1 build).
+enum class NumaPolicy { FirstTouch, Interleave, Bind };
+
+// How OpenMP threads are pinned to CPUs.
+//   None:   leave it to the OS (or OMP_PROC_BIND / OMP_PLACES).
+//   Close:  fill node 0's CPUs first, then node 1, ...
+//   Spread: round-robin over nodes, so every node gets threads early.
+enum class ThreadBind { None, Close, Spread };
+
+// Accepts first-touch, interleave, bind or bind:<node>.
+bool parse_numa_policy(const std::string& name, NumaPolicy& policy, int& node);
+const char* numa_policy_name(NumaPolicy policy);
+bool parse_thread_bind(const std::string& name, ThreadBind& bind);
+const char* thread_bind_name(ThreadBind bind);
+
+// Process-wide policy used by numa_alloc_bytes. Returns false (and keeps the
+// old policy) if the policy needs libnuma and this build has none.
+bool set_numa_policy(NumaPolicy policy, int node = 0);
+NumaPolicy current_numa_policy();
+
+// Pins each thread of the OpenMP team to one CPU of the process's allowed set.
+// Later parallel regions of the same size reuse the pinned threads.
+bool pin_threads(ThreadBind bind);
+
+// Topology from /sys/devices/system/node; a host without it is one node.
+int host_numa_nodes();
+int cpu_numa_node(int cpu);
+
+// Page-aligned anonymous allocation whose pages are placed by the current
+// policy before it is returned. The memory is not zeroed by the caller's thread.
+void* numa_alloc_bytes(size_t bytes);
+void numa_free_bytes(void* p, size_t bytes);
+
+// Read-faults an existing mapping (e.g. an mmapped dataset) in the same static
+// partition, so pages not yet in the page cache are read in by the node that
+// will scan them.
+void numa_prefault(const void* p, size_t bytes);
+
+// std::vector allocator for large arrays: storage comes from numa_alloc_bytes
+// and elements are default-initialised, so vector(n) does not zero every page
+// from the calling thread.
+template <class T>
+struct NumaAllocator {
+    using value_type = T;
+
+    NumaAllocator() = default;
+    template <class U>
+    NumaAllocator(const NumaAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        void* p = numa_alloc_bytes(n * sizeof(T));
+        if (!p) throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+    void deallocate(T* p, size_t n) { numa_free_bytes(p, n * sizeof(T)); }
+
+    template <class U>
+    void construct(U* p) { ::new (static_cast<void*>(p)) U; }
+    template <class U, class... Args>
+    void construct(U* p, Args&&... args) { ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+
+    template <class U>
+    bool operator==(const NumaAllocator<U>&) const { return true; }
+    template <class U>
+    bool operator!=(const NumaAllocator<U>&) const { return false; }
+};
+
+template <class T>
+using numa_vector = std::vector<T, NumaAllocator<T>>;
+
+// One streaming read of a buffer, split like the placement: each thread reads
+// its static slice and is credited to the node of the CPU it runs on.
+struct NodeBandwidth {
+    int node = 0;
+    int threads = 0;
+    size_t bytes = 0;
+    double seconds = 0.0;       // slowest thread on the node
+    double resident = -1.0;     // fraction of the buffer's pages on this node; -1 if unknown
+    double gbps() const { return seconds > 0.0 ? bytes / seconds / 1e9 : 0.0; }
+};
+
+std::vector<NodeBandwidth> measure_node_bandwidth(const void* p, size_t bytes);
@@ -0,0 +1,139 @@
+#include "point_generator.hpp"
+#include <charconv>
+#include <cmath>
+
+namespace {
+
+// Independent streams of the same row counter
+enum : uint32_t { kValueStream = 0, kClusterStream = 1, kCentreStream = 2 };
+
+// Philox4x32-10 (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3").
+// Ten rounds of two 32x32->64 multiplies; passes BigCrush.
+struct Philox4x32 {
+    uint32_t k0, k1;
+
+    explicit Philox4x32(uint64_t seed) : k0((uint32_t)seed), k1((uint32_t)(seed >> 32)) {}
+
+    void operator()(uint32_t c[4]) const {
+        uint32_t key0 = k0, key1 = k1;
+        for (int r = 0; r < 10; r++) {
+            uint64_t p0 = (uint64_t)0xD2511F53u * c[0];
+            uint64_t p1 = (uint64_t)0xCD9E8D57u * c[2];
+            uint32_t n0 = (uint32_t)(p1 >> 32) ^ c[1] ^ key0;
+            uint32_t n2 = (uint32_t)(p0 >> 32) ^ c[3] ^ key1;
+            c[0] = n0;
+            c[1] = (uint32_t)p1;
+            c[2] = n2;
+            c[3] = (uint32_t)p0;
+            key0 += 0x9E3779B9u;
+            key1 += 0xBB67AE85u;
+        }
+    }
+};
+
+// 24 random bits: [0, 1) and (0, 1]
+inline float unit_open_high(uint32_t x) { return (x >> 8) * 0x1.0p-24f; }
+inline float unit_open_low(uint32_t x) { return ((x >> 8) + 1) * 0x1.0p-24f; }
+
+// Four values of `stream` for (index, block): dimensions 4 * block .. 4 * block + 3
+inline void draw4(const Philox4x32& rng, uint64_t index, uint32_t block, uint32_t stream, uint32_t out[4]) {
+    out[0] = (uint32_t)index;
+    out[1] = (uint32_t)(index >> 32);
+    out[2] = block;
+    out[3] = stream;
+    rng(out);
+}
+
+// Box-Muller: two uniforms to two standard normals
+inline void box_muller(uint32_t a, uint32_t b, float& z0, float& z1) {
+    float r = std::sqrt(-2.0f * std::log(unit_open_low(a)));
+    float t = 6.28318530718f * unit_open_high(b);
+    z0 = r * std::cos(t);
+    z1 = r * std::sin(t);
+}
+
+// D standard normals for (index, stream)
+void normal_row(const Philox4x32& rng, uint64_t index, uint32_t stream, int D, float* out) {
+    for (int j = 0; j < D; j += 4) {
+        uint32_t x[4];
+        float z[4];
+        draw4(rng, index, (uint32_t)(j / 4), stream, x);
+        box_muller(x[0], x[1], z[0], z[1]);
+        box_muller(x[2], x[3], z[2], z[3]);
+        for (int l = 0; l < 4 && j + l < D; l++) out[j + l] = z[l];
+    }
+}
+
+}  // namespace
+
+bool parse_distribution(const std::string& name, PointDistribution& dist) {
+    if (name == "uniform") dist = PointDistribution::Uniform;
+    else if (name == "normal") dist = PointDistribution::Normal;
+    else if (name == "mixture") dist = PointDistribution::Mixture;
+    else return false;
+    return true;
+}
+
+const char* distribution_name(PointDistribution dist) {
+    switch (dist) {
+        case PointDistribution::Normal: return "normal";
+        case PointDistribution::Mixture: return "mixture";
+        default: return "uniform";
+    }
+}
+
+PointGenerator::PointGenerator(const GeneratorConfig& cfg, int D) : cfg_(cfg), D_(D) {
+    if (cfg_.dist != PointDistribution::Mixture) return;
+    if (cfg_.clusters == 0) cfg_.clusters = 1;
+    Philox4x32 rng(cfg_.seed);
+    centres_.resize((size_t)cfg_.clusters * D);
+    for (uint32_t c = 0; c < cfg_.clusters; c++) normal_row(rng, c, kCentreStream, D, &centres_[(size_t)c * D]);
+}
+
+void PointGenerator::row(uint64_t i, float* out) const {
+    const Philox4x32 rng(cfg_.seed);
+    const int D = D_;
+
+    if (cfg_.dist == PointDistribution::Uniform) {
+        for (int j = 0; j < D; j += 4) {
+            uint32_t x[4];
+            draw4(rng, i, (uint32_t)(j / 4), kValueStream, x);
+            for (int l = 0; l < 4 && j + l < D; l++) out[j + l] = -1000.0f + 2000.0f * unit_open_high(x[l]);
+        }
+    } else {
+        normal_row(rng, i, kValueStream, D, out);
+    }
+
+    if (cfg_.dist == PointDistribution::Mixture) {
+        uint32_t x[4];
+        draw4(rng, i, 0, kClusterStream, x);
+        uint32_t c = (uint32_t)(((uint64_t)x[0] * cfg_.clusters) >> 32);
+        const float* centre = &centres_[(size_t)c * D];
+        for (int j = 0; j < D; j++) out[j] = centre[j] + cfg_.spread * out[j];
+    }
+
+    if (cfg_.normalize) {
+        double sq = 0.0;
+        for (int j = 0; j < D; j++) sq += (double)out[j] * out[j];
+        if (sq > 0.0) {
+            float inv = (float)(1.0 / std::sqrt(sq));
+            for (int j = 0; j < D; j++) out[j] *= inv;
+        }
+    }
+}
+
+void PointGenerator::rows(uint64_t first, size_t count, float* out) const {
+    for (size_t r = 0; r < count; r++) row(first + r, out + r * (size_t)D_);
+}
+
+size_t format_row_text(const float* row, int D, bool fixed, char* out) {
+    char* p = out;
+    for (int j = 0; j < D; j++) {
+        // 16 bytes per value covers the longest shortest-form float ("-1.1754944e-38") and a separator
+        auto res = fixed ? std::to_chars(p, p + 15, row[j], std::chars_format::fixed, 4)
+                         : std::to_chars(p, p + 15, row[j]);
+        p = res.ptr;
+        *p++ = j + 1 < D ? ' ' : '\n';
+    }
+    return p - out;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Synthetic datasets that are a pure function of (config, D, row index).
+// Random numbers come from Philox4x32-10, a counter-based generator: row i
+// hashes the counter (i, block, stream) under the seed key, so any thread can
+// produce any row, in any order, and the dataset does not depend on the
+// thread count or batch size.
+//   uniform  every value uniform in [-1000, 1000) (the classic generate_points data)
+//   normal   every value N(0, 1)
+//   mixture  equal-weight Gaussian mixture: `clusters` centres drawn N(0, 1),
+//            rows are a centre plus N(0, spread^2) per dimension, the kind of
+//            clustered data ANN indexes are built for
+// With normalize, every row is scaled to unit L2 norm (cosine / ip workloads).
+
+enum class PointDistribution { Uniform, Normal, Mixture };
+
+bool parse_distribution(const std::string& name, PointDistribution& dist);
+const char* distribution_name(PointDistribution dist);
+
+struct GeneratorConfig {
+    PointDistribution dist = PointDistribution::Uniform;
+    uint64_t seed = 42;
+    uint32_t clusters = 64;   // mixture only
+    float spread = 0.1f;      // mixture only: per-dimension standard deviation around a centre
+    bool normalize = false;
+};
+
+class PointGenerator {
+public:
+    // Mixture centres are drawn here, once (clusters x D floats).
+    PointGenerator(const GeneratorConfig& cfg, int D);
+
+    int dims() const { return D_; }
+
+    // Writes row i (D floats) to out.
+    void row(uint64_t i, float* out) const;
+    // Rows first .. first + count - 1, row-major.
+    void rows(uint64_t first, size_t count, float* out) const;
+
+private:
+    GeneratorConfig cfg_;
+    int D_;
+    std::vector<float> centres_;
+};
+
+// True if text output keeps the classic fixed 4-decimal format (uniform data);
+// other data is printed in the shortest form that round-trips.
+inline bool fixed_text_format(const GeneratorConfig& cfg) {
+    return cfg.dist == PointDistribution::Uniform && !cfg.normalize;
+}
+
+// Formats one row as text ("v v ... v\n") into out, which needs room for
+// 16 * D bytes. Returns the number of bytes written.
+size_t format_row_text(const float* row, int D, bool fixed, char* out);
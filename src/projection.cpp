@@ -0,0 +1,373 @@
+#include "projection.hpp"
+#include "kmeans.hpp"
+#include "distance_kernels.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <omp.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static constexpr char kProjMagic[8] = {'K', 'N', 'N', 'P', 'R', 'J', '1', '\0'};
+static constexpr int kOversample = 8;   // extra subspace vectors: faster convergence of the last ones we keep
+
+const char* proj_type_name(ProjType t) {
+    return t == ProjType::RP ? "rp" : "pca";
+}
+
+bool parse_proj_type(const std::string& name, ProjType& t) {
+    if (name == "pca") t = ProjType::PCA;
+    else if (name == "rp") t = ProjType::RP;
+    else return false;
+    return true;
+}
+
+// Mean and covariance C = 1/S sum (x - mean)(x - mean)^T of the sample,
+// C row-major D x D in double. Parallel over rows of C, upper triangle
+// only, then mirrored.
+static void sample_covariance(const PointSet& sample, std::vector<float>& mean, std::vector<double>& cov) {
+    const size_t S = sample.size();
+    const int D = sample.D;
+    std::vector<double> sum(D, 0.0);
+    #pragma omp parallel
+    {
+        std::vector<double> local(D, 0.0);
+        #pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < S; i++) {
+            const float* row = sample.row(i);
+            for (int j = 0; j < D; j++) local[j] += row[j];
+        }
+        #pragma omp critical
+        for (int j = 0; j < D; j++) sum[j] += local[j];
+    }
+    mean.resize(D);
+    for (int j = 0; j < D; j++) mean[j] = (float)(sum[j] / S);
+
+    PointSet centred;
+    centred.allocate(S, D);
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < S; i++) {
+        for (int j = 0; j < D; j++) centred.row(i)[j] = sample.row(i)[j] - mean[j];
+    }
+
+    cov.assign((size_t)D * D, 0.0);
+    #pragma omp parallel for schedule(dynamic, 4)
+    for (int j = 0; j < D; j++) {
+        double* __restrict c = &cov[(size_t)j * D];
+        for (size_t i = 0; i < S; i++) {
+            const float* __restrict x = centred.row(i);
+            const double a = x[j];
+            #pragma omp simd
+            for (int l = j; l < D; l++) c[l] += a * x[l];
+        }
+        for (int l = j; l < D; l++) c[l] /= (double)S;
+    }
+    for (int j = 0; j < D; j++) {
+        for (int l = 0; l < j; l++) cov[(size_t)j * D + l] = cov[(size_t)l * D + j];
+    }
+}
+
+// Orthonormalises the p vectors (each D long, stored one after another) by
+// modified Gram-Schmidt
+static void orthonormalise(std::vector<double>& Q, int p, int D) {
+    for (int c = 0; c < p; c++) {
+        double* v = &Q[(size_t)c * D];
+        for (int b = 0; b < c; b++) {
+            const double* u = &Q[(size_t)b * D];
+            double dot = 0.0;
+            for (int j = 0; j < D; j++) dot += u[j] * v[j];
+            for (int j = 0; j < D; j++) v[j] -= dot * u[j];
+        }
+        double norm = 0.0;
+        for (int j = 0; j < D; j++) norm += v[j] * v[j];
+        norm = std::sqrt(norm);
+        // A vector in the span of the previous ones: C is rank deficient
+        if (norm < 1e-30) {
+            std::fill(v, v + D, 0.0);
+            continue;
+        }
+        for (int j = 0; j < D; j++) v[j] /= norm;
+    }
+}
+
+// Cyclic Jacobi on a symmetric n x n matrix A (row-major). On return the
+// diagonal of A holds the eigenvalues and column e of V the e-th eigenvector.
+static void jacobi_eigen(std::vector<double>& A, int n, std::vector<double>& V) {
+    V.assign((size_t)n * n, 0.0);
+    for (int i = 0; i < n; i++) V[(size_t)i * n + i] = 1.0;
+    auto a = [&](int i, int j) -> double& { return A[(size_t)i * n + j]; };
+
+    for (int sweep = 0; sweep < 100; sweep++) {
+        double off = 0.0, diag = 0.0;
+        for (int i = 0; i < n; i++) {
+            diag += a(i, i) * a(i, i);
+            for (int j = i + 1; j < n; j++) off += a(i, j) * a(i, j);
+        }
+        if (off <= 1e-24 * diag) break;
+
+        for (int p = 0; p < n - 1; p++) {
+            for (int q = p + 1; q < n; q++) {
+                if (a(p, q) == 0.0) continue;
+                double theta = (a(q, q) - a(p, p)) / (2.0 * a(p, q));
+                double t = (theta >= 0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+                double c = 1.0 / std::sqrt(t * t + 1.0), s = t * c;
+                for (int k = 0; k < n; k++) {
+                    double akp = a(k, p), akq = a(k, q);
+                    a(k, p) = c * akp - s * akq;
+                    a(k, q) = s * akp + c * akq;
+                }
+                for (int k = 0; k < n; k++) {
+                    double apk = a(p, k), aqk = a(q, k);
+                    a(p, k) = c * apk - s * aqk;
+                    a(q, k) = s * apk + c * aqk;
+                }
+                for (int k = 0; k < n; k++) {
+                    double vkp = V[(size_t)k * n + p], vkq = V[(size_t)k * n + q];
+                    V[(size_t)k * n + p] = c * vkp - s * vkq;
+                    V[(size_t)k * n + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+}
+
+// Y = C Q for p vectors of length D; parallel over the rows of C
+static void multiply_cov(const std::vector<double>& C, const std::vector<double>& Q, int p, int D,
+                         std::vector<double>& Y) {
+    Y.assign((size_t)p * D, 0.0);
+    #pragma omp parallel for schedule(static)
+    for (int j = 0; j < D; j++) {
+        const double* __restrict c = &C[(size_t)j * D];
+        for (int v = 0; v < p; v++) {
+            const double* __restrict q = &Q[(size_t)v * D];
+            double s = 0.0;
+            #pragma omp simd reduction(+:s)
+            for (int l = 0; l < D; l++) s += c[l] * q[l];
+            Y[(size_t)v * D + j] = s;
+        }
+    }
+}
+
+// Leading `dim` eigenvectors of the sample covariance (rows of `basis`) by
+// randomized subspace iteration with a Rayleigh-Ritz step at the end
+static void fit_pca(const PointSet& pts, uint32_t dim, size_t sample, int iterations, std::mt19937_64& rng,
+                    std::vector<float>& mean, std::vector<float>& basis, float& explained) {
+    const int D = pts.D;
+    PointSet train = sample_rows(pts, std::min(sample, pts.size()), rng);
+    std::vector<double> C;
+    sample_covariance(train, mean, C);
+
+    const int p = std::min(D, (int)dim + kOversample);
+    std::normal_distribution<double> gauss(0.0, 1.0);
+    std::vector<double> Q((size_t)p * D), Y;
+    for (double& v : Q) v = gauss(rng);
+    orthonormalise(Q, p, D);
+    for (int it = 0; it < iterations; it++) {
+        multiply_cov(C, Q, p, D, Y);
+        Q.swap(Y);
+        orthonormalise(Q, p, D);
+    }
+
+    // Rayleigh-Ritz: T = Q^T C Q, rotated so the vectors come out ordered
+    multiply_cov(C, Q, p, D, Y);
+    std::vector<double> T((size_t)p * p), V;
+    for (int a = 0; a < p; a++) {
+        for (int b = 0; b < p; b++) {
+            double s = 0.0;
+            for (int j = 0; j < D; j++) s += Q[(size_t)a * D + j] * Y[(size_t)b * D + j];
+            T[(size_t)a * p + b] = s;
+        }
+    }
+    jacobi_eigen(T, p, V);
+    std::vector<int> order(p);
+    for (int e = 0; e < p; e++) order[e] = e;
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return T[(size_t)a * p + a] > T[(size_t)b * p + b]; });
+
+    double trace = 0.0, kept = 0.0;
+    for (int j = 0; j < D; j++) trace += C[(size_t)j * D + j];
+    basis.assign((size_t)dim * D, 0.0f);
+    for (uint32_t c = 0; c < dim && (int)c < p; c++) {
+        const int e = order[c];
+        kept += std::max(0.0, T[(size_t)e * p + e]);
+        for (int j = 0; j < D; j++) {
+            double s = 0.0;
+            for (int a = 0; a < p; a++) s += Q[(size_t)a * D + j] * V[(size_t)a * p + e];
+            basis[(size_t)c * D + j] = (float)s;
+        }
+    }
+    explained = trace > 0.0 ? (float)(kept / trace) : 0.0f;
+}
+
+bool Projection::build(const PointSet& pts, ProjType type, uint32_t dim, size_t sample, int iterations, uint64_t seed,
+                       const std::string& filename, ProjBuildStats& stats) {
+    const size_t N = pts.size();
+    const int D = pts.D;
+    if (N == 0) return false;
+    if (dim == 0 || (int)dim > D) {
+        std::cerr << "Projected dimension (" << dim << ") must be in [1, " << D << "]\n";
+        return false;
+    }
+
+    ProjHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, kProjMagic, sizeof(h.magic));
+    h.N = N;
+    h.D = D;
+    h.dim = dim;
+    h.type = (uint32_t)type;
+    h.seed = seed;
+
+    // 1. Basis
+    double t0 = omp_get_wtime();
+    std::mt19937_64 rng(seed);
+    std::vector<float> mean(D, 0.0f), basis;
+    if (type == ProjType::PCA) {
+        fit_pca(pts, dim, sample, iterations, rng, mean, basis, h.explained);
+    } else {
+        std::normal_distribution<float> gauss(0.0f, 1.0f / std::sqrt((float)dim));
+        basis.resize((size_t)dim * D);
+        for (float& v : basis) v = gauss(rng);
+    }
+    stats.fit_time = omp_get_wtime() - t0;
+
+    // 2. Every row: x' = B x - B mean, and x.mean for the ip estimate
+    double t1 = omp_get_wtime();
+    const DotKernel dot = select_dot_kernel(D);
+    std::vector<float> bmean(dim);
+    for (uint32_t c = 0; c < dim; c++) bmean[c] = dot(&basis[(size_t)c * D], mean.data(), D);
+    std::vector<float> rows(N * (size_t)dim), shift(N);
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < N; i++) {
+        const float* x = pts.row(i);
+        float* out = &rows[i * dim];
+        for (uint32_t c = 0; c < dim; c++) out[c] = dot(&basis[(size_t)c * D], x, D) - bmean[c];
+        shift[i] = dot(x, mean.data(), D);
+    }
+    stats.project_time = omp_get_wtime() - t1;
+
+    const size_t params_end = sizeof(ProjHeader) + sizeof(float) * (mean.size() + basis.size());
+    h.rows_offset = (params_end + 63) & ~(size_t)63;
+
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        std::cerr << "System Error: " << std::strerror(errno) << " (" << filename << ")" << std::endl;
+        return false;
+    }
+    bool ok = pwrite(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h);
+    ok = ok && pwrite(fd, mean.data(), sizeof(float) * D, sizeof(h)) == (ssize_t)(sizeof(float) * D);
+    ok = ok && pwrite(fd, basis.data(), sizeof(float) * basis.size(), sizeof(h) + sizeof(float) * D) ==
+                   (ssize_t)(sizeof(float) * basis.size());
+    // Rows can exceed a single write's limit; write them in slices
+    const char* bytes = reinterpret_cast<const char*>(rows.data());
+    const size_t row_bytes = sizeof(float) * rows.size();
+    for (size_t off = 0; ok && off < row_bytes; off += (1u << 30)) {
+        size_t len = std::min<size_t>(1u << 30, row_bytes - off);
+        ok = pwrite(fd, bytes + off, len, h.rows_offset + off) == (ssize_t)len;
+    }
+    ok = ok && pwrite(fd, shift.data(), sizeof(float) * N, h.rows_offset + row_bytes) == (ssize_t)(sizeof(float) * N);
+    if (close(fd) != 0) ok = false;
+    if (!ok) std::cerr << "Error: File write failed (Disk full or quota exceeded?)" << std::endl;
+    return ok;
+}
+
+bool Projection::open(const std::string& filename) {
+    if (!file_.map(filename, sizeof(ProjHeader))) return false;
+    file_.header(header_);
+
+    // The mean and basis must end before the rows, which must fit the file
+    uint64_t at = sizeof(ProjHeader);
+    bool valid = std::memcmp(header_.magic, kProjMagic, sizeof(kProjMagic)) == 0 &&
+                 header_.type <= (uint32_t)ProjType::RP && header_.dim > 0 && header_.dim <= header_.D &&
+                 file_.extent(at, (1 + (uint64_t)header_.dim) * header_.D, sizeof(float)) &&
+                 at <= header_.rows_offset;
+    at = header_.rows_offset;
+    valid = valid && file_.extent(at, header_.N, sizeof(float) * ((uint64_t)header_.dim + 1));
+    if (!valid) {
+        std::cerr << "Not a valid projection file: " << filename << "\n";
+        return false;
+    }
+
+    mean_ = file_.at<float>(sizeof(ProjHeader));
+    basis_ = mean_ + header_.D;
+    rows_ = file_.at<float>(header_.rows_offset);
+    shift_ = rows_ + header_.N * header_.dim;
+    return true;
+}
+
+void Projection::project(const float* q, float* out) const {
+    const int D = dims();
+    const DotKernel dot = select_dot_kernel(D);
+    for (int c = 0; c < reduced_dims(); c++) {
+        const float* b = basis_ + (size_t)c * D;
+        out[c] = dot(b, q, D) - dot(b, mean_, D);
+    }
+}
+
+float Projection::query_shift(const float* q) const {
+    const DotKernel dot = select_dot_kernel(dims());
+    return dot(q, mean_, dims()) - dot(mean_, mean_, dims());
+}
+
+static bool scan_uses_ip(MetricKind metric) {
+    return metric == MetricKind::InnerProduct || metric == MetricKind::Cosine;
+}
+
+void Projection::scan(const PointSet& pts, const float* qp, float q_shift, MetricKind metric, size_t begin,
+                      size_t end, TopK& heap) const {
+    const int d = reduced_dims();
+    if (!scan_uses_ip(metric)) {
+        const L2Kernel l2 = select_l2_kernel(d);
+        for (size_t i = begin; i < end; i++) {
+            float dist = l2(rows_ + i * d, qp, d);
+            if (dist < heap.worst()) heap.push({dist, (uint32_t)i});
+        }
+        return;
+    }
+    // Estimated x.q, negated like the ip metric; cosine divides by |x|
+    const DotKernel dot = select_dot_kernel(d);
+    const float* norms = metric == MetricKind::Cosine && !pts.norms.empty() ? pts.norms.data() : nullptr;
+    for (size_t i = begin; i < end; i++) {
+        float s = dot(rows_ + i * d, qp, d) + shift_[i] + q_shift;
+        if (norms) s = norms[i] > 0.0f ? s / norms[i] : 0.0f;
+        if (-s < heap.worst()) heap.push({-s, (uint32_t)i});
+    }
+}
+
+std::vector<KeyIdx> Projection::search(const PointSet& pts, const float* q, size_t k, size_t rerank,
+                                       MetricKind metric) const {
+    std::vector<float> qp(reduced_dims());
+    project(q, qp.data());
+    const float q_shift = query_shift(q);
+    rerank = std::max(rerank, k);
+
+    std::vector<TopK> partial(omp_get_max_threads(), TopK(rerank));
+    #pragma omp parallel
+    {
+        const int t = omp_get_thread_num();
+        const int nt = omp_get_num_threads();
+        scan(pts, qp.data(), q_shift, metric, size() * t / nt, size() * (t + 1) / nt, partial[t]);
+    }
+    TopK cands(rerank);
+    for (const TopK& t : partial) cands.merge(t);
+    return rerank_exact(pts, q, cands.sorted(), k, metric);
+}
+
+std::vector<std::vector<KeyIdx>> Projection::search_batch(const PointSet& pts, const PointSet& queries, size_t k,
+                                                          size_t rerank, MetricKind metric) const {
+    rerank = std::max(rerank, k);
+    std::vector<std::vector<KeyIdx>> results(queries.size());
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t qi = 0; qi < queries.size(); qi++) {
+        std::vector<float> qp(reduced_dims());
+        project(queries.row(qi), qp.data());
+        TopK cands(rerank);
+        scan(pts, qp.data(), query_shift(queries.row(qi)), metric, 0, size(), cands);
+        results[qi] = rerank_exact(pts, queries.row(qi), cands.sorted(), k, metric);
+    }
+    return results;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "PointSet.hpp"
+#include "mapped_file.hpp"
+#include "cpu_topk.hpp"
+#include "metrics.hpp"
+
+// Dimensionality-reduction prefilter: every row is projected to `dim` << D
+// dimensions once, the projected rows are cached in a file, and a query
+// scans those (D/dim x less traffic) for `rerank` candidates that are then
+// re-scored exactly on the full rows.
+//   pca  top principal components of a row sample: mean and covariance in
+//        parallel, then randomized subspace iteration for the leading
+//        eigenvectors (keeps the most variance for a given dim)
+//   rp   seeded Gaussian random projection scaled by 1/sqrt(dim)
+//        (Johnson-Lindenstrauss; no training, preserves l2 and ip in
+//        expectation)
+// Rows are stored as B (x - mean). The candidate scan ranks by squared l2
+// in the reduced space for l2 and l1. For ip and cosine it ranks by
+// x'.q' + x.mean + q.mean - mean.mean, the reduced estimate of x.q, which
+// uses one stored scalar per row. The re-rank always applies the requested
+// metric.
+//
+// File layout (.proj), mmapped on open:
+//   [ ProjHeader ][ mean[D] ][ basis dim x D ][ pad to 64 ]
+//   [ N x dim float rows ][ N float x.mean ]
+
+enum class ProjType : uint32_t { PCA = 0, RP = 1 };
+
+const char* proj_type_name(ProjType t);
+bool parse_proj_type(const std::string& name, ProjType& t);
+
+struct ProjHeader {
+    char magic[8];        // "KNNPRJ1\0"
+    uint64_t N;
+    uint32_t D;
+    uint32_t dim;         // reduced dimension
+    uint32_t type;        // ProjType
+    float explained;      // pca: share of the sample variance kept; rp: 0
+    uint64_t rows_offset;
+    uint64_t seed;
+    uint64_t reserved[2];
+};
+static_assert(sizeof(ProjHeader) == 64, "ProjHeader must stay 64 bytes");
+
+struct ProjBuildStats {
+    double fit_time = 0.0;      // pca: sample covariance + eigenvectors; rp: the random matrix
+    double project_time = 0.0;  // every row through the basis
+};
+
+class Projection {
+public:
+    Projection() = default;
+    Projection(const Projection&) = delete;
+    Projection& operator=(const Projection&) = delete;
+
+    // Fits the basis (pca on `sample` rows with `iterations` subspace
+    // iterations; rp from `seed`), projects every row and writes the file.
+    static bool build(const PointSet& pts, ProjType type, uint32_t dim, size_t sample, int iterations, uint64_t seed,
+                      const std::string& filename, ProjBuildStats& stats);
+
+    // Maps a projection file for querying.
+    bool open(const std::string& filename);
+
+    size_t size() const { return header_.N; }
+    int dims() const { return (int)header_.D; }
+    int reduced_dims() const { return (int)header_.dim; }
+    ProjType type() const { return (ProjType)header_.type; }
+    float explained_variance() const { return header_.explained; }
+
+    // q (D floats) into the reduced space (dim floats).
+    void project(const float* q, float* out) const;
+
+    // Top-k for one query: parallel scan over the projected rows keeping
+    // `rerank` candidates, then an exact re-rank on the float rows of `pts`.
+    std::vector<KeyIdx> search(const PointSet& pts, const float* q, size_t k, size_t rerank, MetricKind metric) const;
+
+    // Top-k for every query row; parallel over queries.
+    std::vector<std::vector<KeyIdx>> search_batch(const PointSet& pts, const PointSet& queries, size_t k,
+                                                  size_t rerank, MetricKind metric) const;
+
+private:
+    // Reduced-space scan of rows [begin, end) into `heap`. qp is the
+    // projected query; for ip/cosine, q_shift = q.mean - mean.mean.
+    void scan(const PointSet& pts, const float* qp, float q_shift, MetricKind metric, size_t begin, size_t end,
+              TopK& heap) const;
+    float query_shift(const float* q) const;
+
+    MappedFile file_;
+    ProjHeader header_{};
+    const float* mean_ = nullptr;
+    const float* basis_ = nullptr;
+    const float* rows_ = nullptr;
+    const float* shift_ = nullptr;   // x.mean per row
+};
@@ -0,0 +1,337 @@
+#include "quantizer.hpp"
+#include "kmeans.hpp"
+#include "distance_kernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <type_traits>
+#include <omp.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static constexpr char kQuantMagic[8] = {'K', 'N', 'N', 'Q', 'N', 'T', '1', '\0'};
+static constexpr uint32_t kPqCentroids = 256;
+static constexpr size_t kPqTrainRows = 64 * kPqCentroids;
+static constexpr size_t kEncodeChunk = 1 << 16;
+
+const char* quant_type_name(QuantType t) {
+    return t == QuantType::PQ ? "pq" : "sq8";
+}
+
+bool parse_quant_type(const std::string& name, QuantType& t) {
+    if (name == "sq8") t = QuantType::SQ8;
+    else if (name == "pq") t = QuantType::PQ;
+    else return false;
+    return true;
+}
+
+// Rows [begin, begin + n), columns [col, col + width) of `src` as a dense set
+static PointSet column_slice(const PointSet& src, size_t begin, size_t n, int col, int width) {
+    PointSet out;
+    out.allocate(n, width);
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++) std::memcpy(out.row(i), src.row(begin + i) + col, sizeof(float) * width);
+    return out;
+}
+
+// Per-dimension min and scale so that x = min + scale * code, code in [0, 255]
+static void train_sq8(const PointSet& pts, std::vector<float>& params, std::vector<uint8_t>& codes) {
+    const size_t N = pts.size();
+    const int D = pts.D;
+    std::vector<float> lo(D, std::numeric_limits<float>::infinity());
+    std::vector<float> hi(D, -std::numeric_limits<float>::infinity());
+
+    #pragma omp parallel
+    {
+        std::vector<float> tlo(D, std::numeric_limits<float>::infinity());
+        std::vector<float> thi(D, -std::numeric_limits<float>::infinity());
+        #pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < N; i++) {
+            const float* row = pts.row(i);
+            for (int j = 0; j < D; j++) {
+                tlo[j] = std::min(tlo[j], row[j]);
+                thi[j] = std::max(thi[j], row[j]);
+            }
+        }
+        #pragma omp critical
+        for (int j = 0; j < D; j++) {
+            lo[j] = std::min(lo[j], tlo[j]);
+            hi[j] = std::max(hi[j], thi[j]);
+        }
+    }
+
+    params.resize(2 * (size_t)D);
+    float* mins = params.data();
+    float* scales = params.data() + D;
+    for (int j = 0; j < D; j++) {
+        mins[j] = lo[j];
+        scales[j] = hi[j] > lo[j] ? (hi[j] - lo[j]) / 255.0f : 1.0f;
+    }
+
+    codes.resize(N * (size_t)D);
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < N; i++) {
+        const float* row = pts.row(i);
+        uint8_t* code = &codes[i * D];
+        for (int j = 0; j < D; j++) {
+            float v = std::nearbyint((row[j] - mins[j]) / scales[j]);
+            code[j] = (uint8_t)std::min(255.0f, std::max(0.0f, v));
+        }
+    }
+}
+
+// One k-means codebook per subspace, then every row coded subspace by subspace
+static void train_pq(const PointSet& pts, uint32_t m, uint32_t ksub, int iterations, std::mt19937_64& rng,
+                     std::vector<float>& params, std::vector<uint8_t>& codes, QuantBuildStats& stats) {
+    const size_t N = pts.size();
+    const int dsub = pts.D / (int)m;
+    double t0 = omp_get_wtime();
+
+    PointSet train = sample_rows(pts, std::max<size_t>(kPqTrainRows, ksub), rng);
+    std::vector<PointSet> books(m);
+    params.resize((size_t)m * ksub * dsub);
+    for (uint32_t s = 0; s < m; s++) {
+        PointSet sub = column_slice(train, 0, train.size(), s * dsub, dsub);
+        kmeans_train(sub, ksub, iterations, rng, books[s]);
+        std::memcpy(&params[(size_t)s * ksub * dsub], books[s].coords, sizeof(float) * ksub * dsub);
+    }
+    stats.train_time = omp_get_wtime() - t0;
+
+    double t1 = omp_get_wtime();
+    codes.resize(N * (size_t)m);
+    std::vector<uint32_t> assign;
+    for (size_t start = 0; start < N; start += kEncodeChunk) {
+        size_t n = std::min(kEncodeChunk, N - start);
+        for (uint32_t s = 0; s < m; s++) {
+            kmeans_assign(column_slice(pts, start, n, s * dsub, dsub), books[s], assign);
+            for (size_t i = 0; i < n; i++) codes[(start + i) * m + s] = (uint8_t)assign[i];
+        }
+    }
+    stats.encode_time = omp_get_wtime() - t1;
+}
+
+bool QuantizedCodes::build(const PointSet& pts, QuantType type, uint32_t pq_m, int iterations, uint64_t seed,
+                           const std::string& filename, QuantBuildStats& stats) {
+    const size_t N = pts.size();
+    const int D = pts.D;
+    if (N == 0) return false;
+
+    QuantHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, kQuantMagic, sizeof(h.magic));
+    h.N = N;
+    h.D = D;
+    h.type = (uint32_t)type;
+
+    std::vector<float> params;
+    std::vector<uint8_t> codes;
+    if (type == QuantType::SQ8) {
+        double t0 = omp_get_wtime();
+        train_sq8(pts, params, codes);
+        stats.train_time = omp_get_wtime() - t0;
+        h.m = D;
+        h.ksub = 256;
+        h.code_size = D;
+    } else {
+        if (pq_m == 0 || D % pq_m != 0) {
+            std::cerr << "PQ subspaces (" << pq_m << ") must divide D (" << D << ")\n";
+            return false;
+        }
+        std::mt19937_64 rng(seed);
+        uint32_t ksub = (uint32_t)std::min<size_t>(kPqCentroids, N);
+        train_pq(pts, pq_m, ksub, iterations, rng, params, codes, stats);
+        h.m = pq_m;
+        h.ksub = ksub;
+        h.code_size = pq_m;
+    }
+    const size_t params_end = sizeof(QuantHeader) + sizeof(float) * params.size();
+    h.codes_offset = (params_end + 63) & ~(size_t)63;
+
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        std::cerr << "System Error: " << std::strerror(errno) << " (" << filename << ")" << std::endl;
+        return false;
+    }
+    bool ok = pwrite(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h);
+    ok = ok && pwrite(fd, params.data(), sizeof(float) * params.size(), sizeof(h)) == (ssize_t)(sizeof(float) * params.size());
+    // Codes can exceed a single write's limit; write them in slices
+    for (size_t off = 0; ok && off < codes.size(); off += (1u << 30)) {
+        size_t len = std::min<size_t>(1u << 30, codes.size() - off);
+        ok = pwrite(fd, codes.data() + off, len, h.codes_offset + off) == (ssize_t)len;
+    }
+    if (close(fd) != 0) ok = false;
+    if (!ok) std::cerr << "Error: File write failed (Disk full or quota exceeded?)" << std::endl;
+    return ok;
+}
+
+bool QuantizedCodes::open(const std::string& filename) {
+    if (!file_.map(filename, sizeof(QuantHeader))) return false;
+    file_.header(header_);
+
+    // 1. Header fields must describe an sq8 or pq encoding of D
+    bool valid = std::memcmp(header_.magic, kQuantMagic, sizeof(kQuantMagic)) == 0 && header_.D > 0 &&
+                 header_.m > 0 && header_.D % header_.m == 0 && header_.ksub > 0 && header_.ksub <= 256;
+    if (valid && header_.type == (uint32_t)QuantType::SQ8) {
+        valid = header_.m == header_.D && header_.code_size == header_.D;
+    } else if (valid) {
+        valid = header_.type == (uint32_t)QuantType::PQ && header_.code_size == header_.m;
+    }
+
+    // 2. params (2D floats for sq8, ksub x D for pq) must end before the codes, which must fit the file
+    const uint64_t params = header_.type == (uint32_t)QuantType::SQ8 ? 2 * (uint64_t)header_.D
+                                                                     : (uint64_t)header_.ksub * header_.D;
+    uint64_t at = sizeof(QuantHeader);
+    valid = valid && file_.extent(at, params, sizeof(float)) && at <= header_.codes_offset;
+    at = header_.codes_offset;
+    valid = valid && file_.extent(at, header_.N, header_.code_size);
+    if (valid) {
+        params_ = file_.at<float>(sizeof(QuantHeader));
+        codes_ = file_.at<uint8_t>(header_.codes_offset);
+    }
+
+    // 3. pq codes index the ksub-entry tables; only small training sets have ksub < 256
+    if (valid && header_.type == (uint32_t)QuantType::PQ && header_.ksub < 256) {
+        for (uint64_t i = 0; valid && i < header_.N * header_.code_size; i++) valid = codes_[i] < header_.ksub;
+    }
+    if (!valid) {
+        std::cerr << "Not a valid codes file: " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
+static bool scan_uses_ip(MetricKind metric) {
+    return metric == MetricKind::InnerProduct || metric == MetricKind::Cosine;
+}
+
+// sq8 cosine divides the estimated x.q by the stored row norm
+static const float* scan_norms(const PointSet& pts, MetricKind metric) {
+    return metric == MetricKind::Cosine && !pts.norms.empty() ? pts.norms.data() : nullptr;
+}
+
+std::vector<float> QuantizedCodes::prepare(const float* q, MetricKind metric) const {
+    const bool ip = scan_uses_ip(metric);
+    const int D = dims();
+    std::vector<float> table;
+    if (type() == QuantType::SQ8) {
+        const float* mins = params_;
+        const float* scales = params_ + D;
+        // L2:  sum w_j (q'_j - c_j)^2 with q'_j = (q_j - min_j) / scale_j, w_j = scale_j^2
+        // IP: -(sum min_j q_j + sum (scale_j q_j) c_j)
+        table.resize(2 * (size_t)D + 1);
+        float base = 0.0f;
+        for (int j = 0; j < D; j++) {
+            if (ip) {
+                table[j] = scales[j] * q[j];
+                base += mins[j] * q[j];
+            } else {
+                table[j] = (q[j] - mins[j]) / scales[j];
+                table[D + j] = scales[j] * scales[j];
+            }
+        }
+        table[2 * D] = base;
+    } else {
+        const uint32_t m = header_.m, ksub = header_.ksub;
+        const int dsub = D / (int)m;
+        DistKernel kernel = ip ? select_dot_kernel(dsub) : select_l2_kernel(dsub);
+        DotKernel dot = select_dot_kernel(dsub);
+        // Cosine appends |c|^2 per centroid: the row norm is taken on the
+        // reconstruction, so both sides of the ratio share the code error
+        const bool cosine = metric == MetricKind::Cosine;
+        table.resize((cosine ? 2 : 1) * (size_t)m * ksub);
+        for (uint32_t s = 0; s < m; s++) {
+            const float* book = params_ + (size_t)s * ksub * dsub;
+            for (uint32_t c = 0; c < ksub; c++) {
+                const float* centroid = book + (size_t)c * dsub;
+                float d = kernel(centroid, q + s * dsub, dsub);
+                table[(size_t)s * ksub + c] = ip ? -d : d;
+                if (cosine) table[(size_t)(m + s) * ksub + c] = dot(centroid, centroid, dsub);
+            }
+        }
+    }
+    return table;
+}
+
+void QuantizedCodes::scan(const std::vector<float>& table, MetricKind metric, const float* norms, size_t begin,
+                          size_t end, TopK& heap) const {
+    const bool ip = scan_uses_ip(metric);
+    const int D = dims();
+    const size_t cs = header_.code_size;
+    const float* __restrict t = table.data();
+
+    if (type() == QuantType::PQ) {
+        const uint32_t m = header_.m, ksub = header_.ksub;
+        const float* sq_norms = metric == MetricKind::Cosine ? t + (size_t)m * ksub : nullptr;
+        for (size_t i = begin; i < end; i++) {
+            const uint8_t* code = codes_ + i * cs;
+            float d = 0.0f;
+            for (uint32_t s = 0; s < m; s++) d += t[s * ksub + code[s]];
+            if (sq_norms) {
+                float sq = 0.0f;
+                for (uint32_t s = 0; s < m; s++) sq += sq_norms[s * ksub + code[s]];
+                d = sq > 0.0f ? d / std::sqrt(sq) : 0.0f;
+            }
+            if (d < heap.worst()) heap.push({d, (uint32_t)i});
+        }
+    } else if (ip) {
+        const float base = t[2 * D];
+        for (size_t i = begin; i < end; i++) {
+            const uint8_t* __restrict code = codes_ + i * cs;
+            float dot = 0.0f;
+            #pragma omp simd reduction(+:dot)
+            for (int j = 0; j < D; j++) dot += t[j] * (float)code[j];
+            float d = -(base + dot);
+            if (norms) d = norms[i] > 0.0f ? d / norms[i] : 0.0f;
+            if (d < heap.worst()) heap.push({d, (uint32_t)i});
+        }
+    } else {
+        const float* __restrict w = t + D;
+        for (size_t i = begin; i < end; i++) {
+            const uint8_t* __restrict code = codes_ + i * cs;
+            float d = 0.0f;
+            #pragma omp simd reduction(+:d)
+            for (int j = 0; j < D; j++) {
+                float diff = t[j] - (float)code[j];
+                d += w[j] * diff * diff;
+            }
+            if (d < heap.worst()) heap.push({d, (uint32_t)i});
+        }
+    }
+}
+
+std::vector<KeyIdx> QuantizedCodes::search(const PointSet& pts, const float* q, size_t k, size_t rerank,
+                                           MetricKind metric) const {
+    const float* norms = scan_norms(pts, metric);
+    const std::vector<float> table = prepare(q, metric);
+    rerank = std::max(rerank, k);
+
+    std::vector<TopK> partial(omp_get_max_threads(), TopK(rerank));
+    #pragma omp parallel
+    {
+        const int t = omp_get_thread_num();
+        const int nt = omp_get_num_threads();
+        scan(table, metric, norms, size() * t / nt, size() * (t + 1) / nt, partial[t]);
+    }
+    TopK cands(rerank);
+    for (const TopK& t : partial) cands.merge(t);
+    return rerank_exact(pts, q, cands.sorted(), k, metric);
+}
+
+std::vector<std::vector<KeyIdx>> QuantizedCodes::search_batch(const PointSet& pts, const PointSet& queries, size_t k,
+                                                              size_t rerank, MetricKind metric) const {
+    const float* norms = scan_norms(pts, metric);
+    rerank = std::max(rerank, k);
+    std::vector<std::vector<KeyIdx>> results(queries.size());
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t qi = 0; qi < queries.size(); qi++) {
+        TopK cands(rerank);
+        scan(prepare(queries.row(qi), metric), metric, norms, 0, size(), cands);
+        results[qi] = rerank_exact(pts, queries.row(qi), cands.sorted(), k, metric);
+    }
+    return results;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "PointSet.hpp"
+#include "mapped_file.hpp"
+#include "cpu_topk.hpp"
+#include "metrics.hpp"
+
+// Compressed row codes for bandwidth-bound scans. The candidate pass reads
+// only the codes, and the best `rerank` candidates are re-scored exactly on
+// the float rows.
+//   sq8  int8 scalar quantization: one byte per coordinate, per-dimension
+//        min/scale (4x less traffic than float32)
+//   pq   product quantization: D split into m subspaces, each coded as one of
+//        256 k-means centroids; distances come from a per-query m x 256
+//        lookup table (4D/m x less traffic)
+// Codes approximate squared L2 (l2, l1), inner product (ip) or inner product
+// over the row norm (cosine); the re-rank always applies the requested metric.
+//
+// File layout (.codes), mmapped on open:
+//   [ QuantHeader ][ params ][ pad to 64 ][ N x code_size uint8 codes ]
+// params is min[D] + scale[D] for sq8, or m x 256 x (D/m) codebooks for pq.
+
+enum class QuantType : uint32_t { SQ8 = 0, PQ = 1 };
+
+const char* quant_type_name(QuantType t);
+bool parse_quant_type(const std::string& name, QuantType& t);
+
+struct QuantHeader {
+    char magic[8];      // "KNNQNT1\0"
+    uint64_t N;
+    uint32_t D;
+    uint32_t type;      // QuantType
+    uint32_t m;         // pq subspaces (D for sq8)
+    uint32_t ksub;      // pq centroids per subspace
+    uint64_t code_size; // bytes per row
+    uint64_t codes_offset;
+    uint64_t reserved[2];
+};
+static_assert(sizeof(QuantHeader) == 64, "QuantHeader must stay 64 bytes");
+
+struct QuantBuildStats {
+    double train_time = 0.0;
+    double encode_time = 0.0;
+};
+
+class QuantizedCodes {
+public:
+    QuantizedCodes() = default;
+    QuantizedCodes(const QuantizedCodes&) = delete;
+    QuantizedCodes& operator=(const QuantizedCodes&) = delete;
+
+    // Trains the quantizer (sq8: per-dimension range; pq: k-means codebooks
+    // on a sample, `pq_m` must divide D), encodes every row and writes the file.
+    static bool build(const PointSet& pts, QuantType type, uint32_t pq_m, int iterations, uint64_t seed,
+                      const std::string& filename, QuantBuildStats& stats);
+
+    // Maps a codes file for querying.
+    bool open(const std::string& filename);
+
+    size_t size() const { return header_.N; }
+    int dims() const { return (int)header_.D; }
+    QuantType type() const { return (QuantType)header_.type; }
+    size_t code_size() const { return header_.code_size; }
+
+    // Top-k for one query: parallel scan over the codes keeping `rerank`
+    // candidates, then an exact re-rank on the float rows of `pts`.
+    std::vector<KeyIdx> search(const PointSet& pts, const float* q, size_t k, size_t rerank, MetricKind metric) const;
+
+    // Top-k for every query row; parallel over queries.
+    std::vector<std::vector<KeyIdx>> search_batch(const PointSet& pts, const PointSet& queries, size_t k,
+                                                  size_t rerank, MetricKind metric) const;
+
+private:
+    // Per-query tables for the code-space scan (sq8: rescaled query and
+    // weights; pq: m x ksub lookup table, plus centroid norms for cosine).
+    // ip and cosine select inner product over L2.
+    std::vector<float> prepare(const float* q, MetricKind metric) const;
+    // Code-space scan of rows [begin, end) into `heap`. sq8 cosine divides
+    // by the row `norms` when given; pq cosine by the reconstructed norm.
+    void scan(const std::vector<float>& table, MetricKind metric, const float* norms, size_t begin, size_t end,
+              TopK& heap) const;
+
+    MappedFile file_;
+    QuantHeader header_{};
+    const float* params_ = nullptr;
+    const uint8_t* codes_ = nullptr;
+};
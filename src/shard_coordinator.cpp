@@ -0,0 +1,254 @@
+#include "shard_coordinator.hpp"
+#include "cpu_topk.hpp"
+#include "knn_client.hpp"
+#include "knn_protocol.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <omp.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<KeyIdx> merge_topk(const std::vector<std::pair<const KeyIdx*, size_t>>& lists, size_t k) {
+    // Min-heap of list heads: (key, list); each pop advances that list
+    struct Head {
+        KeyIdx key;
+        size_t list;
+    };
+    auto later = [](const Head& a, const Head& b) { return key_less(b.key, a.key); };
+    std::vector<Head> heap;
+    std::vector<size_t> pos(lists.size(), 0);
+    for (size_t l = 0; l < lists.size(); l++) {
+        if (lists[l].second > 0) heap.push_back({lists[l].first[0], l});
+    }
+    std::make_heap(heap.begin(), heap.end(), later);
+
+    std::vector<KeyIdx> out;
+    out.reserve(k);
+    while (out.size() < k && !heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), later);
+        Head h = heap.back();
+        heap.pop_back();
+        out.push_back(h.key);
+        if (++pos[h.list] < lists[h.list].second) {
+            heap.push_back({lists[h.list].first[pos[h.list]], h.list});
+            std::push_heap(heap.begin(), heap.end(), later);
+        }
+    }
+    return out;
+}
+
+// Reads the worker's stdout up to its "Listening on" line; false on EOF
+static bool wait_listening(int fd) {
+    std::string line;
+    char c;
+    while (true) {
+        ssize_t n = read(fd, &c, 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        if (c != '\n') {
+            line += c;
+            continue;
+        }
+        if (line.compare(0, 12, "Listening on") == 0) return true;
+        line.clear();
+    }
+}
+
+bool ShardCoordinator::start(const std::string& exe, const std::vector<std::string>& shards, const ShardOptions& opts) {
+    stop();
+    threads_ = opts.threads_per_shard > 0 ? opts.threads_per_shard
+                                          : std::max(1, omp_get_num_procs() / std::max<int>(1, (int)shards.size()));
+
+    // Inherited environment, with the worker's thread count
+    const std::string omp_env = "OMP_NUM_THREADS=" + std::to_string(threads_);
+    std::vector<char*> envp;
+    for (char** e = environ; *e; e++) {
+        if (std::strncmp(*e, "OMP_NUM_THREADS=", 16) != 0) envp.push_back(*e);
+    }
+    envp.push_back(const_cast<char*>(omp_env.c_str()));
+    envp.push_back(nullptr);
+
+    // 1. Spawn every worker first, so the shards load concurrently
+    std::vector<Clock::time_point> spawned(shards.size());
+    for (size_t s = 0; s < shards.size(); s++) {
+        auto shard = std::make_unique<Shard>();
+        shard->path = shards[s];
+        shard->socket = opts.socket_dir + "/knn-shard-" + std::to_string(getpid()) + "-" + std::to_string(s) + ".sock";
+
+        // Close-on-exec, so later workers do not inherit this one's pipe
+        int pipefd[2];
+        if (pipe2(pipefd, O_CLOEXEC) != 0) {
+            std::cerr << "System Error: " << std::strerror(errno) << " (pipe)" << std::endl;
+            stop();
+            return false;
+        }
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, pipefd[1], STDOUT_FILENO);
+
+        // One request stream per worker: no need to linger for a batch to fill
+        std::vector<std::string> args = {exe, "serve", shard->path, shard->socket, "--workers", "1", "--batch-wait-us", "0"};
+        std::vector<char*> argv;
+        for (std::string& a : args) argv.push_back(&a[0]);
+        argv.push_back(nullptr);
+
+        spawned[s] = Clock::now();
+        int err = posix_spawn(&shard->pid, exe.c_str(), &actions, nullptr, argv.data(), envp.data());
+        posix_spawn_file_actions_destroy(&actions);
+        close(pipefd[1]);
+        shard->out_fd = pipefd[0];
+        if (err != 0) {
+            std::cerr << "System Error: " << std::strerror(err) << " (spawn " << exe << ")" << std::endl;
+            close(shard->out_fd);
+            stop();
+            return false;
+        }
+        shards_.push_back(std::move(shard));
+    }
+
+    // 2. Wait for each to listen, connect, and ask for its shape
+    for (size_t s = 0; s < shards_.size(); s++) {
+        Shard& sh = *shards_[s];
+        int D = 0;
+        if (!wait_listening(sh.out_fd)) {
+            std::cerr << "Shard " << s << " (" << sh.path << ") failed to start\n";
+            stop();
+            return false;
+        }
+        sh.startup_s = std::chrono::duration<double>(Clock::now() - spawned[s]).count();
+        sh.fd = connect_unix(sh.socket);
+        if (sh.fd == -1 || !client_info(sh.fd, sh.rows, D)) {
+            stop();
+            return false;
+        }
+        if (s > 0 && D != D_) {
+            std::cerr << "Shard " << s << " (" << sh.path << ") has D=" << D << ", expected " << D_ << "\n";
+            stop();
+            return false;
+        }
+        D_ = D;
+        sh.first = total_rows_;
+        total_rows_ += sh.rows;
+    }
+    if (total_rows_ > std::numeric_limits<uint32_t>::max()) {
+        std::cerr << "Sharded dataset has " << total_rows_ << " rows; row ids are 32-bit\n";
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void ShardCoordinator::stop() {
+    for (auto& sh : shards_) {
+        if (sh->fd == -1 && sh->pid > 0) {
+            // Never connected: the worker may still be loading
+            kill(sh->pid, SIGTERM);
+        }
+        if (sh->fd != -1) {
+            client_shutdown(sh->fd);
+            close(sh->fd);
+        }
+    }
+    for (auto& sh : shards_) {
+        // Drain the worker's exit report so it never blocks on a full pipe
+        if (sh->out_fd != -1) {
+            char buf[4096];
+            while (read(sh->out_fd, buf, sizeof(buf)) > 0) {}
+            close(sh->out_fd);
+        }
+        if (sh->pid > 0) waitpid(sh->pid, nullptr, 0);
+    }
+    shards_.clear();
+    total_rows_ = 0;
+    D_ = 0;
+}
+
+bool ShardCoordinator::search(const float* queries, size_t nq, size_t k, MetricKind metric, SearchResult& out) {
+    k = std::min(k, total_rows_);
+    out.nq = nq;
+    out.k = k;
+    out.keys.resize(nq * k);
+    if (nq == 0 || k == 0) return true;
+
+    // 1. Scatter: the whole batch to every shard
+    const uint64_t id = next_id_++;
+    const auto t0 = Clock::now();
+    for (auto& sh : shards_) {
+        if (!client_send_search(sh->fd, id, queries, (uint32_t)nq, D_, (uint32_t)k, metric)) return false;
+    }
+
+    // 2. Gather: responses in arrival order
+    const size_t S = shards_.size();
+    std::vector<std::vector<std::vector<KeyIdx>>> local(S);
+    std::vector<pollfd> pending(S);
+    for (size_t s = 0; s < S; s++) pending[s] = {shards_[s]->fd, POLLIN, 0};
+    size_t remaining = S;
+    size_t last = 0;
+    while (remaining > 0) {
+        if (poll(pending.data(), S, -1) < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "System Error: " << std::strerror(errno) << " (poll)" << std::endl;
+            return false;
+        }
+        for (size_t s = 0; s < S; s++) {
+            if (pending[s].fd < 0 || pending[s].revents == 0) continue;
+            if (!client_recv_search(shards_[s]->fd, id, local[s])) return false;
+            shards_[s]->rtt.record(std::chrono::duration<double>(Clock::now() - t0).count());
+            pending[s].fd = -1;  // poll skips negative fds
+            last = s;
+            remaining--;
+        }
+    }
+    shards_[last]->slowest++;
+
+    // 3. Global ids, then a k-way merge per query
+    const auto t_merge = Clock::now();
+    for (size_t s = 0; s < S; s++) {
+        const uint32_t first = (uint32_t)shards_[s]->first;
+        for (auto& row : local[s]) {
+            for (KeyIdx& key : row) key.idx += first;
+        }
+    }
+    std::vector<std::pair<const KeyIdx*, size_t>> lists(S);
+    for (size_t q = 0; q < nq; q++) {
+        for (size_t s = 0; s < S; s++) lists[s] = {local[s][q].data(), local[s][q].size()};
+        std::vector<KeyIdx> merged = merge_topk(lists, k);
+        std::copy(merged.begin(), merged.end(), out.keys.begin() + q * k);
+    }
+    const auto t_end = Clock::now();
+    merge_.record(std::chrono::duration<double>(t_end - t_merge).count());
+    latency_.record(std::chrono::duration<double>(t_end - t0).count());
+    return true;
+}
+
+void ShardCoordinator::print_stats(std::ostream& out) const {
+    std::streamsize precision = out.precision();
+    out << "\n--- Per-Shard Timing (" << shards_.size() << " workers x " << threads_ << " threads) ---\n";
+    out << std::left << std::setw(7) << "shard" << std::right << std::setw(12) << "rows" << std::setw(13)
+        << "startup ms" << std::setw(12) << "rtt p50" << std::setw(12) << "rtt p99" << std::setw(12) << "rtt max"
+        << std::setw(10) << "slowest" << "  file\n";
+    out << std::fixed << std::setprecision(3);
+    for (size_t s = 0; s < shards_.size(); s++) {
+        const Shard& sh = *shards_[s];
+        out << std::left << std::setw(7) << s << std::right << std::setw(12) << sh.rows << std::setw(13)
+            << sh.startup_s * 1e3 << std::setw(12) << sh.rtt.percentile(50) * 1e3 << std::setw(12)
+            << sh.rtt.percentile(99) * 1e3 << std::setw(12) << sh.rtt.max() * 1e3 << std::setw(10) << sh.slowest
+            << "  " << sh.path << "\n";
+    }
+    out << "Merge: mean " << merge_.mean() * 1e3 << " ms, p99 " << merge_.percentile(99) * 1e3 << " ms\n";
+    latency_.print(out, "End-to-end Latency (scatter, slowest shard, merge)");
+    out << std::setprecision(precision);
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+#include "PointSet.hpp"
+#include "knn.hpp"
+#include "latency_histogram.hpp"
+#include "metrics.hpp"
+
+// Scatter/gather search over a dataset split into shard files. Each shard is
+// held by its own worker process - the `serve` daemon, loading it with the
+// usual loader - on a Unix socket, standing in for a remote node. A search
+// sends the query batch to every worker at once; each answers with its local
+// top-k, and the coordinator offsets the row ids (shard s numbers its rows
+// after those of shards 0..s-1) and k-way merges the lists into the global
+// top-k. Every round trip is timed per shard, so a straggling shard shows in
+// the stats as well as in the end-to-end tail.
+
+struct ShardOptions {
+    int threads_per_shard = 0;       // OMP_NUM_THREADS of each worker; 0 = cores / shards
+    std::string socket_dir = "/tmp";
+};
+
+class ShardCoordinator {
+public:
+    ShardCoordinator() = default;
+    ShardCoordinator(const ShardCoordinator&) = delete;
+    ShardCoordinator& operator=(const ShardCoordinator&) = delete;
+    ~ShardCoordinator() { stop(); }
+
+    // Spawns `exe serve <shard> <socket>` per shard, all loading at once, and
+    // waits until every worker listens. False (with the workers stopped) if
+    // one fails to start or the shards' dimensions differ.
+    bool start(const std::string& exe, const std::vector<std::string>& shards, const ShardOptions& opts);
+
+    // Shuts the workers down and reaps them. Called by the destructor.
+    void stop();
+
+    size_t size() const { return total_rows_; }
+    int dims() const { return D_; }
+    size_t shard_count() const { return shards_.size(); }
+    int threads_per_shard() const { return threads_; }
+
+    // Global top-k (k <= size()) of nq query rows, laid out like
+    // KnnDataset::search. False on a worker or transport error.
+    bool search(const float* queries, size_t nq, size_t k, MetricKind metric, SearchResult& out);
+
+    // Per-shard startup time, round-trip percentiles and straggler counts,
+    // then the merge cost and the end-to-end latency histogram.
+    void print_stats(std::ostream& out) const;
+
+private:
+    struct Shard {
+        std::string path;
+        std::string socket;
+        pid_t pid = -1;
+        int fd = -1;           // request connection
+        int out_fd = -1;       // worker stdout: readiness line, then drained at exit
+        uint64_t rows = 0;
+        uint64_t first = 0;    // global id of the shard's row 0
+        double startup_s = 0;  // spawn to listening (load time + process start)
+        LatencyHistogram rtt;  // send to response, per search
+        uint64_t slowest = 0;  // searches where this shard answered last
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    size_t total_rows_ = 0;
+    int D_ = 0;
+    int threads_ = 0;
+    uint64_t next_id_ = 1;
+    LatencyHistogram latency_;   // end to end, per search
+    LatencyHistogram merge_;
+};
+
+// k smallest keys of several ascending lists (key_less order), ascending.
+std::vector<KeyIdx> merge_topk(const std::vector<std::pair<const KeyIdx*, size_t>>& lists, size_t k);
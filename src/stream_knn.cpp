@@ -0,0 +1,234 @@
+#include "stream_knn.hpp"
+#include "binary_format.hpp"
+#include "cpu_distance.hpp"
+#include "cpu_topk.hpp"
+#include "metrics.hpp"
+#include "half.hpp"
+#include "load_points.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <omp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static constexpr size_t kPage = 4096;
+
+// One filled buffer: `rows` rows starting at global row `first`, taken from
+// file bytes [file_begin, file_end).
+struct Chunk {
+    PointSet pts;
+    size_t rows = 0;
+    size_t first = 0;
+    size_t file_begin = 0;
+    size_t file_end = 0;
+    bool ok = true;
+};
+
+StreamingDataset::~StreamingDataset() {
+    if (addr_) munmap(addr_, length_);
+}
+
+bool StreamingDataset::open(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1) return false;
+
+    struct stat sb;
+    fstat(fd, &sb);
+    length_ = sb.st_size;
+    void* addr = mmap(NULL, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) { addr_ = nullptr; return false; }
+    addr_ = static_cast<char*>(addr);
+    madvise(addr_, length_, MADV_SEQUENTIAL);
+
+    if (is_binary_dataset(addr_, length_)) {
+        BinaryHeader h;
+        std::memcpy(&h, addr_, sizeof(h));
+        binary_ = true;
+        D_ = (int)h.D;
+        N_ = h.N;
+        dtype_ = h.dtype;
+        payload_ = h.offset;
+        return D_ > 0;
+    }
+
+    // Text: trim trailing whitespace and take D from the first line
+    while (length_ > 0 && (addr_[length_ - 1] == '\n' || addr_[length_ - 1] == ' ' ||
+                           addr_[length_ - 1] == '\r' || addr_[length_ - 1] == '\t')) length_--;
+    const char* end = static_cast<const char*>(memchr(addr_, '\n', length_));
+    if (!end) end = addr_ + length_;
+    bool in_val = false;
+    for (const char* p = addr_; p < end; p++) {
+        bool blank = *p == ' ' || *p == '\t' || *p == '\r' || *p == ',';
+        if (!blank && !in_val) D_++;
+        in_val = !blank;
+    }
+    return D_ > 0;
+}
+
+// Fills `c` with the rows that start at file offset `begin`. Binary chunks are
+// a fixed row range; text chunks are a byte window cut at a line boundary,
+// sized so the row count cannot exceed the buffer (every value needs >= 2 bytes).
+static void fill_chunk(Chunk& c, const char* addr, size_t length, bool binary, uint32_t dtype,
+                       size_t payload, size_t N, int D, size_t capacity, size_t begin, size_t first) {
+    c.first = first;
+    c.file_begin = begin;
+
+    if (binary) {
+        size_t elem = dtype_size(dtype);
+        size_t row_bytes = (size_t)D * elem;
+        size_t row0 = (begin - payload) / row_bytes;
+        c.rows = std::min(capacity, N - row0);
+        c.file_end = begin + c.rows * row_bytes;
+        const char* src = addr + begin;
+
+        #pragma omp taskloop grainsize(1024) shared(c)
+        for (size_t r = 0; r < c.rows; r++) {
+            float* dst = c.pts.row(r);
+            if (dtype == DTYPE_F32) {
+                std::memcpy(dst, src + r * row_bytes, row_bytes);
+            } else {
+                widen_to_float(reinterpret_cast<const uint16_t*>(src + r * row_bytes), dst, D, dtype);
+            }
+        }
+        return;
+    }
+
+    size_t window = capacity * 2 * (size_t)D;
+    size_t end = std::min(length, begin + window);
+    if (end < length) {
+        // Cut after the last complete line of the window
+        const char* p = addr + end;
+        while (p > addr + begin && *(p - 1) != '\n') p--;
+        if (p == addr + begin) { c.ok = false; c.rows = 0; c.file_end = end; return; }
+        end = p - addr;
+    }
+    c.file_end = end;
+
+    // Same count / prefix sum / parse scheme as the in-memory loader
+    const int n_sub = std::max(1, omp_get_num_threads() * 2);
+    std::vector<const char*> bounds(n_sub + 1);
+    bounds[0] = addr + begin;
+    bounds[n_sub] = addr + end;
+    for (int s = 1; s < n_sub; s++) {
+        const char* p = std::max(bounds[s - 1], addr + begin + ((end - begin) / n_sub) * s);
+        const char* nl = static_cast<const char*>(memchr(p, '\n', addr + end - p));
+        bounds[s] = nl ? nl + 1 : addr + end;
+    }
+    std::vector<size_t> start(n_sub + 1, 0);
+    #pragma omp taskloop grainsize(1) shared(start, bounds)
+    for (int s = 0; s < n_sub; s++) start[s + 1] = count_newlines(bounds[s], bounds[s + 1] - bounds[s]);
+    if (end == length) {
+        for (int s = 0; s < n_sub; s++) {
+            if (bounds[s + 1] == addr + end) { start[s + 1]++; break; }
+        }
+    }
+    for (int s = 0; s < n_sub; s++) start[s + 1] += start[s];
+    c.rows = start[n_sub];
+
+    std::atomic<bool> ok{true};
+    #pragma omp taskloop grainsize(1) shared(c, ok, start, bounds)
+    for (int s = 0; s < n_sub; s++) {
+        const char* curr = bounds[s];
+        for (size_t r = start[s]; r < start[s + 1] && curr; r++) {
+            curr = parse_row(curr, bounds[s + 1], c.pts.row(r), D);
+        }
+        if (!curr) ok = false;
+    }
+    c.ok = ok;
+}
+
+// Scores every row of a filled chunk into the calling threads' heaps
+template <class Metric>
+static void score_chunk(const Chunk& c, std::vector<TopK>& partial, const Metric& metric) {
+    const int D = c.pts.D;
+    #pragma omp taskloop grainsize(2048) shared(c, partial, metric)
+    for (size_t r = 0; r < c.rows; r++) {
+        TopK& local = partial[omp_get_thread_num()];
+        const float* row = c.pts.row(r);
+        float xn = 0.0f;
+        if constexpr (Metric::kNeedsNorms) xn = row_norm(row, D);
+        float d = metric(row, xn);
+        if (d <= local.worst()) local.push({d, (uint32_t)(c.first + r)});
+    }
+}
+
+bool StreamingDataset::topk(const std::vector<float>& ref, size_t k, size_t mem_budget,
+                            std::vector<KeyIdx>& result, StreamStats& stats, MetricKind metric) {
+    if (!addr_ || k == 0) return false;
+    const int D = D_;
+
+    // Two buffers share the budget
+    size_t capacity = std::max<size_t>(1024, mem_budget / (2 * sizeof(float) * (size_t)D));
+    if (binary_) capacity = std::min(capacity, std::max<size_t>(1, N_));
+    stats.chunk_rows = capacity;
+
+    Chunk buf[2];
+    buf[0].pts.allocate(capacity, D);
+    buf[1].pts.allocate(capacity, D);
+
+    const size_t data_end = binary_ ? payload_ + N_ * (size_t)D * dtype_size(dtype_) : length_;
+    std::vector<TopK> partial(omp_get_max_threads(), TopK(k));
+    bool ok = true;
+
+    #pragma omp parallel
+    #pragma omp single
+    {
+        double t0 = omp_get_wtime();
+        fill_chunk(buf[0], addr_, length_, binary_, dtype_, payload_, N_, D, capacity,
+                   binary_ ? payload_ : 0, 0);
+        stats.load_time += omp_get_wtime() - t0;
+
+        for (int cur = 0; ; cur ^= 1) {
+            Chunk& c = buf[cur];
+            Chunk& next = buf[cur ^ 1];
+            if (!c.ok) { ok = false; break; }
+            if (c.rows == 0) break;
+            bool more = c.file_end < data_end;
+
+            // Stage the following chunk while this one is scored
+            if (more) {
+                size_t ahead = std::min(data_end, c.file_end + (c.file_end - c.file_begin));
+                size_t page = c.file_end / kPage * kPage;
+                madvise(addr_ + page, ahead - page, MADV_WILLNEED);
+
+                #pragma omp task shared(next, stats)
+                {
+                    double tl = omp_get_wtime();
+                    fill_chunk(next, addr_, length_, binary_, dtype_, payload_, N_, D, capacity,
+                               c.file_end, c.first + c.rows);
+                    stats.load_time += omp_get_wtime() - tl;
+                }
+            }
+
+            double tc = omp_get_wtime();
+            dispatch_metric(metric, ref.data(), D, [&](const auto& m) { score_chunk(c, partial, m); });
+            stats.compute_time += omp_get_wtime() - tc;
+
+            #pragma omp taskwait
+            stats.rows += c.rows;
+            stats.chunks++;
+
+            // Drop the consumed file pages so the mapping does not grow RSS
+            size_t lo = c.file_begin / kPage * kPage;
+            size_t hi = c.file_end / kPage * kPage;
+            if (hi > lo) madvise(addr_ + lo, hi - lo, MADV_DONTNEED);
+
+            if (!more) break;
+        }
+    }
+
+    if (!ok) {
+        std::cerr << "Parse error: malformed row near row " << stats.rows + 1 << "\n";
+        return false;
+    }
+
+    TopK merged(k);
+    for (const TopK& t : partial) merged.merge(t);
+    result = merged.sorted();
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "PointSet.hpp"
+#include "metrics.hpp"
+
+struct StreamStats {
+    size_t rows = 0;
+    size_t chunks = 0;
+    size_t chunk_rows = 0;     // capacity of each of the two buffers
+    double load_time = 0.0;    // time spent filling buffers (overlaps compute)
+    double compute_time = 0.0; // time spent in distance + top-k
+};
+
+// Out-of-core k-NN over a text or binary dataset that need not fit in memory.
+// The file is mmapped and walked in fixed-size chunks. Two row buffers are
+// used as a double-buffered pipeline: while one chunk is scored against the
+// running top-k, the next chunk is parsed/copied into the other buffer by
+// sibling OpenMP tasks. Consumed file pages are released with MADV_DONTNEED,
+// so resident memory stays around the budget regardless of dataset size.
+class StreamingDataset {
+public:
+    StreamingDataset() = default;
+    ~StreamingDataset();
+    StreamingDataset(const StreamingDataset&) = delete;
+    StreamingDataset& operator=(const StreamingDataset&) = delete;
+
+    bool open(const std::string& filename);
+    int dims() const { return D_; }
+
+    // Returns the min(k, N) nearest rows in ascending distance under `metric`.
+    // `mem_budget` bounds the two chunk buffers (bytes).
+    bool topk(const std::vector<float>& ref, size_t k, size_t mem_budget,
+              std::vector<KeyIdx>& result, StreamStats& stats, MetricKind metric = MetricKind::L2);
+
+private:
+    char* addr_ = nullptr;
+    size_t length_ = 0;
+    bool binary_ = false;
+    int D_ = 0;
+    uint32_t dtype_ = 0;
+    size_t N_ = 0;          // binary only; text rows are discovered while streaming
+    size_t payload_ = 0;    // offset of the first row
+};
@@ -0,0 +1,227 @@
+#include "trace.hpp"
+#include <iostream>
+#include <iomanip>
+
+void print_timing(const std::string& operation, double seconds) {
+    std::cout << std::fixed << std::setprecision(6);
+    std::cout << operation << " Time: " << seconds * 1000.0 << " ms (" << seconds << " s)\n";
+}
+
+#ifndef KNN_TRACE
+
+bool trace_start(const std::string&, bool) {
+    std::cerr << "Tracing needs a build with TRACE=1\n";
+    return false;
+}
+
+bool trace_enabled() { return false; }
+
+#else
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <vector>
+#include <linux/perf_event.h>
+#include <omp.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int kCounters = 3;  // cycles, instructions, LLC misses
+const char* const kCounterNames[kCounters] = {"cycles", "instructions", "llc_misses"};
+
+struct TraceEvent {
+    const char* name;
+    long tid;
+    int64_t start_ns;
+    int64_t dur_ns;
+    bool has_counters;
+    uint64_t counters[kCounters];
+};
+
+struct TraceState {
+    bool on = false;
+    std::string path;
+    std::chrono::steady_clock::time_point t0;
+    std::vector<int> leaders;  // one perf_event group per OpenMP thread; empty = no counters
+    std::mutex mu;
+    std::vector<TraceEvent> events;
+};
+
+TraceState g_trace;
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_trace.t0).count();
+}
+
+int open_counter(uint64_t config, int group_fd) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1;  // user space only: works with perf_event_paranoid <= 2
+    attr.exclude_hv = 1;
+    // pid 0, cpu -1: the calling thread, on whichever CPU it runs
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+// 1. Counter groups are opened by each OpenMP thread for itself; the master
+//    can read any thread's group later, so a span sums the whole team.
+//    On failure `err` is the errno of the first perf_event_open that failed:
+//    errno is per thread, and the cleanup close() calls may overwrite it.
+bool open_team_counters(std::vector<int>& leaders, int& err) {
+    const uint64_t configs[kCounters] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                         PERF_COUNT_HW_CACHE_MISSES};
+    std::vector<int> fds((size_t)omp_get_max_threads() * kCounters, -1);
+    bool ok = true;
+    err = 0;
+
+    #pragma omp parallel reduction(&&:ok)
+    {
+        int* mine = &fds[(size_t)omp_get_thread_num() * kCounters];
+        int my_err = 0;
+        mine[0] = open_counter(configs[0], -1);
+        if (mine[0] < 0) my_err = errno;
+        for (int c = 1; c < kCounters && mine[0] >= 0; c++) {
+            mine[c] = open_counter(configs[c], mine[0]);
+            if (mine[c] < 0 && my_err == 0) my_err = errno;
+        }
+        for (int c = 0; c < kCounters; c++) ok = ok && mine[c] >= 0;
+        if (my_err != 0) {
+            #pragma omp critical
+            if (err == 0) err = my_err;
+        }
+    }
+
+    if (!ok) {
+        for (int fd : fds) if (fd >= 0) close(fd);
+        return false;
+    }
+    for (size_t t = 0; t < fds.size(); t += kCounters) leaders.push_back(fds[t]);
+    return true;
+}
+
+void read_counters(uint64_t out[kCounters]) {
+    std::fill(out, out + kCounters, 0);
+    for (int fd : g_trace.leaders) {
+        uint64_t buf[1 + kCounters];
+        if (read(fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf) || buf[0] != kCounters) continue;
+        for (int c = 0; c < kCounters; c++) out[c] += buf[1 + c];
+    }
+}
+
+// 2. Output: Chrome trace-event JSON and a per-name summary
+void write_trace() {
+    std::lock_guard<std::mutex> lock(g_trace.mu);
+    // Spans are recorded as they close (children first); list them by start
+    std::vector<TraceEvent>& events = g_trace.events;
+    std::stable_sort(events.begin(), events.end(),
+                     [](const TraceEvent& a, const TraceEvent& b) { return a.start_ns < b.start_ns; });
+
+    std::ofstream out(g_trace.path);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    const long pid = getpid();
+    for (size_t i = 0; i < events.size(); i++) {
+        const TraceEvent& e = events[i];
+        out << "  {\"name\": \"" << e.name << "\", \"cat\": \"knn\", \"ph\": \"X\", \"pid\": " << pid
+            << ", \"tid\": " << e.tid << std::fixed << std::setprecision(3) << ", \"ts\": " << e.start_ns / 1e3
+            << ", \"dur\": " << e.dur_ns / 1e3;
+        if (e.has_counters) {
+            out << ", \"args\": {";
+            for (int c = 0; c < kCounters; c++) out << "\"" << kCounterNames[c] << "\": " << e.counters[c] << ", ";
+            out << "\"est_dram_gbps\": " << (e.dur_ns > 0 ? e.counters[2] * 64.0 / e.dur_ns : 0.0) << "}";
+        }
+        out << "}" << (i + 1 < events.size() ? "," : "") << "\n";
+    }
+    out << "]}\n";
+    if (!out) std::cerr << "Could not write trace " << g_trace.path << "\n";
+
+    // Totals per span name, in order of first appearance
+    std::vector<TraceEvent> totals;
+    std::vector<size_t> counts;
+    for (const TraceEvent& e : events) {
+        auto it = std::find_if(totals.begin(), totals.end(),
+                               [&](const TraceEvent& t) { return std::strcmp(t.name, e.name) == 0; });
+        if (it == totals.end()) {
+            totals.push_back(e);
+            counts.push_back(1);
+            continue;
+        }
+        it->dur_ns += e.dur_ns;
+        for (int c = 0; c < kCounters; c++) it->counters[c] += e.counters[c];
+        counts[it - totals.begin()]++;
+    }
+
+    std::cout << "\n--- Trace Summary (" << events.size() << " spans, written to " << g_trace.path << ") ---\n";
+    std::cout << std::left << std::setw(26) << "stage" << std::right << std::setw(7) << "count" << std::setw(14) << "total ms";
+    if (!g_trace.leaders.empty()) {
+        std::cout << std::setw(16) << "cycles" << std::setw(7) << "IPC" << std::setw(14) << "LLC misses"
+                  << std::setw(12) << "est. GB/s";
+    }
+    std::cout << "\n";
+    for (size_t i = 0; i < totals.size(); i++) {
+        const TraceEvent& t = totals[i];
+        std::cout << std::left << std::setw(26) << t.name << std::right << std::setw(7) << counts[i]
+                  << std::fixed << std::setprecision(3) << std::setw(14) << t.dur_ns / 1e6;
+        if (!g_trace.leaders.empty()) {
+            double ipc = t.counters[0] ? (double)t.counters[1] / t.counters[0] : 0.0;
+            double gbps = t.dur_ns > 0 ? t.counters[2] * 64.0 / t.dur_ns : 0.0;
+            std::cout << std::setw(16) << t.counters[0] << std::setprecision(2) << std::setw(7) << ipc
+                      << std::setw(14) << t.counters[2] << std::setw(12) << gbps;
+        }
+        std::cout << "\n";
+    }
+}
+
+}  // namespace
+
+bool trace_start(const std::string& path, bool counters) {
+    if (g_trace.on) return true;
+    g_trace.path = path;
+    g_trace.t0 = std::chrono::steady_clock::now();
+    int err = 0;
+    if (counters && !open_team_counters(g_trace.leaders, err)) {
+        std::cerr << "Warning: hardware counters unavailable (" << std::strerror(err)
+                  << "; check /proc/sys/kernel/perf_event_paranoid), tracing times only\n";
+    }
+    g_trace.on = true;
+    std::atexit(write_trace);
+    return true;
+}
+
+bool trace_enabled() { return g_trace.on; }
+
+ScopedTrace::ScopedTrace(const char* name) : name_(name), active_(g_trace.on) {
+    if (!active_) return;
+    if (!g_trace.leaders.empty()) read_counters(counters_);
+    start_ns_ = now_ns();
+}
+
+ScopedTrace::~ScopedTrace() {
+    if (!active_) return;
+    TraceEvent e;
+    e.dur_ns = now_ns() - start_ns_;
+    e.has_counters = !g_trace.leaders.empty();
+    if (e.has_counters) {
+        read_counters(e.counters);
+        for (int c = 0; c < kCounters; c++) e.counters[c] -= counters_[c];
+    } else {
+        std::fill(e.counters, e.counters + kCounters, 0);
+    }
+    e.name = name_;
+    e.tid = (long)syscall(SYS_gettid);
+    e.start_ns = start_ns_;
+
+    std::lock_guard<std::mutex> lock(g_trace.mu);
+    g_trace.events.push_back(e);
+}
+
+#endif
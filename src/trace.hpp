@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Prints one stage time in the format shared by the CPU and GPU paths:
+// "<operation> Time: X ms (Y s)".
+void print_timing(const std::string& operation, double seconds);
+
+// Scoped stage tracing. In a TRACE=1 build (KNN_TRACE defined), every
+// TRACE_SCOPE records a Chrome trace-event ("ph": "X") span from its point of
+// declaration to the end of the enclosing block, and trace_start() turns the
+// recording on. Without KNN_TRACE the macro expands to nothing, so the hot
+// paths carry no tracing code at all.
+//
+// With counters enabled, each span also carries the cycles, instructions and
+// last-level cache misses of every thread of the OpenMP team, read from
+// perf_event at both ends of the span. Memory traffic is estimated as one
+// 64-byte line per LLC miss.
+//
+// Spans are meant for stages (a load, a distance pass, a sort), not per-row work.
+
+// Starts recording; the trace is written to `path` and a per-stage summary is
+// printed when the process exits. Returns false in a build without KNN_TRACE.
+// If counters are requested but perf_event is unavailable (see
+// /proc/sys/kernel/perf_event_paranoid), tracing continues with times only.
+bool trace_start(const std::string& path, bool counters);
+bool trace_enabled();
+
+#ifdef KNN_TRACE
+class ScopedTrace {
+public:
+    explicit ScopedTrace(const char* name);
+    ~ScopedTrace();
+    ScopedTrace(const ScopedTrace&) = delete;
+    ScopedTrace& operator=(const ScopedTrace&) = delete;
+
+private:
+    const char* name_;
+    bool active_;
+    int64_t start_ns_ = 0;
+    uint64_t counters_[3] = {0, 0, 0};
+};
+
+#define KNN_TRACE_CAT2(a, b) a##b
+#define KNN_TRACE_CAT(a, b) KNN_TRACE_CAT2(a, b)
+#define TRACE_SCOPE(name) ScopedTrace KNN_TRACE_CAT(trace_scope_, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
@@ -0,0 +1,108 @@
+// Early-abandon checks: the kernels against a double reference on every ISA
+// the host has, and the pruned top-k / radius scans against the full ones for
+// D from 3 to 64, including that they abandon rows and read fewer than N x D
+// coordinates. Exits non-zero if any check fails.
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+#include "src/PointSet.hpp"
+#include "src/cpu_prune.hpp"
+#include "src/cpu_topk.hpp"
+#include "src/distance_kernels.hpp"
+
+static int failures = 0;
+
+#define CHECK(cond, what)                                                   \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            std::cerr << "FAIL " << __LINE__ << ": " << what << "\n";       \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+static double reference(const float* x, const float* q, int D, bool l1) {
+    double sum = 0.0;
+    for (int j = 0; j < D; j++) {
+        double d = (double)x[j] - q[j];
+        sum += l1 ? std::fabs(d) : d * d;
+    }
+    return sum;
+}
+
+// 1. Every kernel: exact with no bound, and stopped after its first block
+//    by a zero bound
+static void check_kernels(std::mt19937_64& rng) {
+    std::uniform_real_distribution<float> u(-1.0f, 1.0f);
+    const int dims[] = {1, 3, 5, 8, 12, 15, 16, 17, 24, 40, 100, 128, 200, 768};
+    for (int isa = 0; isa <= (int)detect_isa(); isa++) {
+        for (int D : dims) {
+            for (bool l1 : {false, true}) {
+                AbandonKernel kernel = l1 ? select_l1_abandon_kernel(D, (KernelISA)isa)
+                                          : select_l2_abandon_kernel(D, (KernelISA)isa);
+                const int block = abandon_block(D);
+                std::vector<float> x(D), q(D);
+                for (int j = 0; j < D; j++) {
+                    x[j] = u(rng);
+                    q[j] = u(rng);
+                }
+                const double ref = reference(x.data(), q.data(), D, l1);
+                const char* name = isa_name((KernelISA)isa);
+
+                int read = -1;
+                float full = kernel(x.data(), q.data(), D, block, std::numeric_limits<float>::infinity(), read);
+                CHECK(std::fabs(full - ref) <= 1e-4 * (1.0 + ref), name << " D=" << D << " full " << full << " vs " << ref);
+                CHECK(read == D, name << " D=" << D << " read " << read << " of " << D << " with no bound");
+
+                // A zero bound is crossed by the first block with any distance
+                float part = kernel(x.data(), q.data(), D, block, 0.0f, read);
+                CHECK(part > 0.0f, name << " D=" << D << " abandoned sum " << part);
+                CHECK(read == std::min(block, D), name << " D=" << D << " stopped after " << read << ", block " << block);
+            }
+        }
+    }
+}
+
+// 2. Pruned scans on N x D uniform rows, queried with a row of the set
+static void check_scans(int D, std::mt19937_64& rng) {
+    const size_t N = 20000, k = 10;
+    std::uniform_real_distribution<float> u(0.0f, 100.0f);
+    PointSet pts;
+    pts.allocate(N, D);
+    for (size_t i = 0; i < N * D; i++) pts.coords[i] = u(rng);
+    std::vector<float> ref(pts.row(N / 2), pts.row(N / 2) + D);
+
+    for (MetricKind metric : {MetricKind::L2, MetricKind::L1}) {
+        PruneStats stats;
+        std::vector<KeyIdx> pruned = topk_abandon_cpu(pts, ref, k, metric, &stats);
+        std::vector<KeyIdx> exact = topk_cpu(pts, ref, k, metric);
+        CHECK(pruned.size() == exact.size(), "D=" << D << " top-k size");
+        for (size_t j = 0; j < std::min(pruned.size(), exact.size()); j++) {
+            CHECK(pruned[j].idx == exact[j].idx, "D=" << D << " top-k rank " << j << ": " << pruned[j].idx << " vs " << exact[j].idx);
+        }
+        CHECK(stats.coords < (uint64_t)N * D, "D=" << D << " top-k read " << stats.coords << " of " << N * D);
+        CHECK(stats.abandoned > 0, "D=" << D << " top-k abandoned no rows");
+        CHECK(stats.abandoned + stats.rejected <= stats.rows, "D=" << D << " top-k row counts");
+
+        // Just past the 50th neighbour (the kernels may round differently)
+        const float radius = topk_cpu(pts, ref, 50, metric).back().dist * 1.001f;
+        std::vector<KeyIdx> hits = radius_cpu(pts, ref, radius, metric, &stats);
+        CHECK(hits.size() >= 50, "D=" << D << " radius found " << hits.size() << " rows");
+        CHECK(stats.coords < (uint64_t)N * D, "D=" << D << " radius read " << stats.coords << " of " << N * D);
+        CHECK(stats.abandoned > 0, "D=" << D << " radius abandoned no rows");
+    }
+}
+
+int main() {
+    std::mt19937_64 rng(7);
+    check_kernels(rng);
+    for (int D : {3, 8, 16, 32, 64}) check_scans(D, rng);
+    if (failures) {
+        std::cerr << failures << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << "test_prune: all checks passed\n";
+    return 0;
+}